@@ -22,6 +22,9 @@
 /* Message logging */
 #define ENABLE_LOGGING 1
 
+/* Build virtual replay driver */
+/* #undef ENABLE_REPLAY */
+
 /* Build UPEK TouchStrip sensor-only driver */
 #define ENABLE_UPEKSONLY /**/
 
@@ -0,0 +1,407 @@
+/*
+ * Concurrent minutiae extraction stress test for libfprint
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Extracts minutiae from the same images in several threads at once and
+ * checks every result against a serial run. Each extraction uses its own
+ * context, so the threads share nothing but the library's constant tables.
+ * The prints made by fp_img_batch_to_print_data() are then checked against
+ * ones made from each image on its own. Build libfprint and this program
+ * with CFLAGS=-fsanitize=thread to have ThreadSanitizer report any data race
+ * as well.
+ *
+ * The images are PGM files, such as the finger_standardized.pgm that
+ * img_capture saves.
+ *
+ * With -c, the program also captures that many images from the first device
+ * found and hands each one to a worker thread, which extracts its minutiae
+ * and frees it while the device captures the next. This checks that images
+ * can be freed on another thread than the one capturing them. No hardware is
+ * needed: build libfprint with the replay driver and point LIBFPRINT_REPLAY
+ * at the same images. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libfprint/fprint.h>
+
+struct result {
+	int nr_minutiae;
+	struct fp_minutia *minutiae;
+	int width;
+	int height;
+	unsigned char *binarized;
+};
+
+static char **paths;
+static int nr_paths;
+static struct result *expected;
+static int nr_rounds = 10;
+
+static int extract(const char *path, struct result *res)
+{
+	struct fp_img *img, *bin;
+	struct fp_minutia **minutiae;
+	int i;
+
+	img = fp_img_load_from_file((char *) path);
+	if (!img) {
+		fprintf(stderr, "could not load %s\n", path);
+		return -1;
+	}
+
+	minutiae = fp_img_get_minutiae(img, &res->nr_minutiae);
+	bin = fp_img_binarize(img);
+	if (!minutiae || !bin) {
+		fprintf(stderr, "extraction failed for %s\n", path);
+		fp_img_free(img);
+		return -1;
+	}
+
+	res->minutiae = malloc(res->nr_minutiae * sizeof(*res->minutiae));
+	for (i = 0; i < res->nr_minutiae; i++)
+		res->minutiae[i] = *minutiae[i];
+	res->width = fp_img_get_width(bin);
+	res->height = fp_img_get_height(bin);
+	res->binarized = malloc(res->width * res->height);
+	memcpy(res->binarized, fp_img_get_data(bin), res->width * res->height);
+
+	fp_img_free(bin);
+	fp_img_free(img);
+	return 0;
+}
+
+static void free_result(struct result *res)
+{
+	free(res->minutiae);
+	free(res->binarized);
+}
+
+static int same_minutia(const struct fp_minutia *a, const struct fp_minutia *b)
+{
+	return a->x == b->x && a->y == b->y && a->ex == b->ex && a->ey == b->ey
+		&& a->direction == b->direction && a->type == b->type
+		&& a->reliability == b->reliability;
+}
+
+static int same_result(const struct result *a, const struct result *b)
+{
+	int i;
+
+	if (a->nr_minutiae != b->nr_minutiae || a->width != b->width
+			|| a->height != b->height)
+		return 0;
+	for (i = 0; i < a->nr_minutiae; i++)
+		if (!same_minutia(&a->minutiae[i], &b->minutiae[i]))
+			return 0;
+	return memcmp(a->binarized, b->binarized, a->width * a->height) == 0;
+}
+
+static void *worker(void *arg)
+{
+	long thread = (long) arg;
+	long errors = 0;
+	int round, i;
+
+	for (round = 0; round < nr_rounds; round++) {
+		for (i = 0; i < nr_paths; i++) {
+			/* start each thread at a different image */
+			int n = (i + thread) % nr_paths;
+			struct result res;
+
+			if (extract(paths[n], &res) < 0) {
+				errors++;
+				continue;
+			}
+			if (!same_result(&res, &expected[n])) {
+				fprintf(stderr, "thread %ld: %s differs from serial run\n",
+					thread, paths[n]);
+				errors++;
+			}
+			free_result(&res);
+		}
+	}
+
+	return (void *) errors;
+}
+
+/* Captured images waiting for a capture worker. */
+static struct fp_img **captured;
+static int nr_captured;
+static int nr_taken;
+static int capture_done;
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t capture_cond = PTHREAD_COND_INITIALIZER;
+
+static void *capture_worker(void *arg)
+{
+	long errors = 0;
+
+	for (;;) {
+		struct fp_img *img;
+		int nr_minutiae;
+
+		pthread_mutex_lock(&capture_lock);
+		while (nr_taken == nr_captured && !capture_done)
+			pthread_cond_wait(&capture_cond, &capture_lock);
+		if (nr_taken == nr_captured) {
+			pthread_mutex_unlock(&capture_lock);
+			break;
+		}
+		img = captured[nr_taken++];
+		pthread_mutex_unlock(&capture_lock);
+
+		if (!fp_img_get_minutiae(img, &nr_minutiae)) {
+			fprintf(stderr, "extraction failed for a captured image\n");
+			errors++;
+		}
+		fp_img_free(img);
+	}
+
+	return (void *) errors;
+}
+
+/* Captures nr_captures images on this thread while nr_threads workers
+ * extract and free them. */
+static long check_captures(int nr_threads, int nr_captures)
+{
+	struct fp_dscv_dev **ddevs;
+	struct fp_dev *dev;
+	pthread_t *threads;
+	long errors = 0;
+	int i, r = 0;
+
+	if (fp_init() < 0) {
+		fprintf(stderr, "could not initialise libfprint\n");
+		return 1;
+	}
+	ddevs = fp_discover_devs();
+	if (!ddevs || !ddevs[0]) {
+		fprintf(stderr, "no device to capture from; set LIBFPRINT_REPLAY "
+			"to use the replay driver\n");
+		fp_dscv_devs_free(ddevs);
+		fp_exit();
+		return 1;
+	}
+	dev = fp_dev_open(ddevs[0]);
+	fp_dscv_devs_free(ddevs);
+	if (!dev) {
+		fprintf(stderr, "could not open device\n");
+		fp_exit();
+		return 1;
+	}
+
+	captured = calloc(nr_captures, sizeof(*captured));
+	threads = calloc(nr_threads, sizeof(*threads));
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&threads[i], NULL, capture_worker, NULL)) {
+			fprintf(stderr, "could not start thread %d\n", i);
+			exit(1);
+		}
+
+	/* enroll over and over to capture; an enrollment is never left
+	 * unfinished, as the device can't be closed in the middle of one */
+	for (i = 0; i < nr_captures
+			|| (r != FP_ENROLL_COMPLETE && r != FP_ENROLL_FAIL); ) {
+		struct fp_print_data *data = NULL;
+		struct fp_img *img = NULL;
+
+		r = fp_enroll_finger_img(dev, &data, &img);
+		fp_print_data_free(data);
+		if (r < 0) {
+			fprintf(stderr, "capture failed (%d)\n", r);
+			errors++;
+			break;
+		}
+		if (!img)
+			continue;
+		if (i == nr_captures) {
+			fp_img_free(img);
+			continue;
+		}
+
+		pthread_mutex_lock(&capture_lock);
+		captured[nr_captured++] = img;
+		pthread_cond_signal(&capture_cond);
+		pthread_mutex_unlock(&capture_lock);
+		i++;
+	}
+
+	/* the workers may still hold images from the device's pool */
+	fp_dev_close(dev);
+
+	pthread_mutex_lock(&capture_lock);
+	capture_done = 1;
+	pthread_cond_broadcast(&capture_cond);
+	pthread_mutex_unlock(&capture_lock);
+	for (i = 0; i < nr_threads; i++) {
+		void *ret;
+
+		pthread_join(threads[i], &ret);
+		errors += (long) ret;
+	}
+
+	fp_exit();
+	free(captured);
+	free(threads);
+	return errors;
+}
+
+/* Serializes the print extracted from a batch of nr images. */
+static int batch_prints(struct fp_img **imgs, int nr, unsigned char **data,
+	size_t *length)
+{
+	struct fp_print_data **prints = calloc(nr, sizeof(*prints));
+	int i, r;
+
+	r = fp_img_batch_to_print_data(imgs, nr, 0, 0, prints);
+	if (r < 0) {
+		fprintf(stderr, "batch extraction failed (%d)\n", r);
+		free(prints);
+		return r;
+	}
+	for (i = 0; i < nr; i++) {
+		length[i] = fp_print_data_get_data(prints[i], &data[i]);
+		fp_print_data_free(prints[i]);
+	}
+	free(prints);
+	return 0;
+}
+
+/* Extracts all images in one batch, and each image in a batch of its own,
+ * which runs on the calling thread only, and compares the prints. */
+static long check_batch(void)
+{
+	struct fp_img **imgs = calloc(nr_paths, sizeof(*imgs));
+	unsigned char **batch = calloc(nr_paths, sizeof(*batch));
+	size_t *batch_len = calloc(nr_paths, sizeof(*batch_len));
+	long errors = 0;
+	int i;
+
+	for (i = 0; i < nr_paths; i++)
+		if (!(imgs[i] = fp_img_load_from_file(paths[i])))
+			errors++;
+	if (errors == 0 && batch_prints(imgs, nr_paths, batch, batch_len) < 0)
+		errors++;
+	for (i = 0; i < nr_paths; i++)
+		fp_img_free(imgs[i]);
+	if (errors)
+		goto out;
+
+	for (i = 0; i < nr_paths; i++) {
+		struct fp_img *img = fp_img_load_from_file(paths[i]);
+		unsigned char *serial = NULL;
+		size_t serial_len;
+
+		if (!img || batch_prints(&img, 1, &serial, &serial_len) < 0) {
+			errors++;
+		} else if (serial_len != batch_len[i]
+				|| memcmp(serial, batch[i], serial_len) != 0) {
+			fprintf(stderr, "batch print of %s differs from serial one\n",
+				paths[i]);
+			errors++;
+		}
+		free(serial);
+		fp_img_free(img);
+	}
+
+out:
+	for (i = 0; i < nr_paths; i++)
+		free(batch[i]);
+	free(batch);
+	free(batch_len);
+	free(imgs);
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t *threads;
+	int nr_threads = 4;
+	int nr_captures = 0;
+	long errors = 0, batch_errors, capture_errors;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "t:r:c:")) != -1) {
+		switch (opt) {
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'r':
+			nr_rounds = atoi(optarg);
+			break;
+		case 'c':
+			nr_captures = atoi(optarg);
+			break;
+		default:
+			nr_threads = 0;
+			break;
+		}
+	}
+
+	if (optind >= argc || nr_threads < 1 || nr_rounds < 1
+			|| nr_captures < 0) {
+		fprintf(stderr, "usage: %s [-t threads] [-r rounds] [-c captures] "
+			"image.pgm...\n", argv[0]);
+		return 1;
+	}
+	paths = argv + optind;
+	nr_paths = argc - optind;
+
+	expected = calloc(nr_paths, sizeof(*expected));
+	for (i = 0; i < nr_paths; i++) {
+		if (extract(paths[i], &expected[i]) < 0)
+			return 1;
+		printf("%s: %d minutiae\n", paths[i], expected[i].nr_minutiae);
+	}
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&threads[i], NULL, worker, (void *) (long) i)) {
+			fprintf(stderr, "could not start thread %d\n", i);
+			return 1;
+		}
+	for (i = 0; i < nr_threads; i++) {
+		void *ret;
+
+		pthread_join(threads[i], &ret);
+		errors += (long) ret;
+	}
+
+	printf("%d threads, %d rounds of %d images: %ld errors\n", nr_threads,
+		nr_rounds, nr_paths, errors);
+
+	batch_errors = check_batch();
+	printf("batch of %d images: %ld errors\n", nr_paths, batch_errors);
+	errors += batch_errors;
+
+	if (nr_captures > 0) {
+		capture_errors = check_captures(nr_threads, nr_captures);
+		printf("%d captures freed off-thread: %ld errors\n", nr_captures,
+			capture_errors);
+		errors += capture_errors;
+	}
+
+	for (i = 0; i < nr_paths; i++)
+		free_result(&expected[i]);
+	free(expected);
+	free(threads);
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * Benchmark for the mindtct rank sorts
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Times sort_int_inc_2() and sort_double_dec_2() against the bubble sorts
+ * they replaced, and checks that both give the same order. The sorts are
+ * internal to libfprint, so this program is built from mindtct's sort.c
+ * directly rather than linked against the library.
+ *
+ * The integer ranks are minutia pixel offsets (y * width + x), as
+ * sort_minutiae_y_x() passes them; the double ranks are quantized so that
+ * many of them tie. A clean capture yields 30 to 80 minutiae, but a noisy
+ * swipe sensor can hand mindtct 1000 or more, so the default list lengths go
+ * up to 2000. Other lengths can be given on the command line.
+ *
+ * Each time is the fastest of 5 runs, in microseconds per sort. Build with
+ * CFLAGS=-O2 to reproduce the figures quoted for the sort rewrite. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <lfs.h>
+
+#define IMG_WIDTH	384
+#define IMG_HEIGHT	290
+#define NR_LISTS	16
+#define NR_RUNS		5
+
+static const int default_lengths[] = { 16, 50, 200, 500, 1000, 2000 };
+
+/* The bubble sorts that sort.c used to have, for comparison. */
+static void bubble_sort_int_inc_2(int *ranks, int *items, const int len)
+{
+	int done = 0;
+	int i, p, n, trank, titem;
+
+	for (n = len; !done; n--) {
+		done = 1;
+		for (i = 1, p = 0; i < n; i++, p++) {
+			if (ranks[p] > ranks[i]) {
+				trank = ranks[i];
+				ranks[i] = ranks[p];
+				ranks[p] = trank;
+				titem = items[i];
+				items[i] = items[p];
+				items[p] = titem;
+				done = 0;
+			}
+		}
+	}
+}
+
+static void bubble_sort_double_dec_2(double *ranks, int *items, const int len)
+{
+	int done = 0;
+	int i, p, n, titem;
+	double trank;
+
+	for (n = len; !done; n--) {
+		done = 1;
+		for (i = 1, p = 0; i < n; i++, p++) {
+			if (ranks[p] < ranks[i]) {
+				trank = ranks[i];
+				ranks[i] = ranks[p];
+				ranks[p] = trank;
+				titem = items[i];
+				items[i] = items[p];
+				items[p] = titem;
+				done = 0;
+			}
+		}
+	}
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int *int_ranks;
+static double *double_ranks;
+static int *work_ranks, *work_items;
+static double *work_dranks;
+
+/* Sorts every list once per run and returns the fastest run's time per
+ * sort. The copies back into the work buffers are timed as well, but cost
+ * little next to the sorts. */
+static double time_int(void (*sort)(int *, int *, const int), int len)
+{
+	double best = -1, start, t;
+	int run, l, i;
+
+	for (run = 0; run < NR_RUNS; run++) {
+		start = now_us();
+		for (l = 0; l < NR_LISTS; l++) {
+			memcpy(work_ranks, int_ranks + l * len, len * sizeof(int));
+			for (i = 0; i < len; i++)
+				work_items[i] = i;
+			sort(work_ranks, work_items, len);
+		}
+		t = (now_us() - start) / NR_LISTS;
+		if (best < 0 || t < best)
+			best = t;
+	}
+	return best;
+}
+
+static double time_double(void (*sort)(double *, int *, const int), int len)
+{
+	double best = -1, start, t;
+	int run, l, i;
+
+	for (run = 0; run < NR_RUNS; run++) {
+		start = now_us();
+		for (l = 0; l < NR_LISTS; l++) {
+			memcpy(work_dranks, double_ranks + l * len,
+				len * sizeof(double));
+			for (i = 0; i < len; i++)
+				work_items[i] = i;
+			sort(work_dranks, work_items, len);
+		}
+		t = (now_us() - start) / NR_LISTS;
+		if (best < 0 || t < best)
+			best = t;
+	}
+	return best;
+}
+
+/* Returns the number of lists whose items come out in a different order
+ * from the old and new sorts. */
+static int check(int len)
+{
+	int *items = malloc(len * sizeof(int));
+	int *ranks = malloc(len * sizeof(int));
+	double *dranks = malloc(len * sizeof(double));
+	int mismatches = 0;
+	int l, i;
+
+	for (l = 0; l < NR_LISTS; l++) {
+		memcpy(ranks, int_ranks + l * len, len * sizeof(int));
+		memcpy(work_ranks, ranks, len * sizeof(int));
+		for (i = 0; i < len; i++)
+			items[i] = work_items[i] = i;
+		bubble_sort_int_inc_2(ranks, items, len);
+		sort_int_inc_2(work_ranks, work_items, len);
+		if (memcmp(items, work_items, len * sizeof(int)))
+			mismatches++;
+
+		memcpy(dranks, double_ranks + l * len, len * sizeof(double));
+		memcpy(work_dranks, dranks, len * sizeof(double));
+		for (i = 0; i < len; i++)
+			items[i] = work_items[i] = i;
+		bubble_sort_double_dec_2(dranks, items, len);
+		sort_double_dec_2(work_dranks, work_items, len);
+		if (memcmp(items, work_items, len * sizeof(int)))
+			mismatches++;
+	}
+
+	free(items);
+	free(ranks);
+	free(dranks);
+	return mismatches;
+}
+
+static int bench(int len)
+{
+	int i, mismatches;
+
+	int_ranks = malloc(NR_LISTS * len * sizeof(int));
+	double_ranks = malloc(NR_LISTS * len * sizeof(double));
+	work_ranks = malloc(len * sizeof(int));
+	work_items = malloc(len * sizeof(int));
+	work_dranks = malloc(len * sizeof(double));
+
+	for (i = 0; i < NR_LISTS * len; i++) {
+		int_ranks[i] = (rand() % IMG_HEIGHT) * IMG_WIDTH
+			+ rand() % IMG_WIDTH;
+		double_ranks[i] = (rand() % 1000) / 100.0;
+	}
+
+	mismatches = check(len);
+	printf("%7d   %9.2f / %-9.2f   %9.2f / %-9.2f   %d\n", len,
+		time_int(bubble_sort_int_inc_2, len),
+		time_int(sort_int_inc_2, len),
+		time_double(bubble_sort_double_dec_2, len),
+		time_double(sort_double_dec_2, len), mismatches);
+
+	free(int_ranks);
+	free(double_ranks);
+	free(work_ranks);
+	free(work_items);
+	free(work_dranks);
+	return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+	int mismatches = 0;
+	int i;
+
+	srand(1);
+	printf("      n      int_inc_2 old / new    double_dec_2 old / new   "
+		"mismatches\n");
+
+	if (argc > 1) {
+		for (i = 1; i < argc; i++) {
+			int len = atoi(argv[i]);
+			if (len < 1) {
+				fprintf(stderr, "usage: %s [length...]\n", argv[0]);
+				return 1;
+			}
+			mismatches += bench(len);
+		}
+	} else {
+		for (i = 0; i < sizeof(default_lengths) / sizeof(int); i++)
+			mismatches += bench(default_lengths[i]);
+	}
+
+	return mismatches != 0;
+}
@@ -157,17 +157,115 @@ void aes_write_regv(struct fp_img_dev *dev, const struct aes_regwrite *regs,
 	continue_write_regv(wdata);
 }
 
+/* The sensors report 3-bit pixels, two per byte: the low nibble is an even
+ * row and the high nibble the odd row below it. Bytes run down each column,
+ * so the data is a column-major image which has to be transposed as well as
+ * expanded to 8 bits. */
+
+static void assemble_levels(unsigned char *levels, gboolean invert)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		levels[i] = invert ? 255 - i * 36 : i * 36;
+}
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+/* Transposes 16 columns of 16 pixels in place, leaving v[i] holding row i. */
+static void transpose_16x16(__m128i *v)
+{
+	__m128i t[16];
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		t[i] = _mm_unpacklo_epi8(v[2 * i], v[2 * i + 1]);
+		t[i + 8] = _mm_unpackhi_epi8(v[2 * i], v[2 * i + 1]);
+	}
+	for (i = 0; i < 4; i++) {
+		v[i] = _mm_unpacklo_epi16(t[2 * i], t[2 * i + 1]);
+		v[i + 4] = _mm_unpackhi_epi16(t[2 * i], t[2 * i + 1]);
+		v[i + 8] = _mm_unpacklo_epi16(t[2 * i + 8], t[2 * i + 9]);
+		v[i + 12] = _mm_unpackhi_epi16(t[2 * i + 8], t[2 * i + 9]);
+	}
+	for (i = 0; i < 8; i++) {
+		t[i] = _mm_unpacklo_epi32(v[2 * i], v[2 * i + 1]);
+		t[i + 8] = _mm_unpackhi_epi32(v[2 * i], v[2 * i + 1]);
+	}
+	for (i = 0; i < 4; i++) {
+		v[4 * i] = _mm_unpacklo_epi64(t[2 * i], t[2 * i + 1]);
+		v[4 * i + 1] = _mm_unpackhi_epi64(t[2 * i], t[2 * i + 1]);
+		v[4 * i + 2] = _mm_unpacklo_epi64(t[2 * i + 8], t[2 * i + 9]);
+		v[4 * i + 3] = _mm_unpackhi_epi64(t[2 * i + 8], t[2 * i + 9]);
+	}
+}
+
+/* Decodes the 16x16 tile whose top left pixel is at row, column. */
+static void assemble_tile(const unsigned char *input, size_t width,
+	size_t height, size_t row, size_t column, unsigned char *output,
+	const unsigned char *levels)
+{
+	const __m128i mask = _mm_set1_epi8(0x07);
+	__m128i v[16];
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		__m128i packed = _mm_loadl_epi64((const __m128i *)
+			(input + (column + i) * (height / 2) + row / 2));
+		__m128i lo = _mm_and_si128(packed, mask);
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+		__m128i pixels = _mm_unpacklo_epi8(lo, hi);
+#ifdef __SSSE3__
+		pixels = _mm_shuffle_epi8(
+			_mm_loadl_epi64((const __m128i *) levels), pixels);
+#else
+		/* i * 36 cannot carry out of a byte for i < 8 */
+		pixels = _mm_add_epi8(_mm_slli_epi16(pixels, 5),
+			_mm_slli_epi16(pixels, 2));
+		if (levels[0])
+			pixels = _mm_xor_si128(pixels, _mm_set1_epi8(0xff));
+#endif
+		v[i] = pixels;
+	}
+
+	transpose_16x16(v);
+	for (i = 0; i < 16; i++)
+		_mm_storeu_si128((__m128i *) (output + (row + i) * width + column),
+			v[i]);
+}
+#endif
+
+/* Expands a width x height sensor image from input into output, which is
+ * stored row by row. If invert is set the grey levels are inverted on the
+ * way, so the caller should not set FP_IMG_COLORS_INVERTED on the image. */
 void aes_assemble_image(unsigned char *input, size_t width, size_t height,
-	unsigned char *output)
+	unsigned char *output, gboolean invert)
 {
-	size_t row, column;
+	unsigned char levels[8];
+	size_t row, column, tile_width = 0, tile_height = 0;
+
+	assemble_levels(levels, invert);
 
+#ifdef __SSE2__
+	tile_width = width & ~15;
+	tile_height = height & ~15;
+	for (row = 0; row < tile_height; row += 16)
+		for (column = 0; column < tile_width; column += 16)
+			assemble_tile(input, width, height, row, column, output, levels);
+#endif
+
+	/* whatever the tiles did not cover */
 	for (column = 0; column < width; column++) {
-		for (row = 0; row < height; row += 2) {
-			output[width * row + column] = (*input & 0x07) * 36;
-			output[width * (row + 1) + column] = ((*input & 0x70) >> 4) * 36;
-			input++;
+		unsigned char *in = input + column * (height / 2);
+
+		row = column < tile_width ? tile_height : 0;
+		for (in += row / 2; row < height; row += 2, in++) {
+			output[width * row + column] = levels[*in & 0x07];
+			output[width * (row + 1) + column] = levels[(*in >> 4) & 0x07];
 		}
 	}
 }
-
@@ -34,7 +34,7 @@ void aes_write_regv(struct fp_img_dev *dev, const struct aes_regwrite *regs,
 	unsigned int num_regs, aes_write_regv_cb callback, void *user_data);
 
 void aes_assemble_image(unsigned char *input, size_t width, size_t height,
-	unsigned char *output);
+	unsigned char *output, gboolean invert);
 
 #endif
 
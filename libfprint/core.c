@@ -360,6 +360,9 @@ static struct fp_img_driver * const img_drivers[] = {
 #endif
 #ifdef ENABLE_UPEKSONLY
 	&upeksonly_driver,
+#endif
+#ifdef ENABLE_REPLAY
+	&replay_driver,
 #endif
 	/*
 #ifdef ENABLE_AES1610
@@ -460,6 +463,29 @@ static struct fp_dscv_dev *discover_dev(libusb_device *udev)
 	return ddev;
 }
 
+/* Drivers with no USB IDs drive devices that are not on the bus; their
+ * discover callback alone decides if such a device is present. */
+static struct fp_dscv_dev *discover_virtual_dev(struct fp_driver *drv)
+{
+	struct fp_dscv_dev *ddev;
+	uint32_t devtype = 0;
+	int r;
+
+	if (drv->id_table[0].vendor != 0 || !drv->discover)
+		return NULL;
+
+	r = drv->discover(NULL, &devtype);
+	if (r < 0)
+		fp_err("%s discover failed, code %d", drv->name, r);
+	if (r <= 0)
+		return NULL;
+
+	ddev = g_malloc0(sizeof(*ddev));
+	ddev->drv = drv;
+	ddev->devtype = devtype;
+	return ddev;
+}
+
 /** \ingroup dscv_dev
  * Scans the system and returns a list of discovered devices. This is your
  * entry point into finding a fingerprint reader to operate.
@@ -469,6 +495,7 @@ static struct fp_dscv_dev *discover_dev(libusb_device *udev)
 API_EXPORTED struct fp_dscv_dev **fp_discover_devs(void)
 {
 	GSList *tmplist = NULL;
+	GSList *elem;
 	struct fp_dscv_dev **list;
 	libusb_device *udev;
 	libusb_device **devs;
@@ -498,11 +525,19 @@ API_EXPORTED struct fp_dscv_dev **fp_discover_devs(void)
 		dscv_count++;
 	}
 
+	for (elem = registered_drivers; elem; elem = g_slist_next(elem)) {
+		struct fp_dscv_dev *ddev = discover_virtual_dev(elem->data);
+		if (!ddev)
+			continue;
+		tmplist = g_slist_prepend(tmplist, (gpointer) ddev);
+		dscv_count++;
+	}
+
 	/* Convert our temporary GSList into a standard NULL-terminated pointer
 	 * array. */
 	list = g_malloc(sizeof(*list) * (dscv_count + 1));
 	if (dscv_count > 0) {
-		GSList *elem = tmplist;
+		elem = tmplist;
 		i = 0;
 		do {
 			list[i++] = elem->data;
@@ -839,6 +874,42 @@ API_EXPORTED int fp_dev_get_img_height(struct fp_dev *dev)
 	return fpi_imgdev_get_img_height(imgdev);
 }
 
+/** \ingroup dev
+ * Registers a function to be called with a quick assessment of each image
+ * captured by an \ref imaging "imaging device" during enrollment,
+ * verification and identification. The assessment is made on coarse maps of
+ * ridge flow computed at half resolution, which takes a fraction of the time
+ * of full minutiae detection, and is available as soon as the image has been
+ * captured, while the finger is still on the sensor.
+ *
+ * The callback is passed the percentage of the image area where ridge flow
+ * was found, and an estimate of the number of minutiae that area typically
+ * holds. If it returns non-zero, minutiae detection is skipped and the scan
+ * is reported as a retry (#FP_ENROLL_RETRY or #FP_VERIFY_RETRY) when the
+ * finger is removed, so the user can be asked to scan again straight away.
+ * Return 0 to let the scan proceed as normal. Swipe images that were
+ * analysed while the finger was moving (see \ref img_swipe) are assessed
+ * too, although most of their detection work has been done by then.
+ *
+ * \param dev the device
+ * \param callback the function to call, or NULL to stop assessing images
+ * \param user_data data to pass to the callback
+ * \returns 0 on success, -ENOTSUP for non-imaging devices
+ */
+API_EXPORTED int fp_dev_set_preview_callback(struct fp_dev *dev,
+	fp_img_preview_cb callback, void *user_data)
+{
+	struct fp_img_dev *imgdev = dev_to_img_dev(dev);
+	if (!imgdev) {
+		fp_dbg("preview callback for non-imaging device");
+		return -ENOTSUP;
+	}
+
+	dev->preview_cb = callback;
+	dev->preview_cb_data = user_data;
+	return 0;
+}
+
 /** \ingroup core
  * Set message verbosity.
  *  - Level 0: no messages ever printed by the library (default)
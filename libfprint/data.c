@@ -94,12 +94,13 @@ static const char *finger_num_to_str(enum fp_finger finger)
 }
 #endif
 
-static struct fp_print_data *print_data_new(uint16_t driver_id,
+struct fp_print_data *fpi_print_data_alloc(uint16_t driver_id,
 	uint32_t devtype, enum fp_print_data_type type, size_t length)
 {
-	struct fp_print_data *data = g_malloc(sizeof(*data) + length);
+	/* zeroed, so that the unused tail of fixed size print data does not
+	 * carry stale heap contents into stored prints */
+	struct fp_print_data *data = g_malloc0(sizeof(*data) + length);
 	fp_dbg("length=%zd driver=%02x devtype=%04x", length, driver_id, devtype);
-	memset(data, 0, sizeof(*data));
 	data->driver_id = driver_id;
 	data->devtype = devtype;
 	data->type = type;
@@ -109,7 +110,7 @@ static struct fp_print_data *print_data_new(uint16_t driver_id,
 
 struct fp_print_data *fpi_print_data_new(struct fp_dev *dev, size_t length)
 {
-	return print_data_new(dev->drv->id, dev->devtype,
+	return fpi_print_data_alloc(dev->drv->id, dev->devtype,
 		fpi_driver_get_data_type(dev->drv), length);
 }
 
@@ -172,7 +173,7 @@ API_EXPORTED struct fp_print_data *fp_print_data_from_data(unsigned char *buf,
 	}
 
 	print_data_len = buflen - sizeof(*raw);
-	data = print_data_new(GUINT16_FROM_LE(raw->driver_id),
+	data = fpi_print_data_alloc(GUINT16_FROM_LE(raw->driver_id),
 		GUINT32_FROM_LE(raw->devtype), raw->data_type, print_data_len);
 	memcpy(data->data, raw->data, print_data_len);
 	return data;
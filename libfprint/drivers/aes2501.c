@@ -62,10 +62,20 @@ static void complete_deactivation(struct fp_img_dev *dev);
 
 /****** GENERAL FUNCTIONS ******/
 
+struct aes2501_strip {
+	/* rows from the start of the previous strip to the start of this one,
+	 * for a normal and for a reversed scan */
+	unsigned int dy;
+	unsigned int r_dy;
+	unsigned char data[FRAME_SIZE];
+};
+
 struct aes2501_dev {
 	uint8_t read_regs_retry_count;
 	GSList *strips;
 	size_t strips_len;
+	unsigned int errors_sum;
+	unsigned int r_errors_sum;
 	gboolean deactivating;
 };
 
@@ -245,119 +255,84 @@ static int sum_histogram_values(unsigned char *data, uint8_t threshold)
 	return r;
 }
 
-/* find overlapping parts of  frames */
-static unsigned int find_overlap(unsigned char *first_frame,
-	unsigned char *second_frame, unsigned int *min_error)
+/* find where a new strip overlaps the previous one, for both directions in
+ * which the finger may have been swiped, and add the errors of the best
+ * overlaps to the totals used to pick the direction later */
+static void find_overlaps(struct aes2501_dev *aesdev,
+	struct aes2501_strip *prev, struct aes2501_strip *strip)
 {
-	unsigned int dy;
-	unsigned int not_overlapped_height = 0;
-	*min_error = 255 * FRAME_SIZE;
-	for (dy = 0; dy < FRAME_HEIGHT; dy++) {
-		/* Calculating difference (error) between parts of frames */
-		unsigned int i;
-		unsigned int error = 0;
-		for (i = 0; i < FRAME_WIDTH * (FRAME_HEIGHT - dy); i++) {
-			/* Using ? operator to avoid abs function */
-			error += first_frame[i] > second_frame[i] ? 
-					(first_frame[i] - second_frame[i]) :
-					(second_frame[i] - first_frame[i]); 
-		}
-		
-		/* Normalize error */
-		error *= 15;
-		error /= i;
-		if (error < *min_error) {
-			*min_error = error;
-			not_overlapped_height = dy;
-		}
-		first_frame += FRAME_WIDTH;
-	}
-	
-	return not_overlapped_height; 
+	unsigned int error;
+
+	strip->dy = fpi_swipe_find_overlap(prev->data, strip->data,
+		FRAME_WIDTH, FRAME_HEIGHT, &error);
+	aesdev->errors_sum += error;
+	strip->r_dy = fpi_swipe_find_overlap(strip->data, prev->data,
+		FRAME_WIDTH, FRAME_HEIGHT, &error);
+	aesdev->r_errors_sum += error;
 }
 
-/* assemble a series of frames into a single image */
-static unsigned int assemble(struct aes2501_dev *aesdev, unsigned char *output,
-	gboolean reverse, unsigned int *errors_sum)
+static void free_strips(struct aes2501_dev *aesdev)
 {
-	uint8_t *assembled = output;
-	int frame;
-	uint32_t image_height = FRAME_HEIGHT;
-	unsigned int min_error;
-	size_t num_strips = aesdev->strips_len;
-	GSList *list_entry = aesdev->strips;
-	*errors_sum = 0;
-
-	/* Rotating given data by 90 degrees 
-	 * Taken from document describing aes2501 image format
-	 * TODO: move reversing detection here */
-
-	if (reverse)
-		output += (num_strips - 1) * FRAME_SIZE;
-	for (frame = 0; frame < num_strips; frame++) {
-		aes_assemble_image(list_entry->data, FRAME_WIDTH, FRAME_HEIGHT, output);
-
-		if (reverse)
-		    output -= FRAME_SIZE;
-		else
-		    output += FRAME_SIZE;
-		list_entry = g_slist_next(list_entry);
-	}
-
-	/* Detecting where frames overlaped */
-	output = assembled;
-	for (frame = 1; frame < num_strips; frame++) {
-		int not_overlapped;
-
-		output += FRAME_SIZE;
-		not_overlapped = find_overlap(assembled, output, &min_error);
-		*errors_sum += min_error;
-		image_height += not_overlapped;
-		assembled += FRAME_WIDTH * not_overlapped;
-		memcpy(assembled, output, FRAME_SIZE); 
-	}
-	return image_height;
+	g_slist_foreach(aesdev->strips, (GFunc) g_free, NULL);
+	g_slist_free(aesdev->strips);
+	aesdev->strips = NULL;
+	aesdev->strips_len = 0;
+	aesdev->errors_sum = 0;
+	aesdev->r_errors_sum = 0;
 }
 
+/* assemble the strips into a single image, in whichever scan direction gave
+ * the better overlaps */
 static void assemble_and_submit_image(struct fp_img_dev *dev)
 {
 	struct aes2501_dev *aesdev = dev->priv;
-	size_t final_size;
+	gboolean reverse = aesdev->r_errors_sum <= aesdev->errors_sum;
+	unsigned int height = FRAME_HEIGHT;
+	unsigned char *output;
 	struct fp_img *img;
-	unsigned int errors_sum, r_errors_sum;
+	GSList *elem;
 
 	BUG_ON(aesdev->strips_len == 0);
 
-	/* reverse list */
-	aesdev->strips = g_slist_reverse(aesdev->strips);
+	for (elem = aesdev->strips; elem; elem = g_slist_next(elem)) {
+		struct aes2501_strip *strip = elem->data;
+		height += reverse ? strip->r_dy : strip->dy;
+	}
 
-	/* create buffer big enough for max image */
-	img = fpi_img_new(aesdev->strips_len * FRAME_SIZE);
+	/* the newest strip is at the head of the list, which is already the
+	 * order of a reversed scan */
+	if (!reverse)
+		aesdev->strips = g_slist_reverse(aesdev->strips);
 
-	img->flags = FP_IMG_COLORS_INVERTED;
-	img->height = assemble(aesdev, img->data, FALSE, &errors_sum);
-	img->height = assemble(aesdev, img->data, TRUE, &r_errors_sum);
-	
-	if (r_errors_sum > errors_sum) {
-	    img->height = assemble(aesdev, img->data, FALSE, &errors_sum);
-		img->flags |= FP_IMG_V_FLIPPED | FP_IMG_H_FLIPPED;
-		fp_dbg("normal scan direction");
-	} else {
+	img = fpi_img_new_pooled(dev, height * FRAME_WIDTH);
+	img->height = height;
+	if (reverse) {
+		img->flags = 0;
 		fp_dbg("reversed scan direction");
+	} else {
+		img->flags = FP_IMG_V_FLIPPED | FP_IMG_H_FLIPPED;
+		fp_dbg("normal scan direction");
 	}
 
-	/* now that overlap has been removed, resize output image buffer */
-	final_size = img->height * FRAME_WIDTH;
-	img = fpi_img_resize(img, final_size);
-	fpi_imgdev_image_captured(dev, img);
+	/* each strip contributes the rows which the next one does not cover */
+	output = img->data;
+	for (elem = aesdev->strips; elem; elem = g_slist_next(elem)) {
+		struct aes2501_strip *strip = elem->data;
+		GSList *next = g_slist_next(elem);
+		unsigned int rows = FRAME_HEIGHT;
+
+		if (next && reverse)
+			rows = strip->r_dy;
+		else if (next)
+			rows = ((struct aes2501_strip *) next->data)->dy;
+		memcpy(output, strip->data, rows * FRAME_WIDTH);
+		output += rows * FRAME_WIDTH;
+	}
 
-	/* free strips and strip list */
-	g_slist_foreach(aesdev->strips, (GFunc) g_free, NULL);
-	g_slist_free(aesdev->strips);
-	aesdev->strips = NULL;
+	fpi_imgdev_image_captured(dev, img);
+	free_strips(aesdev);
 }
 
-
 /****** FINGER PRESENCE DETECTION ******/
 
 static const struct aes_regwrite finger_det_reqs[] = {
@@ -543,7 +518,7 @@ enum capture_states {
 
 static void capture_read_strip_cb(struct libusb_transfer *transfer)
 {
-	unsigned char *stripdata;
+	struct aes2501_strip *strip;
 	struct fpi_ssm *ssm = transfer->user_data;
 	struct fp_img_dev *dev = ssm->priv;
 	struct aes2501_dev *aesdev = dev->priv;
@@ -560,9 +535,13 @@ static void capture_read_strip_cb(struct libusb_transfer *transfer)
 	}
 
 	/* FIXME: would preallocating strip buffers be a decent optimization? */
-	stripdata = g_malloc(192 * 8);
-	memcpy(stripdata, data + 1, 192*8);
-	aesdev->strips = g_slist_prepend(aesdev->strips, stripdata);
+	strip = g_malloc(sizeof(*strip));
+	aes_assemble_image(data + 1, FRAME_WIDTH, FRAME_HEIGHT, strip->data, TRUE);
+	if (aesdev->strips)
+		find_overlaps(aesdev, aesdev->strips->data, strip);
+	else
+		strip->dy = strip->r_dy = 0;
+	aesdev->strips = g_slist_prepend(aesdev->strips, strip);
 	aesdev->strips_len++;
 
 	threshold = regval_from_dump(data + 1 + 192*8 + 1 + 16*2 + 1 + 8,
@@ -908,9 +887,7 @@ static void complete_deactivation(struct fp_img_dev *dev)
 	 * maybe we can do this with a master reset, unconditionally? */
 
 	aesdev->deactivating = FALSE;
-	g_slist_free(aesdev->strips);
-	aesdev->strips = NULL;
-	aesdev->strips_len = 0;
+	free_strips(aesdev);
 	fpi_imgdev_deactivate_complete(dev);
 }
 
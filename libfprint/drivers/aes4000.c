@@ -140,20 +140,20 @@ static void img_cb(struct libusb_transfer *transfer)
 
 	fpi_imgdev_report_finger_status(dev, TRUE);
 
-	tmp = fpi_img_new(IMG_WIDTH * IMG_HEIGHT);
+	tmp = fpi_img_new_pooled(dev, IMG_WIDTH * IMG_HEIGHT);
 	tmp->width = IMG_WIDTH;
 	tmp->height = IMG_HEIGHT;
-	tmp->flags = FP_IMG_COLORS_INVERTED | FP_IMG_V_FLIPPED | FP_IMG_H_FLIPPED;
+	tmp->flags = FP_IMG_V_FLIPPED | FP_IMG_H_FLIPPED;
 	for (i = 0; i < NR_SUBARRAYS; i++) {
 		fp_dbg("subarray header byte %02x", *ptr);
 		ptr++;
-		aes_assemble_image(ptr, 96, 16, tmp->data + (i * 96 * 16));
+		aes_assemble_image(ptr, 96, 16, tmp->data + (i * 96 * 16), TRUE);
 		ptr += SUBARRAY_LEN;
 	}
 
 	/* FIXME: this is an ugly hack to make the image big enough for NBIS
 	 * to process reliably */
-	img = fpi_im_resize(tmp, ENLARGE_FACTOR);
+	img = fpi_img_scale(tmp, ENLARGE_FACTOR);
 	fp_img_free(tmp);
 	fpi_imgdev_image_captured(dev, img);
 
@@ -0,0 +1,439 @@
+/*
+ * Virtual replay driver for libfprint
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define FP_COMPONENT "replay"
+
+/* This driver exposes a device that is not on the bus: its scans are images
+ * read from disk, handed to the library at a configurable pace through the
+ * same paths a real imaging driver uses. It lets the whole enroll, verify
+ * and identify stack be exercised and profiled without any hardware. It is
+ * not built by default; configure with --with-drivers=...,replay to get it.
+ *
+ * The device is only discovered when LIBFPRINT_REPLAY is set, to one of:
+ *  - a PGM file (name ending in .pgm), replayed for every scan
+ *  - a directory, whose PGM files are replayed in name order
+ *  - a recording made with LIBFPRINT_RECORD, replayed frame by frame
+ * Frames are replayed in a loop. The optional settings are:
+ *  - LIBFPRINT_REPLAY_FPS: frames delivered per second once a finger is on
+ *    the sensor (default: as fast as possible)
+ *  - LIBFPRINT_REPLAY_FINGER_ON: milliseconds before a finger is placed
+ *  - LIBFPRINT_REPLAY_FINGER_OFF: milliseconds the finger stays after the
+ *    image was delivered
+ *  - LIBFPRINT_REPLAY_SIZE: image size as WIDTHxHEIGHT; frames are centred
+ *    and cropped or padded to it (default: each frame's own size)
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include <fp_internal.h>
+
+struct replay_frame {
+	int width;
+	int height;
+	uint16_t flags;
+	const unsigned char *data;
+	/* set for frames loaded from PGM files */
+	unsigned char *buffer;
+};
+
+struct replay_dev {
+	struct fpi_recording *recording;
+	struct replay_frame *frames;
+	int nr_frames;
+	int next_frame;
+
+	/* image size from LIBFPRINT_REPLAY_SIZE, 0 for each frame's own */
+	int img_width;
+	int img_height;
+
+	unsigned int capture_delay;
+	unsigned int finger_on_delay;
+	unsigned int finger_off_delay;
+	struct fpi_timeout *timeout;
+};
+
+struct fp_img_driver replay_driver;
+
+/***** FRAME SOURCES *****/
+
+/* Reads the next number from a PGM header, skipping whitespace and
+ * comments. Returns -1 if there is none. */
+static int pgm_header_value(FILE *fd)
+{
+	int c;
+	int value;
+
+	while ((c = fgetc(fd)) != EOF) {
+		if (c == '#') {
+			while ((c = fgetc(fd)) != EOF && c != '\n')
+				;
+		} else if (!isspace(c)) {
+			ungetc(c, fd);
+			break;
+		}
+	}
+
+	if (fscanf(fd, "%d", &value) != 1)
+		return -1;
+	return value;
+}
+
+/* Loads an 8-bit binary PGM image, as written by fp_img_save_to_file(). */
+static int load_pgm(const char *path, struct replay_frame *frame)
+{
+	FILE *fd = fopen(path, "rb");
+	char magic[2];
+	int maxval;
+	size_t size;
+	int r = -EINVAL;
+
+	if (!fd) {
+		fp_err("could not open '%s': %d", path, errno);
+		return -errno;
+	}
+
+	if (fread(magic, 1, 2, fd) != 2 || magic[0] != 'P' || magic[1] != '5') {
+		fp_err("'%s' is not a binary PGM file", path);
+		goto out;
+	}
+
+	frame->width = pgm_header_value(fd);
+	frame->height = pgm_header_value(fd);
+	maxval = pgm_header_value(fd);
+	if (frame->width <= 0 || frame->height <= 0 || maxval != 255) {
+		fp_err("unsupported PGM header in '%s'", path);
+		goto out;
+	}
+	/* a single whitespace character separates the header from the data */
+	fgetc(fd);
+
+	size = frame->width * frame->height;
+	frame->buffer = g_malloc(size);
+	if (fread(frame->buffer, 1, size, fd) != size) {
+		fp_err("short read from '%s'", path);
+		g_free(frame->buffer);
+		frame->buffer = NULL;
+		goto out;
+	}
+
+	frame->data = frame->buffer;
+	frame->flags = 0;
+	r = 0;
+out:
+	fclose(fd);
+	return r;
+}
+
+static int load_pgm_dir(struct replay_dev *rdev, const char *path)
+{
+	GDir *dir = g_dir_open(path, 0, NULL);
+	GSList *names = NULL;
+	GSList *elem;
+	const gchar *name;
+	int r = 0;
+
+	if (!dir) {
+		fp_err("could not open directory '%s'", path);
+		return -ENOENT;
+	}
+
+	while ((name = g_dir_read_name(dir)) != NULL)
+		if (g_str_has_suffix(name, ".pgm"))
+			names = g_slist_insert_sorted(names, g_strdup(name),
+				(GCompareFunc) strcmp);
+	g_dir_close(dir);
+
+	rdev->frames = g_malloc0(g_slist_length(names) * sizeof(*rdev->frames));
+	for (elem = names; elem; elem = g_slist_next(elem)) {
+		gchar *file = g_build_filename(path, elem->data, NULL);
+		r = load_pgm(file, &rdev->frames[rdev->nr_frames]);
+		g_free(file);
+		if (r < 0)
+			break;
+		rdev->nr_frames++;
+	}
+
+	g_slist_foreach(names, (GFunc) g_free, NULL);
+	g_slist_free(names);
+	return r;
+}
+
+static int load_recording(struct replay_dev *rdev, const char *path)
+{
+	int i;
+
+	rdev->recording = fpi_recording_open(path);
+	if (!rdev->recording)
+		return -EINVAL;
+
+	rdev->nr_frames = fpi_recording_get_nr_frames(rdev->recording);
+	rdev->frames = g_malloc0(rdev->nr_frames * sizeof(*rdev->frames));
+	for (i = 0; i < rdev->nr_frames; i++) {
+		struct fpi_recording_frame rframe;
+		fpi_recording_get_frame(rdev->recording, i, &rframe);
+		rdev->frames[i].width = rframe.width;
+		rdev->frames[i].height = rframe.height;
+		rdev->frames[i].flags = rframe.flags;
+		rdev->frames[i].data = rframe.data;
+	}
+
+	return 0;
+}
+
+static int load_frames(struct replay_dev *rdev, const char *path)
+{
+	if (g_file_test(path, G_FILE_TEST_IS_DIR))
+		return load_pgm_dir(rdev, path);
+
+	if (g_str_has_suffix(path, ".pgm")) {
+		rdev->frames = g_malloc0(sizeof(*rdev->frames));
+		rdev->nr_frames = 1;
+		return load_pgm(path, &rdev->frames[0]);
+	}
+
+	return load_recording(rdev, path);
+}
+
+static void free_frames(struct replay_dev *rdev)
+{
+	int i;
+
+	for (i = 0; i < rdev->nr_frames; i++)
+		g_free(rdev->frames[i].buffer);
+	g_free(rdev->frames);
+	fpi_recording_close(rdev->recording);
+}
+
+/* Builds the image for the next frame, centring it in the configured image
+ * size if there is one. */
+static struct fp_img *next_frame_img(struct fp_img_dev *dev)
+{
+	struct replay_dev *rdev = dev->priv;
+	struct replay_frame *frame = &rdev->frames[rdev->next_frame];
+	int width = rdev->img_width;
+	int height = rdev->img_height;
+	struct fp_img *img;
+	int sx, sy, dx, dy, w, h, y;
+
+	rdev->next_frame = (rdev->next_frame + 1) % rdev->nr_frames;
+	if (!width) {
+		width = frame->width;
+		height = frame->height;
+	}
+
+	img = fpi_img_new_pooled(dev, width * height);
+	img->width = width;
+	img->height = height;
+	img->flags = frame->flags;
+
+	if (width == frame->width && height == frame->height) {
+		memcpy(img->data, frame->data, width * height);
+		return img;
+	}
+
+	/* pad with the background: white, or black for inverted frames */
+	memset(img->data, (frame->flags & FP_IMG_COLORS_INVERTED) ? 0 : 255,
+		width * height);
+	w = MIN(width, frame->width);
+	h = MIN(height, frame->height);
+	sx = MAX((frame->width - width) / 2, 0);
+	sy = MAX((frame->height - height) / 2, 0);
+	dx = MAX((width - frame->width) / 2, 0);
+	dy = MAX((height - frame->height) / 2, 0);
+	for (y = 0; y < h; y++)
+		memcpy(img->data + (dy + y) * width + dx,
+			frame->data + (sy + y) * frame->width + sx, w);
+	return img;
+}
+
+/***** SCAN TIMING *****/
+
+static void finger_on_cb(void *data)
+{
+	struct fp_img_dev *dev = data;
+	struct replay_dev *rdev = dev->priv;
+
+	rdev->timeout = NULL;
+	fpi_imgdev_report_finger_status(dev, TRUE);
+}
+
+static void capture_cb(void *data)
+{
+	struct fp_img_dev *dev = data;
+	struct replay_dev *rdev = dev->priv;
+
+	rdev->timeout = NULL;
+	fpi_imgdev_image_captured(dev, next_frame_img(dev));
+}
+
+static void finger_off_cb(void *data)
+{
+	struct fp_img_dev *dev = data;
+	struct replay_dev *rdev = dev->priv;
+
+	rdev->timeout = NULL;
+	fpi_imgdev_report_finger_status(dev, FALSE);
+}
+
+static int dev_change_state(struct fp_img_dev *dev, enum fp_imgdev_state state)
+{
+	struct replay_dev *rdev = dev->priv;
+	unsigned int msec;
+	fpi_timeout_fn callback;
+
+	if (rdev->timeout) {
+		fpi_timeout_cancel(rdev->timeout);
+		rdev->timeout = NULL;
+	}
+
+	switch (state) {
+	case IMGDEV_STATE_AWAIT_FINGER_ON:
+		msec = rdev->finger_on_delay;
+		callback = finger_on_cb;
+		break;
+	case IMGDEV_STATE_CAPTURE:
+		msec = rdev->capture_delay;
+		callback = capture_cb;
+		break;
+	case IMGDEV_STATE_AWAIT_FINGER_OFF:
+		msec = rdev->finger_off_delay;
+		callback = finger_off_cb;
+		break;
+	default:
+		fp_err("unrecognised state %d", state);
+		return -EINVAL;
+	}
+
+	rdev->timeout = fpi_timeout_add(msec, callback, dev);
+	if (!rdev->timeout)
+		return -ETIME;
+	return 0;
+}
+
+static int dev_activate(struct fp_img_dev *dev, enum fp_imgdev_state state)
+{
+	fpi_imgdev_activate_complete(dev, 0);
+	return 0;
+}
+
+static void dev_deactivate(struct fp_img_dev *dev)
+{
+	struct replay_dev *rdev = dev->priv;
+
+	if (rdev->timeout) {
+		fpi_timeout_cancel(rdev->timeout);
+		rdev->timeout = NULL;
+	}
+	fpi_imgdev_deactivate_complete(dev);
+}
+
+static unsigned int getenv_uint(const char *name)
+{
+	const char *value = getenv(name);
+	int r = value ? atoi(value) : 0;
+
+	return r > 0 ? r : 0;
+}
+
+static int dev_init(struct fp_img_dev *dev, unsigned long driver_data)
+{
+	struct replay_dev *rdev;
+	const char *path = getenv("LIBFPRINT_REPLAY");
+	const char *size = getenv("LIBFPRINT_REPLAY_SIZE");
+	unsigned int fps = getenv_uint("LIBFPRINT_REPLAY_FPS");
+	int r;
+
+	if (!path)
+		return -ENODEV;
+
+	rdev = g_malloc0(sizeof(*rdev));
+	r = load_frames(rdev, path);
+	if (r == 0 && rdev->nr_frames == 0) {
+		fp_err("no frames to replay in '%s'", path);
+		r = -ENOENT;
+	}
+	if (r < 0) {
+		free_frames(rdev);
+		g_free(rdev);
+		return r;
+	}
+
+	rdev->capture_delay = fps ? 1000 / fps : 0;
+	rdev->finger_on_delay = getenv_uint("LIBFPRINT_REPLAY_FINGER_ON");
+	rdev->finger_off_delay = getenv_uint("LIBFPRINT_REPLAY_FINGER_OFF");
+
+	if (size && (sscanf(size, "%dx%d", &rdev->img_width,
+			&rdev->img_height) != 2 || rdev->img_width <= 0
+			|| rdev->img_height <= 0)) {
+		fp_err("ignoring bad image size '%s'", size);
+		rdev->img_width = 0;
+		rdev->img_height = 0;
+	}
+
+	fp_dbg("replaying %d frames from '%s'", rdev->nr_frames, path);
+	dev->priv = rdev;
+	fpi_imgdev_open_complete(dev, 0);
+	return 0;
+}
+
+static void dev_deinit(struct fp_img_dev *dev)
+{
+	struct replay_dev *rdev = dev->priv;
+
+	if (rdev->timeout)
+		fpi_timeout_cancel(rdev->timeout);
+	free_frames(rdev);
+	g_free(rdev);
+	fpi_imgdev_close_complete(dev);
+}
+
+static int dev_discover(const struct usb_id *usb_id, uint32_t *devtype)
+{
+	return getenv("LIBFPRINT_REPLAY") != NULL;
+}
+
+/* no USB IDs: the device is found through dev_discover alone */
+static const struct usb_id id_table[] = {
+	{ 0, 0, 0, },
+};
+
+struct fp_img_driver replay_driver = {
+	.driver = {
+		.id = 10,
+		.name = FP_COMPONENT,
+		.full_name = "Virtual replay device",
+		.id_table = id_table,
+		.scan_type = FP_SCAN_TYPE_PRESS,
+		.discover = dev_discover,
+	},
+	.flags = 0,
+	.img_width = -1,
+	.img_height = -1,
+
+	.open = dev_init,
+	.close = dev_deinit,
+	.activate = dev_activate,
+	.deactivate = dev_deactivate,
+	.change_state = dev_change_state,
+};
@@ -69,6 +69,7 @@ struct sonly_dev {
 	size_t num_rows;
 	unsigned char *rowbuf;
 	int rowbuf_offset;
+	struct fpi_img_stream *stream;
 
 	int wraparounds;
 	int num_blank;
@@ -156,9 +157,10 @@ static void handoff_img(struct fp_img_dev *dev)
 {
 	struct sonly_dev *sdev = dev->priv;
 	size_t size = IMG_WIDTH * sdev->num_rows;
-	struct fp_img *img = fpi_img_new(size);
+	struct fp_img *img = fpi_img_new_pooled(dev, size);
 	GSList *elem = sdev->rows;
 	size_t offset = 0;
+	int r;
 
 	if (!elem) {
 		fp_err("no rows?");
@@ -166,6 +168,7 @@ static void handoff_img(struct fp_img_dev *dev)
 	}
 
 	fp_dbg("%d rows", sdev->num_rows);
+	img->width = IMG_WIDTH;
 	img->height = sdev->num_rows;
 
 	do {
@@ -177,6 +180,16 @@ static void handoff_img(struct fp_img_dev *dev)
 	g_slist_free(sdev->rows);
 	sdev->rows = NULL;
 
+	/* most of the analysis was done while the rows were arriving */
+	if (sdev->stream) {
+		r = fpi_img_stream_finish(sdev->stream, img);
+		if (r < 0)
+			fp_dbg("streamed detection failed (%d), detecting from "
+				"scratch", r);
+		fpi_img_stream_free(sdev->stream);
+		sdev->stream = NULL;
+	}
+
 	fpi_imgdev_image_captured(dev, img);
 	fpi_imgdev_report_finger_status(dev, FALSE);
 
@@ -185,24 +198,6 @@ static void handoff_img(struct fp_img_dev *dev)
 	cancel_img_transfers(dev);
 }
 
-static void compute_rows(unsigned char *a, unsigned char *b, int *diff,
-	int *total)
-{
-	int i;
-	int _total = 0;
-	int _diff = 0;
-
-	for (i = 0; i < IMG_WIDTH; i++) {
-		if (a[i] > b[i])
-			_diff += a[i] - b[i];
-		else
-			_diff += b[i] - a[i];
-		_total += b[i];
-	}
-	*diff = _diff;
-	*total = _total;
-}
-
 static void row_complete(struct fp_img_dev *dev)
 {
 	struct sonly_dev *sdev = dev->priv;
@@ -210,10 +205,10 @@ static void row_complete(struct fp_img_dev *dev)
 
 	if (sdev->num_rows > 0) {
 		unsigned char *lastrow = sdev->rows->data;
-		int diff;
-		int total;
+		unsigned int diff;
+		unsigned int total;
 
-		compute_rows(lastrow, sdev->rowbuf, &diff, &total);
+		diff = fpi_swipe_row_diff(lastrow, sdev->rowbuf, IMG_WIDTH, &total);
 		if (total < 52000) {
 			sdev->num_blank = 0;
 		} else {
@@ -231,6 +226,7 @@ static void row_complete(struct fp_img_dev *dev)
 
 	sdev->rows = g_slist_prepend(sdev->rows, sdev->rowbuf);
 	sdev->num_rows++;
+	fpi_img_stream_add_row(sdev->stream, sdev->rowbuf);
 	sdev->rowbuf = NULL;
 
 	if (sdev->num_rows >= MAX_ROWS) {
@@ -708,6 +704,11 @@ static void capsm_run_state(struct fpi_ssm *ssm)
 		sdev->finger_removed = 0;
 		sdev->last_seqnum = 16383;
 		sdev->killing_transfers = 0;
+		fpi_img_stream_free(sdev->stream);
+		sdev->stream = NULL;
+		/* only analyse the rows early if the image will be extracted */
+		if (fpi_imgdev_wants_print(dev))
+			sdev->stream = fpi_img_stream_new(dev, IMG_WIDTH, MAX_ROWS);
 		fpi_ssm_next_state(ssm);
 		break;
 	case CAPSM_WRITE_15:
@@ -896,6 +897,9 @@ static void deactivate_done(struct fp_img_dev *dev)
 		sdev->rows = NULL;
 	}
 
+	fpi_img_stream_free(sdev->stream);
+	sdev->stream = NULL;
+
 	fpi_imgdev_deactivate_complete(dev);
 }
 
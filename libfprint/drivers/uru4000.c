@@ -129,6 +129,8 @@ struct uru4k_dev {
 
 	struct libusb_transfer *irq_transfer;
 	struct libusb_transfer *img_transfer;
+	/* pooled image the bulk transfer reads into */
+	struct fp_img *img_transfer_img;
 
 	irq_cb_fn irq_cb;
 	void *irq_cb_data;
@@ -462,19 +464,20 @@ static void image_cb(struct libusb_transfer *transfer)
 {
 	struct fp_img_dev *dev = transfer->user_data;
 	struct uru4k_dev *urudev = dev->priv;
+	struct fp_img *img = urudev->img_transfer_img;
 	int hdr_skip = CAPTURE_HDRLEN;
 	int image_size = DATABLK_EXPECT - CAPTURE_HDRLEN;
-	struct fp_img *img;
 	int r = 0;
 
 	/* remove the global reference early: otherwise we may report results,
 	 * leading to immediate deactivation of driver, which will potentially
 	 * try to cancel an already-completed transfer */
 	urudev->img_transfer = NULL;
+	urudev->img_transfer_img = NULL;
 
 	if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
 		fp_dbg("cancelled");
-		g_free(transfer->buffer);
+		fp_img_free(img);
 		libusb_free_transfer(transfer);
 		return;
 	} else if (transfer->status != LIBUSB_TRANSFER_COMPLETED) {
@@ -493,13 +496,15 @@ static void image_cb(struct libusb_transfer *transfer)
 		goto out;
 	}
 
-	img = fpi_img_new(image_size);
-	memcpy(img->data, transfer->buffer + hdr_skip, image_size);
+	/* the frame was read straight into the image, skip its header */
+	img->data += hdr_skip;
+	img->length = image_size;
 	img->flags = FP_IMG_V_FLIPPED | FP_IMG_H_FLIPPED | FP_IMG_COLORS_INVERTED;
 	fpi_imgdev_image_captured(dev, img);
+	img = NULL;
 
 out:
-	g_free(transfer->buffer);
+	fp_img_free(img);
 	libusb_free_transfer(transfer);
 	if (r == 0)
 		r = start_imaging_loop(dev);
@@ -512,20 +517,25 @@ static int start_imaging_loop(struct fp_img_dev *dev)
 {
 	struct uru4k_dev *urudev = dev->priv;
 	struct libusb_transfer *transfer = libusb_alloc_transfer(0);
-	unsigned char *data;
+	struct fp_img *img;
 	int r;
 
 	if (!transfer)
 		return -ENOMEM;
 	
-	data = g_malloc(DATABLK_RQLEN);
-	libusb_fill_bulk_transfer(transfer, dev->udev, EP_DATA, data,
+	/* frames are read into images from the device's pool, so the loop
+	 * neither allocates nor copies once it is running */
+	img = fpi_img_new_pooled(dev, DATABLK_RQLEN);
+	libusb_fill_bulk_transfer(transfer, dev->udev, EP_DATA, img->data,
 		DATABLK_RQLEN, image_cb, dev, 0);
 
 	urudev->img_transfer = transfer;
+	urudev->img_transfer_img = img;
 	r = libusb_submit_transfer(transfer);
 	if (r < 0) {
-		g_free(data);
+		urudev->img_transfer = NULL;
+		urudev->img_transfer_img = NULL;
+		fp_img_free(img);
 		libusb_free_transfer(transfer);
 	}
 
@@ -22,6 +22,7 @@
 
 #include <config.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include <glib.h>
 #include <libusb.h>
@@ -127,6 +128,8 @@ struct fp_dev {
 	void *identify_cb_data;
 	fp_identify_stop_cb identify_stop_cb;
 	void *identify_stop_cb_data;
+	fp_img_preview_cb preview_cb;
+	void *preview_cb_data;
 
 	/* FIXME: better place to put this? */
 	struct fp_print_data **identify_gallery;
@@ -161,6 +164,8 @@ enum fp_imgdev_verify_state {
 	IMG_VERIFY_STATE_ACTIVATING 
 };
 
+struct lfsctx;
+
 struct fp_img_dev {
 	struct fp_dev *dev;
 	libusb_device_handle *udev;
@@ -174,6 +179,17 @@ struct fp_img_dev {
 	/* FIXME: better place to put this? */
 	size_t identify_match_offset;
 
+	/* minutiae extraction context, kept from one capture to the next */
+	struct lfsctx *lfsctx;
+	/* the same for the half resolution preview, see fpi_img_preview() */
+	struct lfsctx *preview_lfsctx;
+
+	/* buffers for captured images, see fpi_img_new_pooled() */
+	struct fpi_img_pool *img_pool;
+
+	/* set when LIBFPRINT_RECORD names a file to record captures to */
+	struct fpi_recorder *recorder;
+
 	void *priv;
 };
 
@@ -262,6 +278,9 @@ extern struct fp_img_driver fdu2000_driver;
 #ifdef ENABLE_VCOM5S
 extern struct fp_img_driver vcom5s_driver;
 #endif
+#ifdef ENABLE_REPLAY
+extern struct fp_img_driver replay_driver;
+#endif
 
 extern libusb_context *fpi_usb_ctx;
 extern GSList *opened_devices;
@@ -308,6 +327,8 @@ struct fpi_print_data_fp1 {
 
 void fpi_data_exit(void);
 struct fp_print_data *fpi_print_data_new(struct fp_dev *dev, size_t length);
+struct fp_print_data *fpi_print_data_alloc(uint16_t driver_id,
+	uint32_t devtype, enum fp_print_data_type type, size_t length);
 gboolean fpi_print_data_compatible(uint16_t driver_id1, uint32_t devtype1,
 	enum fp_print_data_type type1, uint16_t driver_id2, uint32_t devtype2,
 	enum fp_print_data_type type2);
@@ -315,7 +336,14 @@ gboolean fpi_print_data_compatible(uint16_t driver_id1, uint32_t devtype1,
 struct fp_minutiae {
 	int alloc;
 	int num;
+	/* list[i] always points at items[i]; this pointer view is what
+	 * fp_img_get_minutiae() hands out */
 	struct fp_minutia **list;
+	/* the minutiae themselves, stored contiguously */
+	struct fp_minutia *items;
+	/* neighbour indices and ridge counts of all minutiae, referenced
+	 * by their nbrs and ridge_counts members */
+	int *nbr_store;
 };
 
 /* bit values for fp_img.flags */
@@ -327,6 +355,8 @@ struct fp_minutiae {
 #define FP_IMG_STANDARDIZATION_FLAGS (FP_IMG_V_FLIPPED | FP_IMG_H_FLIPPED \
 	| FP_IMG_COLORS_INVERTED)
 
+#define FP_IMG_NR_MAPS (FP_IMG_MAP_HIGH_CURVE + 1)
+
 struct fp_img {
 	int width;
 	int height;
@@ -334,21 +364,89 @@ struct fp_img {
 	uint16_t flags;
 	struct fp_minutiae *minutiae;
 	unsigned char *binarized;
-	unsigned char data[0];
+	/* block maps from the extractor, indexed by enum fp_img_map_type */
+	int *maps[FP_IMG_NR_MAPS];
+	int map_width;
+	int map_height;
+	/* pool the buffer goes back to on fp_img_free, and its data size */
+	struct fpi_img_pool *pool;
+	size_t buf_size;
+	/* points just past this structure, or further in when a driver read
+	 * a header into the buffer ahead of the image */
+	unsigned char *data;
 };
 
+struct fpi_img_pool;
+struct fpi_img_pool *fpi_img_pool_new(size_t length);
+void fpi_img_pool_unref(struct fpi_img_pool *pool);
+
 struct fp_img *fpi_img_new(size_t length);
 struct fp_img *fpi_img_new_for_imgdev(struct fp_img_dev *dev);
+struct fp_img *fpi_img_new_pooled(struct fp_img_dev *dev, size_t length);
 struct fp_img *fpi_img_resize(struct fp_img *img, size_t newsize);
+struct fp_img *fpi_img_scale(struct fp_img *img, unsigned int factor);
 gboolean fpi_img_is_sane(struct fp_img *img);
 int fpi_img_detect_minutiae(struct fp_img *img);
+int fpi_img_compute_maps(struct fp_img *img);
+int fpi_img_preview(struct fp_img_dev *imgdev, struct fp_img *img,
+	int *foreground, int *minutiae);
+
+struct fpi_img_stream;
+struct fpi_img_stream *fpi_img_stream_new(struct fp_img_dev *imgdev,
+	int width, int max_height);
+void fpi_img_stream_free(struct fpi_img_stream *stream);
+void fpi_img_stream_add_row(struct fpi_img_stream *stream,
+	const unsigned char *row);
+int fpi_img_stream_finish(struct fpi_img_stream *stream, struct fp_img *img);
+
 int fpi_img_to_print_data(struct fp_img_dev *imgdev, struct fp_img *img,
 	struct fp_print_data **ret);
 int fpi_img_compare_print_data(struct fp_print_data *enrolled_print,
 	struct fp_print_data *new_print);
 int fpi_img_compare_print_data_to_gallery(struct fp_print_data *print,
 	struct fp_print_data **gallery, int match_threshold, size_t *match_offset);
-struct fp_img *fpi_im_resize(struct fp_img *img, unsigned int factor);
+
+/* capture recording, see record.c */
+
+struct fpi_recorder;
+struct fpi_recorder *fpi_recorder_open(const char *path);
+void fpi_recorder_close(struct fpi_recorder *rec);
+void fpi_recorder_finger_on(struct fpi_recorder *rec);
+int fpi_recorder_write(struct fpi_recorder *rec, struct fp_dev *dev,
+	struct fp_img *img);
+
+struct fpi_recording_frame {
+	uint64_t timestamp;	/* capture time, microseconds since the epoch */
+	uint32_t capture_time;	/* microseconds from finger on, or 0 */
+	uint16_t driver_id;
+	uint32_t devtype;
+	uint16_t flags;
+	int width;
+	int height;
+	size_t length;
+	const unsigned char *data;
+};
+
+/* the reader is exported for fprint-record-dump, but is not public API */
+struct fpi_recording;
+struct fpi_recording *fpi_recording_open(const char *path);
+void fpi_recording_close(struct fpi_recording *rec);
+int fpi_recording_get_nr_frames(struct fpi_recording *rec);
+int fpi_recording_get_frame(struct fpi_recording *rec, int index,
+	struct fpi_recording_frame *frame);
+
+/* WSQ compression, see wsq.c */
+
+int fpi_wsq_encode(struct fp_img *img, FILE *fd);
+struct fp_img *fpi_wsq_decode(const unsigned char *data, size_t length);
+
+/* swipe sensor motion estimation, see swipe.c */
+
+unsigned int fpi_swipe_row_diff(const unsigned char *a,
+	const unsigned char *b, size_t len, unsigned int *total);
+unsigned int fpi_swipe_find_overlap(const unsigned char *first,
+	const unsigned char *second, unsigned int width, unsigned int height,
+	unsigned int *error);
 
 /* polling and timeouts */
 
@@ -424,6 +522,7 @@ void fpi_imgdev_deactivate_complete(struct fp_img_dev *imgdev);
 void fpi_imgdev_report_finger_status(struct fp_img_dev *imgdev,
 	gboolean present);
 void fpi_imgdev_image_captured(struct fp_img_dev *imgdev, struct fp_img *img);
+gboolean fpi_imgdev_wants_print(struct fp_img_dev *imgdev);
 void fpi_imgdev_session_error(struct fp_img_dev *imgdev, int error);
 
 #endif
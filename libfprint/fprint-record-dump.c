@@ -0,0 +1,111 @@
+/*
+ * Helper binary for inspecting capture recordings
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Lists the frames of a recording made with LIBFPRINT_RECORD, along with how
+ * long the reader took to map and index it, and optionally saves one frame
+ * as a PGM image:
+ *
+ *   fprint-record-dump recording.fpr [frame image.pgm]
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fp_internal.h"
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int save_frame(struct fpi_recording *rec, int index, const char *path)
+{
+	struct fpi_recording_frame frame;
+	FILE *fd;
+	int r = 0;
+
+	if (fpi_recording_get_frame(rec, index, &frame) < 0) {
+		fprintf(stderr, "no frame %d\n", index);
+		return 1;
+	}
+
+	fd = fopen(path, "w");
+	if (!fd) {
+		fprintf(stderr, "could not open '%s' for writing\n", path);
+		return 1;
+	}
+	fprintf(fd, "P5 %d %d 255\n", frame.width, frame.height);
+	if (fwrite(frame.data, frame.width * frame.height, 1, fd) != 1)
+		r = 1;
+	if (fclose(fd) != 0)
+		r = 1;
+	if (r)
+		fprintf(stderr, "could not write '%s'\n", path);
+	return r;
+}
+
+int main(int argc, char **argv)
+{
+	struct fpi_recording *rec;
+	struct fpi_recording_frame frame;
+	uint64_t first = 0;
+	size_t total = 0;
+	double start, elapsed;
+	int nr_frames, i, r = 0;
+
+	if (argc != 2 && argc != 4) {
+		fprintf(stderr, "usage: %s recording [frame image.pgm]\n",
+			argv[0]);
+		return 1;
+	}
+
+	start = now_ms();
+	rec = fpi_recording_open(argv[1]);
+	elapsed = now_ms() - start;
+	if (!rec) {
+		fprintf(stderr, "could not read recording '%s'\n", argv[1]);
+		return 1;
+	}
+	nr_frames = fpi_recording_get_nr_frames(rec);
+
+	printf("frame    time (s)  capture (ms)  driver   devtype   size       "
+		"flags\n");
+	for (i = 0; i < nr_frames; i++) {
+		fpi_recording_get_frame(rec, i, &frame);
+		if (i == 0)
+			first = frame.timestamp;
+		total += frame.length;
+		printf("%5d  %10.3f  %12.1f  %6u  %8x  %4dx%-4d  %5x\n", i,
+			(frame.timestamp - first) / 1e6, frame.capture_time / 1e3,
+			frame.driver_id, frame.devtype, frame.width, frame.height,
+			frame.flags);
+	}
+	printf("%d frames, %zu bytes of image data, indexed in %.2f ms\n",
+		nr_frames, total, elapsed);
+
+	if (argc == 4)
+		r = save_frame(rec, atoi(argv[2]), argv[3]);
+
+	fpi_recording_close(rec);
+	return r;
+}
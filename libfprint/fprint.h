@@ -109,6 +109,11 @@ int fp_dev_img_capture(struct fp_dev *dev, int unconditional,
 int fp_dev_get_img_width(struct fp_dev *dev);
 int fp_dev_get_img_height(struct fp_dev *dev);
 
+typedef int (*fp_img_preview_cb)(struct fp_dev *dev, int foreground,
+	int minutiae, void *user_data);
+int fp_dev_set_preview_callback(struct fp_dev *dev,
+	fp_img_preview_cb callback, void *user_data);
+
 /** \ingroup dev
  * Enrollment result codes returned from fp_enroll_finger().
  * Result codes with RETRY in the name suggest that the scan failed due to
@@ -268,13 +273,58 @@ struct fp_minutia {
 	int num_nbrs;
 };
 
+/** \ingroup img
+ * Block maps computed from an image by the minutiae extractor. Each entry
+ * of a map describes one 8x8 pixel block of the image, in row order. Where
+ * the image size is not a multiple of 8, the last column and row of blocks
+ * are aligned with the right and bottom edges of the image.
+ */
+enum fp_img_map_type {
+	/** quality of each block, from 0 (unusable) to 4 (best) */
+	FP_IMG_MAP_QUALITY = 0,
+	/** ridge flow direction of each block, from 0 (vertical) to 15 in
+	 * clockwise steps of 11.25 degrees, or -1 where none was found */
+	FP_IMG_MAP_DIRECTION,
+	/** blocks with too little contrast to be analysed (non-zero) */
+	FP_IMG_MAP_LOW_CONTRAST,
+	/** blocks without clear ridge flow (non-zero) */
+	FP_IMG_MAP_LOW_FLOW,
+	/** blocks of high ridge curvature, such as cores and deltas (non-zero) */
+	FP_IMG_MAP_HIGH_CURVE,
+};
+
+/** \ingroup img
+ * Image quality levels, as returned by fp_img_get_quality(). Like NFIQ, the
+ * scale runs from 1 (best) to 5 (worst).
+ */
+enum fp_img_quality {
+	/** clear ridges over a large print area, with many minutiae */
+	FP_IMG_QUALITY_EXCELLENT = 1,
+	/** clear ridges over enough area for plenty of minutiae */
+	FP_IMG_QUALITY_VERY_GOOD = 2,
+	/** enough minutiae expected for dependable matching */
+	FP_IMG_QUALITY_GOOD = 3,
+	/** few minutiae expected, matching may fail */
+	FP_IMG_QUALITY_FAIR = 4,
+	/** too little usable print to match against */
+	FP_IMG_QUALITY_POOR = 5,
+};
+
 int fp_img_get_height(struct fp_img *img);
 int fp_img_get_width(struct fp_img *img);
 unsigned char *fp_img_get_data(struct fp_img *img);
 int fp_img_save_to_file(struct fp_img *img, char *path);
+struct fp_img *fp_img_load_from_file(char *path);
+int fp_img_save_to_wsq_file(struct fp_img *img, char *path);
+struct fp_img *fp_img_load_from_wsq_file(char *path);
 void fp_img_standardize(struct fp_img *img);
 struct fp_img *fp_img_binarize(struct fp_img *img);
 struct fp_minutia **fp_img_get_minutiae(struct fp_img *img, int *nr_minutiae);
+const int *fp_img_get_map(struct fp_img *img, enum fp_img_map_type type,
+	int *width, int *height);
+int fp_img_get_quality(struct fp_img *img);
+int fp_img_batch_to_print_data(struct fp_img **imgs, int nr_imgs,
+	uint16_t driver_id, uint32_t devtype, struct fp_print_data **prints);
 void fp_img_free(struct fp_img *img);
 
 /* Polling and timing */
@@ -19,8 +19,11 @@
 
 #include <sys/types.h>
 #include <errno.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <glib.h>
 
@@ -43,23 +46,142 @@
  * provides the fp_img_standardize function to convert images into standard
  * form, which is defined to be: finger flesh as black on white surroundings,
  * natural upright orientation.
+ *
+ * \section img_swipe Swipe sensor images
+ * Some swipe sensors, currently those handled by the upeksonly driver, have
+ * their images analysed while the finger is still moving, whenever the
+ * image is going to be turned into a print. The image is then cropped at
+ * the top, where the end of the swipe is, by up to 7 rows so that its
+ * height is a multiple of the extractor's 8 row block size. Images shorter
+ * than one block are left as they are.
  */
 
+/* Image data normally follows the header in the same allocation. */
+#define IMG_INLINE_DATA(img) ((unsigned char *) ((img) + 1))
+
 struct fp_img *fpi_img_new(size_t length)
 {
 	struct fp_img *img = g_malloc(sizeof(*img) + length);
 	memset(img, 0, sizeof(*img));
 	fp_dbg("length=%zd", length);
 	img->length = length;
+	img->data = IMG_INLINE_DATA(img);
 	return img;
 }
 
+/* Images captured by an imaging device come from a small per-device pool, so
+ * that a capture loop stops allocating once it has warmed up. Every pooled
+ * buffer holds buf_size bytes of image data; buf_size starts at the driver's
+ * fixed image size and grows to the largest image the driver asks for, which
+ * covers swipe sensors. Each image keeps a reference on its pool, so images
+ * handed to the application may outlive the device. The application may also
+ * free them on any thread, while the device captures the next one, so the
+ * pool is locked. */
+#define IMG_POOL_SIZE 4
+
+struct fpi_img_pool {
+	pthread_mutex_t lock;
+	int refcount;
+	size_t buf_size;
+	int nr_free;
+	struct fp_img *free[IMG_POOL_SIZE];
+};
+
+struct fpi_img_pool *fpi_img_pool_new(size_t length)
+{
+	struct fpi_img_pool *pool = g_malloc0(sizeof(*pool));
+	pthread_mutex_init(&pool->lock, NULL);
+	pool->refcount = 1;
+	pool->buf_size = length;
+	return pool;
+}
+
+static void img_pool_drain(struct fpi_img_pool *pool)
+{
+	while (pool->nr_free > 0)
+		g_free(pool->free[--pool->nr_free]);
+}
+
+static void img_pool_destroy(struct fpi_img_pool *pool)
+{
+	img_pool_drain(pool);
+	pthread_mutex_destroy(&pool->lock);
+	g_free(pool);
+}
+
+void fpi_img_pool_unref(struct fpi_img_pool *pool)
+{
+	int refcount;
+
+	pthread_mutex_lock(&pool->lock);
+	refcount = --pool->refcount;
+	pthread_mutex_unlock(&pool->lock);
+	if (refcount == 0)
+		img_pool_destroy(pool);
+}
+
+static struct fp_img *img_pool_get(struct fpi_img_pool *pool, size_t length)
+{
+	struct fp_img *img = NULL;
+	size_t buf_size;
+
+	pthread_mutex_lock(&pool->lock);
+	if (length > pool->buf_size) {
+		/* the cached buffers are too small for this driver */
+		img_pool_drain(pool);
+		pool->buf_size = length;
+	}
+	if (pool->nr_free > 0)
+		img = pool->free[--pool->nr_free];
+	buf_size = pool->buf_size;
+	pool->refcount++;
+	pthread_mutex_unlock(&pool->lock);
+
+	if (!img) {
+		fp_dbg("allocating pool buffer of %zd", buf_size);
+		img = g_malloc(sizeof(*img) + buf_size);
+	}
+	memset(img, 0, sizeof(*img));
+	img->length = length;
+	img->data = IMG_INLINE_DATA(img);
+	img->pool = pool;
+	img->buf_size = buf_size;
+	return img;
+}
+
+static void img_pool_put(struct fp_img *img)
+{
+	struct fpi_img_pool *pool = img->pool;
+	gboolean keep;
+	int refcount;
+
+	/* keep the buffer unless it is stale or nobody else can reuse it */
+	pthread_mutex_lock(&pool->lock);
+	keep = img->buf_size == pool->buf_size
+		&& pool->nr_free < IMG_POOL_SIZE && pool->refcount > 1;
+	if (keep)
+		pool->free[pool->nr_free++] = img;
+	refcount = --pool->refcount;
+	pthread_mutex_unlock(&pool->lock);
+
+	if (!keep)
+		g_free(img);
+	if (refcount == 0)
+		img_pool_destroy(pool);
+}
+
+/* Allocates an image of length bytes from the device's pool. */
+struct fp_img *fpi_img_new_pooled(struct fp_img_dev *imgdev, size_t length)
+{
+	return img_pool_get(imgdev->img_pool, length);
+}
+
 struct fp_img *fpi_img_new_for_imgdev(struct fp_img_dev *imgdev)
 {
 	struct fp_img_driver *imgdrv = fpi_driver_to_img_driver(imgdev->dev->drv);
 	int width = imgdrv->img_width;
 	int height = imgdrv->img_height;
-	struct fp_img *img = fpi_img_new(width * height);
+	struct fp_img *img = fpi_img_new_pooled(imgdev, width * height);
 	img->width = width;
 	img->height = height;
 	return img;
@@ -80,7 +202,27 @@ gboolean fpi_img_is_sane(struct fp_img *img)
 
 struct fp_img *fpi_img_resize(struct fp_img *img, size_t newsize)
 {
-	return g_realloc(img, sizeof(*img) + newsize);
+	/* data starts further in when a driver read a header into the buffer
+	 * along with the image */
+	size_t offset = img->data - IMG_INLINE_DATA(img);
+
+	if (img->pool) {
+		/* shrinking, as swipe drivers do once the image is assembled,
+		 * keeps the pooled buffer as it is */
+		if (offset + newsize <= img->buf_size) {
+			img->length = newsize;
+			return img;
+		}
+		fpi_img_pool_unref(img->pool);
+		img->pool = NULL;
+	}
+
+	if (offset)
+		memmove(IMG_INLINE_DATA(img), img->data, MIN(img->length, newsize));
+	img = g_realloc(img, sizeof(*img) + newsize);
+	img->length = newsize;
+	img->data = IMG_INLINE_DATA(img);
+	return img;
 }
 
 /** \ingroup img
@@ -89,6 +231,8 @@ struct fp_img *fpi_img_resize(struct fp_img *img, size_t newsize)
  */
 API_EXPORTED void fp_img_free(struct fp_img *img)
 {
+	int i;
+
 	if (!img)
 		return;
 
@@ -96,7 +240,12 @@ API_EXPORTED void fp_img_free(struct fp_img *img)
 		free_minutiae(img->minutiae);
 	if (img->binarized)
 		free(img->binarized);
-	g_free(img);
+	for (i = 0; i < FP_IMG_NR_MAPS; i++)
+		free(img->maps[i]);
+	if (img->pool)
+		img_pool_put(img);
+	else
+		g_free(img);
 }
 
 /** \ingroup img
@@ -165,49 +314,213 @@ API_EXPORTED int fp_img_save_to_file(struct fp_img *img, char *path)
 	return 0;
 }
 
-static void vflip(struct fp_img *img)
+/* Reads one decimal field of a PGM header, skipping the whitespace and
+ * comments in front of it. Returns -1 if there is no field or it does not
+ * fit in 16 bits. */
+static int pgm_read_field(const char **p, const char *end)
 {
-	int width = img->width;
-	int data_len = img->width * img->height;
-	unsigned char rowbuf[width];
-	int i;
+	int value = 0;
 
-	for (i = 0; i < img->height / 2; i++) {
-		int offset = i * width;
-		int swap_offset = data_len - (width * (i + 1));
+	while (*p < end && (g_ascii_isspace(**p) || **p == '#')) {
+		if (**p == '#')
+			while (*p < end && **p != '\n')
+				(*p)++;
+		else
+			(*p)++;
+	}
+	if (*p == end || !g_ascii_isdigit(**p))
+		return -1;
+	while (*p < end && g_ascii_isdigit(**p)) {
+		value = value * 10 + *(*p)++ - '0';
+		if (value > 0xffff)
+			return -1;
+	}
+	return value;
+}
 
-		/* copy top row into buffer */
-		memcpy(rowbuf, img->data + offset, width);
+/** \ingroup img
+ * Loads an image from a file in
+ * <a href="http://netpbm.sourceforge.net/doc/pgm.html">PGM format</a>, such
+ * as one written by fp_img_save_to_file(). Only 8-bit binary greyscale
+ * (P5) files are supported. The image is taken to be standardized already.
+ * \param path the path of the file to load
+ * \returns the image, or NULL on error. Must be freed with fp_img_free() after
+ * use.
+ */
+API_EXPORTED struct fp_img *fp_img_load_from_file(char *path)
+{
+	gsize length;
+	gchar *contents;
+	GError *err = NULL;
+	const char *p, *end;
+	struct fp_img *img = NULL;
+	int width, height, maxval;
 
-		/* copy lower row over upper row */
-		memcpy(img->data + offset, img->data + swap_offset, width);
+	g_file_get_contents(path, &contents, &length, &err);
+	if (err) {
+		fp_err("%s load failed: %s", path, err->message);
+		g_error_free(err);
+		return NULL;
+	}
 
-		/* copy buffer over lower row */
-		memcpy(img->data + swap_offset, rowbuf, width);
+	p = contents;
+	end = contents + length;
+	if (length < 2 || p[0] != 'P' || p[1] != '5') {
+		fp_err("%s is not a binary PGM file", path);
+		goto out;
+	}
+	p += 2;
+	width = pgm_read_field(&p, end);
+	height = pgm_read_field(&p, end);
+	maxval = pgm_read_field(&p, end);
+	/* a single whitespace character separates the header from the data */
+	if (width <= 0 || height <= 0 || maxval != 255 || p == end
+			|| !g_ascii_isspace(*p)) {
+		fp_err("unsupported PGM header in %s", path);
+		goto out;
 	}
+	p++;
+	if (end - p < (size_t) width * height) {
+		fp_err("%s is truncated", path);
+		goto out;
+	}
+
+	img = fpi_img_new(width * height);
+	img->width = width;
+	img->height = height;
+	memcpy(img->data, p, width * height);
+
+out:
+	g_free(contents);
+	return img;
 }
 
-static void hflip(struct fp_img *img)
+/** \ingroup img
+ * Saves an image to a file in WSQ format, the FBI's standard compression for
+ * fingerprint images. WSQ is lossy, but keeps the ridge detail needed for
+ * matching in a file typically 10 to 15 times smaller than the output of
+ * fp_img_save_to_file(). Both sides of the image must be between 32 and 8192
+ * pixels long.
+ * \param img the image to save
+ * \param path the path to save the image. Existing files will be overwritten.
+ * \returns 0 on success, non-zero on error.
+ */
+API_EXPORTED int fp_img_save_to_wsq_file(struct fp_img *img, char *path)
 {
-	int width = img->width;
-	unsigned char rowbuf[width];
-	int i, j;
+	FILE *fd = fopen(path, "w");
+	int r;
 
-	for (i = 0; i < img->height; i++) {
-		int offset = i * width;
+	if (!fd) {
+		fp_dbg("could not open '%s' for writing: %d", path, errno);
+		return -errno;
+	}
+
+	r = fpi_wsq_encode(img, fd);
+	if (fclose(fd) != 0 && r == 0)
+		r = -EIO;
+	if (r == 0)
+		fp_dbg("written to '%s'", path);
+	return r;
+}
+
+/** \ingroup img
+ * Loads an image from a WSQ file, such as one written by
+ * fp_img_save_to_wsq_file().
+ * \param path the path of the file to load
+ * \returns the image, or NULL on error. Must be freed with fp_img_free() after
+ * use.
+ */
+API_EXPORTED struct fp_img *fp_img_load_from_wsq_file(char *path)
+{
+	gsize length;
+	gchar *contents;
+	GError *err = NULL;
+	struct fp_img *img;
 
-		memcpy(rowbuf, img->data + offset, width);
-		for (j = 0; j < width; j++)
-			img->data[offset + j] = rowbuf[width - j - 1];
+	g_file_get_contents(path, &contents, &length, &err);
+	if (err) {
+		fp_err("%s load failed: %s", path, err->message);
+		g_error_free(err);
+		return NULL;
 	}
+
+	img = fpi_wsq_decode((unsigned char *) contents, length);
+	g_free(contents);
+	return img;
 }
 
-static void invert_colors(struct fp_img *img)
+/* Writes one row of width pixels from src to dst, mirrored left to right if
+ * mirror is set and inverted if invert is set. A word of 8 pixels is handled
+ * at a time: mirroring is a byte swap of the word at the opposite end of the
+ * row, inverting is a bitwise not. dst and src may only be the same row when
+ * not mirroring. */
+static void standardize_row(unsigned char *dst, const unsigned char *src,
+	int width, gboolean mirror, gboolean invert)
 {
-	int data_len = img->width * img->height;
-	int i;
-	for (i = 0; i < data_len; i++)
-		img->data[i] = 0xff - img->data[i];
+	guint64 mask = invert ? G_MAXUINT64 : 0;
+	guint64 w;
+	int i = 0;
+
+	if (mirror) {
+		for (; i + 8 <= width; i += 8) {
+			memcpy(&w, src + width - i - 8, 8);
+			w = GUINT64_SWAP_LE_BE(w) ^ mask;
+			memcpy(dst + i, &w, 8);
+		}
+		for (; i < width; i++)
+			dst[i] = src[width - i - 1] ^ (unsigned char) mask;
+	} else {
+		for (; i + 8 <= width; i += 8) {
+			memcpy(&w, src + i, 8);
+			w ^= mask;
+			memcpy(dst + i, &w, 8);
+		}
+		for (; i < width; i++)
+			dst[i] = src[i] ^ (unsigned char) mask;
+	}
+}
+
+/* Applies the flips and inversion requested by flags to a width x height
+ * image in place. Every row is written exactly once. */
+static void standardize_image(unsigned char *data, int width, int height,
+	uint16_t flags)
+{
+	gboolean vflip = (flags & FP_IMG_V_FLIPPED) != 0;
+	gboolean mirror = (flags & FP_IMG_H_FLIPPED) != 0;
+	gboolean invert = (flags & FP_IMG_COLORS_INVERTED) != 0;
+	unsigned char rowbuf[width];
+	int i, first, last;
+
+	if (vflip) {
+		/* swap each pair of rows from the outside in, transforming both on
+		 * the way; an odd middle row stays where it is */
+		for (i = 0; i < height / 2; i++) {
+			unsigned char *top = data + i * width;
+			unsigned char *bottom = data + (height - i - 1) * width;
+
+			memcpy(rowbuf, top, width);
+			standardize_row(top, bottom, width, mirror, invert);
+			standardize_row(bottom, rowbuf, width, mirror, invert);
+		}
+		first = height / 2;
+		last = height - height / 2;
+	} else {
+		first = 0;
+		last = height;
+	}
+
+	if (!mirror && !invert)
+		return;
+	for (i = first; i < last; i++) {
+		unsigned char *row = data + i * width;
+
+		if (mirror) {
+			memcpy(rowbuf, row, width);
+			standardize_row(row, rowbuf, width, TRUE, invert);
+		} else {
+			standardize_row(row, row, width, FALSE, invert);
+		}
+	}
 }
 
 /** \ingroup img
@@ -219,20 +532,199 @@ static void invert_colors(struct fp_img *img)
  */
 API_EXPORTED void fp_img_standardize(struct fp_img *img)
 {
-	if (img->flags & FP_IMG_V_FLIPPED) {
-		vflip(img);
-		img->flags &= ~FP_IMG_V_FLIPPED;
+	if (!(img->flags & FP_IMG_STANDARDIZATION_FLAGS))
+		return;
+
+	standardize_image(img->data, img->width, img->height, img->flags);
+	img->flags &= ~FP_IMG_STANDARDIZATION_FLAGS;
+}
+
+/* Upscaling uses the Mitchell-Netravali cubic (B = C = 1/3), the filter
+ * ImageMagick applies by default when enlarging. Its slight smoothing helps
+ * NBIS on small sensor images. The filter has a support of 2 source pixels,
+ * so every output pixel is a weighted sum of at most SCALE_TAPS source
+ * pixels along each axis. Weights are fixed point with SCALE_WEIGHT_BITS
+ * fractional bits and the intermediate image keeps SCALE_TMP_BITS
+ * fractional bits, so both passes run on 16-bit integers. */
+#define SCALE_TAPS		4
+#define SCALE_WEIGHT_BITS	12
+#define SCALE_TMP_BITS		4
+
+struct scale_taps {
+	int start;
+	int16_t weight[SCALE_TAPS];
+};
+
+static double mitchell(double t)
+{
+	const double b = 1.0 / 3.0;
+	const double c = 1.0 / 3.0;
+
+	t = fabs(t);
+	if (t < 1.0)
+		return ((12 - 9 * b - 6 * c) * t * t * t
+			+ (-18 + 12 * b + 6 * c) * t * t + (6 - 2 * b)) / 6;
+	if (t < 2.0)
+		return ((-b - 6 * c) * t * t * t + (6 * b + 30 * c) * t * t
+			+ (-12 * b - 48 * c) * t + (8 * b + 24 * c)) / 6;
+	return 0.0;
+}
+
+/* Computes the source taps for each of the len * factor output coordinates
+ * along one axis. With an integer factor the weights only depend on the
+ * output phase, so they are computed once per phase; only coordinates near
+ * the edges, whose taps fall outside the image, are renormalized over the
+ * taps that remain. Taps are always kept inside the image with zero weight
+ * where needed, so the passes never have to check bounds. */
+static void compute_scale_taps(struct scale_taps *taps, int len,
+	unsigned int factor)
+{
+	double phase_weight[factor][SCALE_TAPS];
+	int phase_offset[factor];
+	int out_len = len * factor;
+	unsigned int p;
+	int i, k;
+
+	for (p = 0; p < factor; p++) {
+		/* source coordinate of this phase's centre, relative to the
+		 * source pixel the output pixel lies in */
+		double centre = (p + 0.5) / factor;
+
+		phase_offset[p] = (int) floor(centre - 1.5);
+		for (k = 0; k < SCALE_TAPS; k++)
+			phase_weight[p][k] =
+				mitchell(phase_offset[p] + k + 0.5 - centre);
 	}
-	if (img->flags & FP_IMG_H_FLIPPED) {
-		hflip(img);
-		img->flags &= ~FP_IMG_H_FLIPPED;
+
+	for (i = 0; i < out_len; i++) {
+		struct scale_taps *t = &taps[i];
+		double *w = phase_weight[i % factor];
+		int start = i / factor + phase_offset[i % factor];
+		double density = 0.0;
+		double weight[SCALE_TAPS];
+		int sum = 0;
+		int max = 0;
+
+		for (k = 0; k < SCALE_TAPS; k++) {
+			int pos = start + k;
+			weight[k] = (pos >= 0 && pos < len) ? w[k] : 0.0;
+			density += weight[k];
+		}
+
+		/* shift the window back inside the image; the taps that move
+		 * in have zero weight */
+		t->start = CLAMP(start, 0, MAX(len - SCALE_TAPS, 0));
+		memset(t->weight, 0, sizeof(t->weight));
+		for (k = 0; k < SCALE_TAPS; k++) {
+			int slot = start + k - t->start;
+			if (weight[k] == 0.0)
+				continue;
+			t->weight[slot] = (int16_t) floor(weight[k] / density
+				* (1 << SCALE_WEIGHT_BITS) + 0.5);
+			sum += t->weight[slot];
+			if (t->weight[slot] > t->weight[max])
+				max = slot;
+		}
+		/* make the weights sum to exactly one so flat areas stay flat */
+		t->weight[max] += (1 << SCALE_WEIGHT_BITS) - sum;
+	}
+}
+
+/* Horizontal pass over one source row, giving one intermediate row. */
+static void scale_row(int16_t *dst, const unsigned char *src,
+	const struct scale_taps *taps, int out_width)
+{
+	int x;
+
+	for (x = 0; x < out_width; x++) {
+		const unsigned char *s = src + taps[x].start;
+		const int16_t *w = taps[x].weight;
+		int acc = w[0] * s[0] + w[1] * s[1] + w[2] * s[2] + w[3] * s[3];
+
+		dst[x] = (acc + (1 << (SCALE_WEIGHT_BITS - SCALE_TMP_BITS - 1)))
+			>> (SCALE_WEIGHT_BITS - SCALE_TMP_BITS);
 	}
-	if (img->flags & FP_IMG_COLORS_INVERTED) {
-		invert_colors(img);
-		img->flags &= ~FP_IMG_COLORS_INVERTED;
+}
+
+/* Vertical pass: combines SCALE_TAPS intermediate rows into one output row.
+ * The rows are contiguous, non-overlapping 16-bit arrays and the weights are
+ * constant along the row, so a vectorizing compiler turns this loop into
+ * packed 16-bit multiply-adds. */
+static void scale_column(unsigned char *restrict dst,
+	const int16_t *restrict r0, const int16_t *restrict r1,
+	const int16_t *restrict r2, const int16_t *restrict r3,
+	const int16_t *w, int width)
+{
+	const int shift = SCALE_WEIGHT_BITS + SCALE_TMP_BITS;
+	int w0 = w[0], w1 = w[1], w2 = w[2], w3 = w[3];
+	int x;
+
+	for (x = 0; x < width; x++) {
+		int acc = w0 * r0[x] + w1 * r1[x] + w2 * r2[x] + w3 * r3[x];
+
+		acc = (acc + (1 << (shift - 1))) >> shift;
+		dst[x] = acc < 0 ? 0 : (acc > 255 ? 255 : acc);
 	}
 }
 
+/* Enlarges an image by an integer factor in each dimension, for drivers
+ * whose sensors are too small for NBIS to process reliably. The input image
+ * is not freed. */
+struct fp_img *fpi_img_scale(struct fp_img *img, unsigned int factor)
+{
+	int width = img->width;
+	int height = img->height;
+	int new_width = width * factor;
+	int new_height = height * factor;
+	struct fp_img *newimg;
+	struct scale_taps *xtaps;
+	struct scale_taps *ytaps;
+	int16_t *tmp;
+	int row;
+
+	/* the enlarged image replaces the source, so it shares its pool */
+	if (img->pool)
+		newimg = img_pool_get(img->pool, new_width * new_height);
+	else
+		newimg = fpi_img_new(new_width * new_height);
+	newimg->width = new_width;
+	newimg->height = new_height;
+	newimg->flags = img->flags;
+
+	/* images narrower than the filter just have their pixels repeated */
+	if (factor == 1 || width < SCALE_TAPS || height < SCALE_TAPS) {
+		int x;
+		for (row = 0; row < new_height; row++)
+			for (x = 0; x < new_width; x++)
+				newimg->data[row * new_width + x] =
+					img->data[(row / factor) * width + x / factor];
+		return newimg;
+	}
+
+	xtaps = g_malloc(new_width * sizeof(*xtaps));
+	ytaps = g_malloc(new_height * sizeof(*ytaps));
+	tmp = g_malloc(height * new_width * sizeof(*tmp));
+	compute_scale_taps(xtaps, width, factor);
+	compute_scale_taps(ytaps, height, factor);
+
+	/* the horizontal pass runs over the source rows only; the vertical
+	 * pass, which produces every output row, is the vectorized one */
+	for (row = 0; row < height; row++)
+		scale_row(tmp + row * new_width, img->data + row * width, xtaps,
+			new_width);
+	for (row = 0; row < new_height; row++) {
+		const int16_t *r = tmp + ytaps[row].start * new_width;
+		scale_column(newimg->data + row * new_width, r, r + new_width,
+			r + 2 * new_width, r + 3 * new_width, ytaps[row].weight,
+			new_width);
+	}
+
+	g_free(tmp);
+	g_free(ytaps);
+	g_free(xtaps);
+	return newimg;
+}
+
 /* Based on write_minutiae_XYTQ and bz_load */
 static void minutiae_to_xyt(struct fp_minutiae *minutiae, int bwidth,
 	int bheight, unsigned char *buf)
@@ -268,12 +760,12 @@ static void minutiae_to_xyt(struct fp_minutiae *minutiae, int bwidth,
 	xyt->nrows = nmin;
 }
 
-int fpi_img_detect_minutiae(struct fp_img *img)
+static int detect_minutiae(struct fp_img *img, LFSCTX *lfsctx,
+	LFSSTREAM *lfsstream)
 {
 	struct fp_minutiae *minutiae;
 	int r;
-	int *direction_map, *low_contrast_map, *low_flow_map;
-	int *high_curve_map, *quality_map;
+	int *maps[FP_IMG_NR_MAPS];
 	int map_w, map_h;
 	unsigned char *bdata;
 	int bw, bh, bd;
@@ -286,11 +778,28 @@ int fpi_img_detect_minutiae(struct fp_img *img)
 
 	/* 25.4 mm per inch */
 	timer = g_timer_new();
-	r = get_minutiae(&minutiae, &quality_map, &direction_map,
-                         &low_contrast_map, &low_flow_map, &high_curve_map,
-                         &map_w, &map_h, &bdata, &bw, &bh, &bd,
-                         img->data, img->width, img->height, 8,
-						 DEFAULT_PPI / (double)25.4, &lfsparms_V2);
+	if (img->maps[FP_IMG_MAP_QUALITY])
+		r = get_minutiae_from_maps(&minutiae, &bdata, &bw, &bh, &bd,
+			img->maps[FP_IMG_MAP_QUALITY], img->maps[FP_IMG_MAP_DIRECTION],
+			img->maps[FP_IMG_MAP_LOW_CONTRAST],
+			img->maps[FP_IMG_MAP_LOW_FLOW], img->maps[FP_IMG_MAP_HIGH_CURVE],
+			img->map_width, img->map_height,
+			img->data, img->width, img->height, 8,
+			DEFAULT_PPI / (double)25.4, lfsctx);
+	else if (lfsstream)
+		r = get_minutiae_stream(&minutiae, &maps[FP_IMG_MAP_QUALITY],
+			&maps[FP_IMG_MAP_DIRECTION], &maps[FP_IMG_MAP_LOW_CONTRAST],
+			&maps[FP_IMG_MAP_LOW_FLOW], &maps[FP_IMG_MAP_HIGH_CURVE],
+			&map_w, &map_h, &bdata, &bw, &bh, &bd,
+			img->data, img->width, img->height, 8,
+			DEFAULT_PPI / (double)25.4, lfsstream);
+	else
+		r = get_minutiae(&minutiae, &maps[FP_IMG_MAP_QUALITY],
+			&maps[FP_IMG_MAP_DIRECTION], &maps[FP_IMG_MAP_LOW_CONTRAST],
+			&maps[FP_IMG_MAP_LOW_FLOW], &maps[FP_IMG_MAP_HIGH_CURVE],
+			&map_w, &map_h, &bdata, &bw, &bh, &bd,
+			img->data, img->width, img->height, 8,
+			DEFAULT_PPI / (double)25.4, lfsctx);
 	g_timer_stop(timer);
 	fp_dbg("minutiae scan completed in %f secs", g_timer_elapsed(timer, NULL));
 	g_timer_destroy(timer);
@@ -302,22 +811,268 @@ int fpi_img_detect_minutiae(struct fp_img *img)
 	img->minutiae = minutiae;
 	img->binarized = bdata;
 
-	free(quality_map);
+	/* keep the maps for fp_img_get_map() */
+	if (!img->maps[FP_IMG_MAP_QUALITY]) {
+		memcpy(img->maps, maps, sizeof(maps));
+		img->map_width = map_w;
+		img->map_height = map_h;
+	}
+	return minutiae->num;
+}
+
+/* Computes only the block maps of an image, which is enough for assessing
+ * its quality. Minutiae detection can later pick up from the stored maps. */
+static int compute_maps(struct fp_img *img, LFSCTX *lfsctx)
+{
+	int *maps[FP_IMG_NR_MAPS];
+	int map_w, map_h;
+	int r;
+
+	if (img->flags & FP_IMG_STANDARDIZATION_FLAGS) {
+		fp_err("cant compute maps for non-standardized image");
+		return -EINVAL;
+	}
+
+	r = get_maps(&maps[FP_IMG_MAP_QUALITY], &maps[FP_IMG_MAP_DIRECTION],
+		&maps[FP_IMG_MAP_LOW_CONTRAST], &maps[FP_IMG_MAP_LOW_FLOW],
+		&maps[FP_IMG_MAP_HIGH_CURVE], &map_w, &map_h,
+		img->data, img->width, img->height, 8, lfsctx);
+	if (r) {
+		fp_err("get maps failed, code %d", r);
+		return r;
+	}
+
+	memcpy(img->maps, maps, sizeof(maps));
+	img->map_width = map_w;
+	img->map_height = map_h;
+	return 0;
+}
+
+int fpi_img_compute_maps(struct fp_img *img)
+{
+	LFSCTX *lfsctx;
+	int r;
+
+	r = alloc_lfsctx(&lfsctx, &lfsparms_V2);
+	if (r) {
+		fp_err("extraction context allocation failed, code %d", r);
+		return r;
+	}
+
+	r = compute_maps(img, lfsctx);
+	free_lfsctx(lfsctx);
+	return r;
+}
+
+int fpi_img_detect_minutiae(struct fp_img *img)
+{
+	LFSCTX *lfsctx;
+	int r;
+
+	r = alloc_lfsctx(&lfsctx, &lfsparms_V2);
+	if (r) {
+		fp_err("extraction context allocation failed, code %d", r);
+		return r;
+	}
+
+	r = detect_minutiae(img, lfsctx, NULL);
+	free_lfsctx(lfsctx);
+	return r;
+}
+
+/* Preview maps are made up of blocks covering 8x8 pixels of the full image,
+ * about 0.17mm2 at 500ppi. Fingerprints carry roughly one minutia for every
+ * 4mm2 of ridge flow. */
+#define PREVIEW_BLOCKS_PER_MINUTIA 25
+
+/* Quick assessment of a standardized image from the maps computed by
+ * get_preview_maps() with lfsctx, a context for lfsparms_preview. Reports
+ * the percentage of the image where ridge flow was found, and the number of
+ * minutiae expected in that area. */
+static int preview_flow(struct fp_img *img, LFSCTX *lfsctx, int *foreground,
+	int *minutiae)
+{
+	int *direction_map, *low_contrast_map;
+	int map_w, map_h;
+	int i, nblocks, flow = 0;
+	GTimer *timer;
+	int r;
+
+	timer = g_timer_new();
+	r = get_preview_maps(&direction_map, &low_contrast_map, &map_w, &map_h,
+		img->data, img->width, img->height, lfsctx);
+	g_timer_stop(timer);
+	fp_dbg("preview completed in %f secs", g_timer_elapsed(timer, NULL));
+	g_timer_destroy(timer);
+	if (r) {
+		fp_err("get preview maps failed, code %d", r);
+		return r;
+	}
+
+	nblocks = map_w * map_h;
+	for (i = 0; i < nblocks; i++)
+		if (!low_contrast_map[i] && direction_map[i] != INVALID_DIR)
+			flow++;
 	free(direction_map);
 	free(low_contrast_map);
-	free(low_flow_map);
-	free(high_curve_map);
-	return minutiae->num;
+
+	*foreground = nblocks ? (flow * 100) / nblocks : 0;
+	*minutiae = flow / PREVIEW_BLOCKS_PER_MINUTIA;
+	return 0;
 }
 
-int fpi_img_to_print_data(struct fp_img_dev *imgdev, struct fp_img *img,
-	struct fp_print_data **ret)
+/* Previews an image captured by imgdev, see preview_flow(). The preview
+ * context of imgdev is allocated on first use and kept for later images. */
+int fpi_img_preview(struct fp_img_dev *imgdev, struct fp_img *img,
+	int *foreground, int *minutiae)
+{
+	int r;
+
+	if (img->flags & FP_IMG_STANDARDIZATION_FLAGS) {
+		fp_err("cant preview non-standardized image");
+		return -EINVAL;
+	}
+
+	if (!imgdev->preview_lfsctx) {
+		r = alloc_lfsctx(&imgdev->preview_lfsctx, &lfsparms_preview);
+		if (r) {
+			fp_err("preview context allocation failed, code %d", r);
+			return r;
+		}
+	}
+
+	return preview_flow(img, imgdev->preview_lfsctx, foreground, minutiae);
+}
+
+/* Returns the extraction context of an imaging device, allocating it the
+ * first time. The context holds the lookup tables and the padded image
+ * buffer, which are reused from one capture to the next. */
+static LFSCTX *imgdev_lfsctx(struct fp_img_dev *imgdev)
+{
+	int r;
+
+	if (!imgdev->lfsctx) {
+		r = alloc_lfsctx(&imgdev->lfsctx, &lfsparms_V2);
+		if (r)
+			fp_err("extraction context allocation failed, code %d", r);
+	}
+	return imgdev->lfsctx;
+}
+
+/* Streaming extraction for swipe sensors. The driver feeds each row as it
+ * is assembled, and the block analysis behind the direction map is done
+ * for every part of the image that is complete, so that little work is
+ * left by the time the finger is lifted. Rows must arrive bottom row first,
+ * which is the order in which swipe drivers build their images. Errors
+ * are not fatal: the image then simply goes through regular detection. */
+struct fpi_img_stream {
+	/* the device's context, see imgdev_lfsctx() */
+	LFSCTX *lfsctx;
+	LFSSTREAM *lfsstream;
+	int error;
+};
+
+/* Starts streamed detection for a capture on imgdev. The stream borrows the
+ * device's extraction context, which must not be used for anything else
+ * until the stream has been finished or freed. */
+struct fpi_img_stream *fpi_img_stream_new(struct fp_img_dev *imgdev,
+	int width, int max_height)
+{
+	struct fpi_img_stream *stream = g_malloc0(sizeof(*stream));
+	int r;
+
+	stream->lfsctx = imgdev_lfsctx(imgdev);
+	if (!stream->lfsctx) {
+		stream->error = -ENOMEM;
+		return stream;
+	}
+
+	r = alloc_lfsstream(&stream->lfsstream, stream->lfsctx, width,
+		max_height);
+	if (r) {
+		fp_err("stream setup failed, code %d", r);
+		stream->error = r;
+	}
+	return stream;
+}
+
+void fpi_img_stream_free(struct fpi_img_stream *stream)
+{
+	if (!stream)
+		return;
+
+	free_lfsstream(stream->lfsstream);
+	g_free(stream);
+}
+
+/* Adds the row directly above the previously added one. */
+void fpi_img_stream_add_row(struct fpi_img_stream *stream,
+	const unsigned char *row)
+{
+	int r;
+
+	if (!stream || stream->error)
+		return;
+
+	r = add_lfsstream_row(stream->lfsstream, row);
+	if (r) {
+		fp_err("stream analysis failed, code %d", r);
+		stream->error = r;
+	}
+}
+
+/* Completes detection on the final image, which must be standardized and
+ * made up of the streamed rows. The block grid must line up with the rows
+ * that were analysed early, so the rows in excess of a multiple of the
+ * block size are cropped from the top of the image, where the last rows
+ * were captured. An image shorter than one block is left alone and
+ * -EINVAL returned. Returns the number of minutiae detected, or a negative
+ * error code, in which case the image may still be used as normal. */
+int fpi_img_stream_finish(struct fpi_img_stream *stream, struct fp_img *img)
+{
+	int blocksize = lfsparms_V2.blocksize;
+	int height = (img->height / blocksize) * blocksize;
+
+	if (!stream)
+		return -EINVAL;
+	if (stream->error)
+		return stream->error;
+	if (img->flags & FP_IMG_STANDARDIZATION_FLAGS) {
+		fp_err("cant detect minutiae for non-standardized image");
+		return -EINVAL;
+	}
+	if (img->width != stream->lfsstream->iw
+			|| img->height != stream->lfsstream->nrows) {
+		fp_err("image does not match stream");
+		return -EINVAL;
+	}
+	if (height == 0) {
+		fp_dbg("%d rows is too short for streamed detection", img->height);
+		return -EINVAL;
+	}
+
+	if (height < img->height) {
+		fp_dbg("cropping %d rows for block alignment", img->height - height);
+		memmove(img->data,
+			img->data + ((img->height - height) * img->width),
+			height * img->width);
+		img->height = height;
+	}
+
+	return detect_minutiae(img, stream->lfsctx, stream->lfsstream);
+}
+
+static int img_to_print_data(uint16_t driver_id, uint32_t devtype,
+	struct fp_img *img, LFSCTX *lfsctx, struct fp_print_data **ret)
 {
 	struct fp_print_data *print;
 	int r;
 
 	if (!img->minutiae) {
-		r = fpi_img_detect_minutiae(img);
+		if (lfsctx)
+			r = detect_minutiae(img, lfsctx, NULL);
+		else
+			r = fpi_img_detect_minutiae(img);
 		if (r < 0)
 			return r;
 		if (!img->minutiae) {
@@ -328,8 +1083,8 @@ int fpi_img_to_print_data(struct fp_img_dev *imgdev, struct fp_img *img,
 
 	/* FIXME: space is wasted if we dont hit the max minutiae count. would
 	 * be good to make this dynamic. */
-	print = fpi_print_data_new(imgdev->dev, sizeof(struct xyt_struct));
-	print->type = PRINT_DATA_NBIS_MINUTIAE;
+	print = fpi_print_data_alloc(driver_id, devtype, PRINT_DATA_NBIS_MINUTIAE,
+		sizeof(struct xyt_struct));
 	minutiae_to_xyt(img->minutiae, img->width, img->height, print->data);
 
 	/* FIXME: the print buffer at this point is endian-specific, and will
@@ -340,6 +1095,160 @@ int fpi_img_to_print_data(struct fp_img_dev *imgdev, struct fp_img *img,
 	return 0;
 }
 
+int fpi_img_to_print_data(struct fp_img_dev *imgdev, struct fp_img *img,
+	struct fp_print_data **ret)
+{
+	struct fp_dev *dev = imgdev->dev;
+
+	return img_to_print_data(dev->drv->id, dev->devtype, img,
+		imgdev_lfsctx(imgdev), ret);
+}
+
+struct batch_job {
+	struct fp_img **imgs;
+	struct fp_print_data **prints;
+	int nr_imgs;
+	uint16_t driver_id;
+	uint32_t devtype;
+
+	pthread_mutex_t lock;
+	int next;
+	int error;
+};
+
+/* Records the first error of the job, which stops all workers from taking
+ * further images. */
+static void batch_fail(struct batch_job *job, int error)
+{
+	pthread_mutex_lock(&job->lock);
+	if (!job->error)
+		job->error = error;
+	pthread_mutex_unlock(&job->lock);
+}
+
+static void *batch_worker(void *data)
+{
+	struct batch_job *job = data;
+	LFSCTX *lfsctx = NULL;
+	int ctx_error;
+
+	/* each worker keeps one extraction context for all of its images */
+	ctx_error = alloc_lfsctx(&lfsctx, &lfsparms_V2);
+	if (ctx_error) {
+		fp_err("extraction context allocation failed, code %d", ctx_error);
+		batch_fail(job, ctx_error);
+		return NULL;
+	}
+
+	while (1) {
+		int i, r;
+
+		pthread_mutex_lock(&job->lock);
+		i = job->error ? job->nr_imgs : job->next++;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->nr_imgs)
+			break;
+
+		r = img_to_print_data(job->driver_id, job->devtype, job->imgs[i],
+			lfsctx, &job->prints[i]);
+		if (r) {
+			fp_err("extraction of image %d failed, code %d", i, r);
+			batch_fail(job, r);
+		}
+	}
+
+	free_lfsctx(lfsctx);
+	return NULL;
+}
+
+/** \ingroup img
+ * Extracts prints from a set of images in one go, spreading the work over
+ * a pool of threads (one per online CPU, including the calling thread).
+ * This is intended for re-processing archived captures, where handling one
+ * image at a time leaves most of the machine idle.
+ *
+ * The images must have been \ref img_std "standardized" and must all be
+ * distinct; images which already had their minutiae detected are not
+ * processed again. The resulting prints are tagged with the given driver ID
+ * and device type, so that they can be compared against prints enrolled
+ * on a compatible device (see fp_print_data_get_driver_id() and
+ * fp_print_data_get_devtype()).
+ *
+ * \param imgs array of standardized images
+ * \param nr_imgs number of entries in the imgs array
+ * \param driver_id the driver ID to record in the resulting prints
+ * \param devtype the device type to record in the resulting prints
+ * \param prints output array with room for nr_imgs prints. On success,
+ * prints[i] holds the print extracted from imgs[i]; each must be freed with
+ * fp_print_data_free() after use. On error, nothing is stored.
+ * \returns 0 on success, negative error code on failure
+ */
+API_EXPORTED int fp_img_batch_to_print_data(struct fp_img **imgs,
+	int nr_imgs, uint16_t driver_id, uint32_t devtype,
+	struct fp_print_data **prints)
+{
+	struct batch_job job;
+	pthread_t *threads;
+	long nr_threads;
+	int i, r;
+
+	if (nr_imgs <= 0)
+		return nr_imgs ? -EINVAL : 0;
+
+	for (i = 0; i < nr_imgs; i++)
+		if (imgs[i]->flags & FP_IMG_STANDARDIZATION_FLAGS) {
+			fp_err("cant detect minutiae for non-standardized image %d", i);
+			return -EINVAL;
+		}
+
+	nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads < 1)
+		nr_threads = 1;
+	if (nr_threads > nr_imgs)
+		nr_threads = nr_imgs;
+
+	memset(&job, 0, sizeof(job));
+	job.imgs = imgs;
+	job.prints = prints;
+	job.nr_imgs = nr_imgs;
+	job.driver_id = driver_id;
+	job.devtype = devtype;
+	pthread_mutex_init(&job.lock, NULL);
+	memset(prints, 0, nr_imgs * sizeof(*prints));
+
+	fp_dbg("extracting %d images on %ld threads", nr_imgs, nr_threads);
+	threads = g_malloc(nr_threads * sizeof(*threads));
+	for (i = 0; i < nr_threads - 1; i++) {
+		r = pthread_create(&threads[i], NULL, batch_worker, &job);
+		if (r) {
+			fp_err("could not create worker thread, error %d", r);
+			break;
+		}
+	}
+
+	/* the calling thread helps out as well, which also covers the case where
+	 * no worker thread could be started */
+	batch_worker(&job);
+	while (i--)
+		pthread_join(threads[i], NULL);
+	g_free(threads);
+	pthread_mutex_destroy(&job.lock);
+
+	r = job.error;
+	for (i = 0; i < nr_imgs; i++)
+		if (!prints[i] && !r)
+			r = -EIO;
+	if (r) {
+		for (i = 0; i < nr_imgs; i++) {
+			fp_print_data_free(prints[i]);
+			prints[i] = NULL;
+		}
+		return r;
+	}
+
+	return 0;
+}
+
 int fpi_img_compare_print_data(struct fp_print_data *enrolled_print,
 	struct fp_print_data *new_print)
 {
@@ -475,3 +1384,118 @@ API_EXPORTED struct fp_minutia **fp_img_get_minutiae(struct fp_img *img,
 	return img->minutiae->list;
 }
 
+/** \ingroup img
+ * Get one of the block maps computed by the minutiae extractor for an image,
+ * such as its ridge flow directions or the quality of each of its blocks.
+ * These are useful for judging the quality of a scan, or finding the area
+ * covered by the finger.
+ *
+ * The image must have been \ref img_std "standardized" otherwise this function
+ * will fail.
+ *
+ * If minutiae have already been detected in the image, the maps computed
+ * along the way are returned. Otherwise only the maps are computed, which
+ * takes about half of the time of full minutiae detection, and a
+ * later call to fp_img_get_minutiae() carries on from them.
+ *
+ * The returned map is only valid while the parent image has not been freed,
+ * and must not be modified or freed.
+ *
+ * \param img a standardized image
+ * \param type the map to return
+ * \param width an output location to store the width of the map in blocks
+ * \param height an output location to store the height of the map in blocks
+ * \returns the map, or NULL on error. Must not be modified or freed.
+ */
+API_EXPORTED const int *fp_img_get_map(struct fp_img *img,
+	enum fp_img_map_type type, int *width, int *height)
+{
+	if (img->flags & FP_IMG_BINARIZED_FORM) {
+		fp_err("image is binarized");
+		return NULL;
+	}
+
+	if (type < 0 || type >= FP_IMG_NR_MAPS) {
+		fp_err("unknown map type %d", type);
+		return NULL;
+	}
+
+	if (!img->maps[type]) {
+		int r = fpi_img_compute_maps(img);
+		if (r < 0)
+			return NULL;
+	}
+
+	*width = img->map_width;
+	*height = img->map_height;
+	return img->maps[type];
+}
+
+/* Requirements for each of the levels of enum fp_img_quality, best first:
+ * the number of minutiae expected from the ridge flow found by the preview,
+ * and the percentage of the image that flow covers. */
+static const struct {
+	int minutiae;
+	int foreground;
+} quality_levels[] = {
+	{ 40, 65 },	/* FP_IMG_QUALITY_EXCELLENT */
+	{ 30, 50 },	/* FP_IMG_QUALITY_VERY_GOOD */
+	{ 20, 40 },	/* FP_IMG_QUALITY_GOOD */
+	{ 10, 25 },	/* FP_IMG_QUALITY_FAIR */
+};
+
+/** \ingroup img
+ * Rates the quality of a standardized image on a scale from 1 (best) to 5
+ * (worst), following the same principle as NIST's NFIQ: what matters is how
+ * many minutiae can be expected, and over how much of the image the ridges
+ * are clear. The rating is made from the same half resolution maps of ridge
+ * flow as the assessment passed to the callback of
+ * fp_dev_set_preview_callback(), with fixed thresholds in place of NFIQ's
+ * trained classifier, so the levels are only comparable with NFIQ scores in
+ * spirit. As the expected minutiae follow from the print area, images from
+ * small sensors rate lower.
+ *
+ * Rating an image takes a few milliseconds, a fraction of the cost of
+ * detecting its minutiae. It does not depend on whether minutiae have been
+ * detected already, so the ratings of several scans of the same finger can
+ * be compared to keep the best one.
+ *
+ * The image must have been \ref img_std "standardized" otherwise this function
+ * will fail.
+ *
+ * \param img a standardized image
+ * \returns a level from #fp_img_quality, or a negative error code
+ */
+API_EXPORTED int fp_img_get_quality(struct fp_img *img)
+{
+	LFSCTX *lfsctx;
+	int foreground, minutiae;
+	int i, r;
+
+	if (img->flags & FP_IMG_BINARIZED_FORM) {
+		fp_err("image is binarized");
+		return -EINVAL;
+	}
+	if (img->flags & FP_IMG_STANDARDIZATION_FLAGS) {
+		fp_err("cant rate non-standardized image");
+		return -EINVAL;
+	}
+
+	r = alloc_lfsctx(&lfsctx, &lfsparms_preview);
+	if (r) {
+		fp_err("preview context allocation failed, code %d", r);
+		return r;
+	}
+	r = preview_flow(img, lfsctx, &foreground, &minutiae);
+	free_lfsctx(lfsctx);
+	if (r)
+		return r;
+
+	fp_dbg("%d%% foreground, ~%d minutiae", foreground, minutiae);
+	for (i = 0; i < G_N_ELEMENTS(quality_levels); i++)
+		if (minutiae >= quality_levels[i].minutiae
+				&& foreground >= quality_levels[i].foreground)
+			return FP_IMG_QUALITY_EXCELLENT + i;
+	return FP_IMG_QUALITY_POOR;
+}
+
@@ -18,10 +18,12 @@
  */
 
 #include <errno.h>
+#include <stdlib.h>
 
 #include <glib.h>
 
 #include "fp_internal.h"
+#include "nbis/include/lfs.h"
 
 #define MIN_ACCEPTABLE_MINUTIAE 10
 #define BOZORTH3_DEFAULT_THRESHOLD 40
@@ -30,12 +32,23 @@ static int img_dev_open(struct fp_dev *dev, unsigned long driver_data)
 {
 	struct fp_img_dev *imgdev = g_malloc0(sizeof(*imgdev));
 	struct fp_img_driver *imgdrv = fpi_driver_to_img_driver(dev->drv);
+	const char *record = getenv("LIBFPRINT_RECORD");
 	int r = 0;
 
 	imgdev->dev = dev;
 	dev->priv = imgdev;
 	dev->nr_enroll_stages = 1;
 
+	if (imgdrv->img_width > 0 && imgdrv->img_height > 0)
+		imgdev->img_pool = fpi_img_pool_new(imgdrv->img_width
+			* imgdrv->img_height);
+	else
+		imgdev->img_pool = fpi_img_pool_new(0);
+
+	/* opt-in recording of raw captures, for replaying sessions offline */
+	if (record)
+		imgdev->recorder = fpi_recorder_open(record);
+
 	/* for consistency in driver code, allow udev access through imgdev */
 	imgdev->udev = dev->udev;
 
@@ -49,6 +62,8 @@ static int img_dev_open(struct fp_dev *dev, unsigned long driver_data)
 
 	return 0;
 err:
+	fpi_recorder_close(imgdev->recorder);
+	fpi_img_pool_unref(imgdev->img_pool);
 	g_free(imgdev);
 	return r;
 }
@@ -72,6 +87,10 @@ static void img_dev_close(struct fp_dev *dev)
 void fpi_imgdev_close_complete(struct fp_img_dev *imgdev)
 {
 	fpi_drvcb_close_complete(imgdev->dev);
+	free_lfsctx(imgdev->lfsctx);
+	free_lfsctx(imgdev->preview_lfsctx);
+	fpi_recorder_close(imgdev->recorder);
+	fpi_img_pool_unref(imgdev->img_pool);
 	g_free(imgdev);
 }
 
@@ -126,6 +145,8 @@ void fpi_imgdev_report_finger_status(struct fp_img_dev *imgdev,
 	fp_dbg(present ? "finger on sensor" : "finger removed");
 
 	if (present && imgdev->action_state == IMG_ACQUIRE_STATE_AWAIT_FINGER_ON) {
+		if (imgdev->recorder)
+			fpi_recorder_finger_on(imgdev->recorder);
 		dev_change_state(imgdev, IMGDEV_STATE_CAPTURE);
 		imgdev->action_state = IMG_ACQUIRE_STATE_AWAIT_IMAGE;
 		return;
@@ -148,7 +169,7 @@ void fpi_imgdev_report_finger_status(struct fp_img_dev *imgdev,
 		if (r > 0 && r != FP_ENROLL_COMPLETE && r != FP_ENROLL_FAIL) {
 			imgdev->action_result = 0;
 			imgdev->action_state = IMG_ACQUIRE_STATE_AWAIT_FINGER_ON;
-			dev_change_state(imgdev, IMG_ACQUIRE_STATE_AWAIT_FINGER_ON);
+			dev_change_state(imgdev, IMGDEV_STATE_AWAIT_FINGER_ON);
 		}
 		break;
 	case IMG_ACTION_VERIFY:
@@ -203,6 +224,32 @@ static void identify_process_img(struct fp_img_dev *imgdev)
 	imgdev->identify_match_offset = match_offset;
 }
 
+/* Gives the application a quick look at the image before the full minutiae
+ * detection is run. Returns non-zero if the scan should be retried. */
+static int preview_img(struct fp_img_dev *imgdev, struct fp_img *img)
+{
+	struct fp_dev *dev = imgdev->dev;
+	int foreground, minutiae;
+	int r;
+
+	r = fpi_img_preview(imgdev, img, &foreground, &minutiae);
+	if (r < 0)
+		return 0;
+
+	fp_dbg("preview: %d%% foreground, ~%d minutiae", foreground, minutiae);
+	return dev->preview_cb(dev, foreground, minutiae, dev->preview_cb_data);
+}
+
+/* Whether an image captured now will be turned into a print, rather than
+ * ignored. Drivers that analyse images while capturing use this to skip
+ * that work when it would be wasted. */
+gboolean fpi_imgdev_wants_print(struct fp_img_dev *imgdev)
+{
+	return imgdev->action != IMG_ACTION_NONE
+		&& imgdev->action_state == IMG_ACQUIRE_STATE_AWAIT_IMAGE
+		&& !imgdev->action_result;
+}
+
 void fpi_imgdev_image_captured(struct fp_img_dev *imgdev, struct fp_img *img)
 {
 	struct fp_print_data *print;
@@ -211,11 +258,13 @@ void fpi_imgdev_image_captured(struct fp_img_dev *imgdev, struct fp_img *img)
 
 	if (imgdev->action_state != IMG_ACQUIRE_STATE_AWAIT_IMAGE) {
 		fp_dbg("ignoring due to current state %d", imgdev->action_state);
+		fp_img_free(img);
 		return;
 	}
 
 	if (imgdev->action_result) {
 		fp_dbg("not overwriting existing action result");
+		fp_img_free(img);
 		return;
 	}
 
@@ -226,8 +275,18 @@ void fpi_imgdev_image_captured(struct fp_img_dev *imgdev, struct fp_img *img)
 		goto next_state;
 	}
 
+	if (imgdev->recorder)
+		fpi_recorder_write(imgdev->recorder, imgdev->dev, img);
+
 	fp_img_standardize(img);
 	imgdev->acquire_img = img;
+	if (imgdev->dev->preview_cb && preview_img(imgdev, img)) {
+		fp_dbg("scan rejected on preview");
+		/* depends on FP_ENROLL_RETRY == FP_VERIFY_RETRY */
+		imgdev->action_result = FP_ENROLL_RETRY;
+		goto next_state;
+	}
+
 	fpi_img_to_print_data(imgdev, img, &print);
 	if (img->minutiae->num < MIN_ACCEPTABLE_MINUTIAE) {
 		fp_dbg("not enough minutiae, %d/%d", img->minutiae->num,
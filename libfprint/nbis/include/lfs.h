@@ -75,6 +75,15 @@ identified are necessarily the best available for the purpose.
                  ? ((int)(((x)*(scale))-0.5))/(scale) \
                  : ((int)(((x)*(scale))+0.5))/(scale)))
 
+/* Kernels that are specialized for the default LFS parameters by      */
+/* calling them with constant dimensions.  They must be inlined into   */
+/* each caller for the constants to take effect.                       */
+#ifdef __GNUC__
+#define LFS_KERNEL static inline __attribute__((always_inline))
+#else
+#define LFS_KERNEL static
+#endif
+
 #ifndef M_PI
 #define M_PI		3.14159265358979323846	/* pi */
 #endif
@@ -100,10 +109,14 @@ typedef struct dftwave{
 
 /* DFT wave forms structure containing all wave forms  */
 /* to be used in DFT analysis.                         */
+/* For the default wave forms, qwaves points to a precomputed      */
+/* fixed-point copy (see dft_qwaves_V2) used by the integer DFT;    */
+/* for any other set it is NULL and the double waves are used.      */
 typedef struct dftwaves{
    int nwaves;
    int wavelen;
    DFTWAVE **waves;
+   const int *qwaves;
 }DFTWAVES;
 
 /* Rotated pixel offsets for a grid of specified dimensions */
@@ -242,6 +255,64 @@ typedef struct lfsparms{
    int    max_ridge_steps;
 } LFSPARMS;
 
+/* Caller-owned extraction context.  Holds every lookup table that     */
+/* get_minutiae() needs, so that no mutable state is shared between    */
+/* calls.  A context must only be used by one thread at a time, but   */
+/* any number of contexts may run concurrently.  The rotated grids     */
+/* depend on the padded image width, and are rebuilt only when an      */
+/* image of a different width is processed with the same context.      */
+/* The padded copy of the image is also kept, and only reallocated     */
+/* when a larger image comes along.                                    */
+typedef struct lfsctx{
+   const LFSPARMS *lfsparms;
+   int maxpad;
+   int iw;               /* Image width the rotated grids were built for. */
+   DIR2RAD *dir2rad;
+   DFTWAVES *dftwaves;
+   ROTGRIDS *dftgrids;
+   ROTGRIDS *dirbingrids;
+   unsigned char *pdata; /* Padded 6-bit image, see pad_lfsctx_image(). */
+   int pdata_size;       /* Allocated size (in bytes) of pdata. */
+} LFSCTX;
+
+/* Incremental extraction state for an image acquired one row at a     */
+/* time from the bottom up, as swipe sensors deliver it.  Rows are      */
+/* padded into a buffer sized for the tallest possible image, and the  */
+/* initial block analysis is run on each row of blocks as soon as all  */
+/* of its pixels have arrived.  See add_lfsstream_row().               */
+typedef struct lfsstream{
+   LFSCTX *lfsctx;
+   int iw;               /* Width (in pixels) of each row. */
+   int max_ih;           /* Maximum number of rows. */
+   int pw, ph;           /* Dimensions of the padded row buffer. */
+   unsigned char *pdata; /* 6-bit padded rows, filled from the bottom. */
+   int nrows;            /* Rows received so far. */
+   int mw;               /* Blocks in each row of blocks. */
+   int nblkrows;         /* Rows of blocks analyzed so far. */
+   /* Block offsets and initial maps, bottom row of blocks first. */
+   int *blkoffs;
+   int *direction_map;
+   int *low_contrast_map;
+   int *low_flow_map;
+} LFSSTREAM;
+
+/* Histogram of the intensities of a square window of 6-bit pixels,     */
+/* used for low contrast analysis.  As blocks are visited left to right */
+/* the histogram is slid across the image, adding and removing only    */
+/* the columns that enter and leave the window.  The bins are summed in */
+/* groups of 2^WINHIST_GROUP_BITS adjacent intensities for each lookup, */
+/* so that a percentile is located by walking at most 8 groups and 8    */
+/* bins.  See low_contrast_window().                                    */
+#define WINHIST_BINS            64    /* = IMG_6BIT_PIX_LIMIT */
+#define WINHIST_GROUP_BITS       3
+typedef struct winhist{
+   int size;             /* Width and height (in pixels) of the window. */
+   int prctthresh;       /* Pixel count at the contrast percentile. */
+   int win_x, win_y;     /* Window origin, win_x < 0 when empty. */
+   int bins[WINHIST_BINS];
+   int groups[WINHIST_BINS >> WINHIST_GROUP_BITS];
+} WINHIST;
+
 /*************************************************************************/
 /*        LFS CONSTANT DEFINITIONS                                       */
 /*************************************************************************/
@@ -370,6 +441,10 @@ typedef struct lfsparms{
 /* This specifies the number of DFT wave forms to be applied */
 #define NUM_DFT_WAVES            4
 
+/* Fixed-point scale (Q14) of the precomputed DFT wave tables.  With  */
+/* 24 rows of 24 8-bit pixels, the dot products stay below 2^31.      */
+#define DFT_QWAVE_SCALE      16384
+
 /* Minimum total DFT power for any given block  */
 /* which is used to compute an average power.   */
 /* By setting a non-zero minimum total,possible */
@@ -595,6 +670,26 @@ typedef struct lfsparms{
 /* Maximum number of contour steps taken to validate a ridge crossing. */
 #define MAX_RIDGE_STEPS         10
 
+
+/***** PREVIEW CONSTANTS *****/
+
+/* The preview maps are computed on the image subsampled by this factor */
+/* in each dimension.  See get_preview_maps().                          */
+#define PREVIEW_SCALE            2
+
+/* Block, window and offset sizes of the Version 2 maps divided by    */
+/* PREVIEW_SCALE, so each preview block covers the same area of the   */
+/* finger, and the same DFT frequencies fit in each window.           */
+#define MAP_BLOCKSIZE_PREVIEW    4
+#define MAP_WINDOWSIZE_PREVIEW  12
+#define MAP_WINDOWOFFSET_PREVIEW 4
+
+/* The DFT power of a window grows with the square of its pixel count, */
+/* so the power thresholds are POWMAX_MIN and POWMAX_MAX scaled by     */
+/* 1/(PREVIEW_SCALE^4).                                                */
+#define POWMAX_MIN_PREVIEW     6250.0
+#define POWMAX_MAX_PREVIEW  3125000.0
+
 /*************************************************************************/
 /*         QUALITY/RELIABILITY DEFINITIONS                               */
 /*************************************************************************/
@@ -610,6 +705,10 @@ typedef struct lfsparms{
 /* Ideal Mean of pixel values in a neighborhood. */
 #define IDEALMEAN    127
 
+/* Build summed-area tables for the neighborhood statistics once the */
+/* minutia neighborhoods cover this many times the image's pixels.   */
+#define QUALITY_INTEGRAL_RATIO 4
+
 /* Look for neighbors this many blocks away. */
 #define NEIGHBOR_DELTA 2
 
@@ -697,8 +796,9 @@ extern int dirbinarize(const unsigned char *, const int, const ROTGRIDS *);
 /* block.c */
 extern int block_offsets(int **, int *, int *, const int, const int,
                      const int, const int);
-extern int low_contrast_block(const int, const int,
-                     unsigned char *, const int, const int, const LFSPARMS *);
+extern void init_winhist(WINHIST *, const int, const LFSPARMS *);
+extern int low_contrast_window(WINHIST *, const int, const int,
+                     const unsigned char *, const int, const LFSPARMS *);
 extern int find_valid_block(int *, int *, int *, int *, int *,
                      const int, const int, const int, const int,
                      const int, const int);
@@ -733,7 +833,22 @@ extern int get_minutiae(MINUTIAE **, int **, int **, int **,
                  int **, int **, int *, int *,
                  unsigned char **, int *, int *, int *,
                  unsigned char *, const int, const int,
-                 const int, const double, const LFSPARMS *);
+                 const int, const double, LFSCTX *);
+extern int get_maps(int **, int **, int **, int **, int **, int *, int *,
+                 unsigned char *, const int, const int, const int, LFSCTX *);
+extern int get_minutiae_from_maps(MINUTIAE **,
+                 unsigned char **, int *, int *, int *,
+                 int *, int *, int *, int *, int *, const int, const int,
+                 unsigned char *, const int, const int,
+                 const int, const double, LFSCTX *);
+extern int add_lfsstream_row(LFSSTREAM *, const unsigned char *);
+extern int get_minutiae_stream(MINUTIAE **, int **, int **, int **,
+                 int **, int **, int *, int *,
+                 unsigned char **, int *, int *, int *,
+                 unsigned char *, const int, const int,
+                 const int, const double, LFSSTREAM *);
+extern int get_preview_maps(int **, int **, int *, int *,
+                 unsigned char *, const int, const int, LFSCTX *);
 
 /* dft.c */
 extern int dft_dir_powers(double **, unsigned char *, const int,
@@ -747,15 +862,21 @@ extern void free_dir2rad(DIR2RAD *);
 extern void free_dftwaves(DFTWAVES *);
 extern void free_rotgrids(ROTGRIDS *);
 extern void free_dir_powers(double **, const int);
+extern void free_lfsctx(LFSCTX *);
+extern void free_lfsstream(LFSSTREAM *);
 
 /* imgutil.c */
 extern void bits_6to8(unsigned char *, const int, const int);
 extern void bits_8to6(unsigned char *, const int, const int);
+extern int half_uchar_image(unsigned char **, int *, int *,
+                     unsigned char *, const int, const int);
 extern void gray2bin(const int, const int, const int,
                      unsigned char *, const int, const int);
 extern int pad_uchar_image(unsigned char **, int *, int *,
                      unsigned char *, const int, const int, const int,
                      const int);
+extern int transpose_uchar_image(unsigned char **, const unsigned char *,
+                     const int, const int);
 extern void fill_holes(unsigned char *, const int, const int);
 extern int free_path(const int, const int, const int, const int,
                      unsigned char *, const int, const int, const LFSPARMS *);
@@ -771,6 +892,11 @@ extern int init_rotgrids(ROTGRIDS **, const int, const int, const int,
                      const double, const int, const int, const int, const int);
 extern int alloc_dir_powers(double ***, const int, const int);
 extern int alloc_power_stats(int **, double **, int **, double **, const int);
+extern int alloc_lfsctx(LFSCTX **, const LFSPARMS *);
+extern int prepare_lfsctx(LFSCTX *, const int, const int);
+extern int pad_lfsctx_image(unsigned char **, int *, int *, LFSCTX *,
+                     const unsigned char *, const int, const int);
+extern int alloc_lfsstream(LFSSTREAM **, LFSCTX *, const int, const int);
 
 /* line.c */
 extern int line_points(int **, int **, int *,
@@ -806,6 +932,12 @@ extern int gen_initial_maps(int **, int **, int **,
                     int *, const int, const int,
                     unsigned char *, const int, const int,
                     const DFTWAVES *, const  ROTGRIDS *, const LFSPARMS *);
+extern int gen_initial_map_blocks(int *, int *, int *, const int *,
+                    const int, const int, unsigned char *, const int,
+                    const int, const DFTWAVES *, const ROTGRIDS *,
+                    const LFSPARMS *);
+extern int refine_image_maps(int **, int *, int *, int *,
+                    const int, const int, const DIR2RAD *, const LFSPARMS *);
 extern int interpolate_direction_map(int *, int *, const int, const int,
                     const LFSPARMS *);
 extern int morph_TF_map(int *, const int, const int, const LFSPARMS *);
@@ -859,6 +991,11 @@ extern void skip_repeated_horizontal_pair(int *, const int,
                      unsigned char **, unsigned char **, const int, const int);
 extern void skip_repeated_vertical_pair(int *, const int,
                      unsigned char **, unsigned char **, const int, const int);
+extern int next_unequal_pair(const unsigned char *, const unsigned char *,
+                     const int, const int);
+extern int next_changed_pair(const unsigned char *, const unsigned char *,
+                     const int, const int, const unsigned char,
+                     const unsigned char);
 
 /* minutia.c */
 extern int alloc_minutiae(MINUTIAE **, const int);
@@ -879,11 +1016,10 @@ extern int rm_dup_minutiae(MINUTIAE *);
 extern void dump_minutiae(FILE *, const MINUTIAE *);
 extern void dump_minutiae_pts(FILE *, const MINUTIAE *);
 extern void dump_reliable_minutiae_pts(FILE *, const MINUTIAE *, const double);
-extern int create_minutia(MINUTIA **, const int, const int,
+extern void init_minutia(MINUTIA *, const int, const int,
                      const int, const int, const int, const double,
                      const int, const int, const int);
 extern void free_minutiae(MINUTIAE *);
-extern void free_minutia(MINUTIA *);
 extern int remove_minutia(const int, MINUTIAE *);
 extern int join_minutia(const MINUTIA *, const MINUTIA *, unsigned char *,
                      const int, const int, const int, const int);
@@ -998,10 +1134,10 @@ extern int shape_from_contour(SHAPE **, const int *, const int *, const int);
 /* sort.c */
 extern int sort_indices_int_inc(int **, int *, const int);
 extern int sort_indices_double_inc(int **, double *, const int);
-extern void bubble_sort_int_inc_2(int *, int *, const int);
-extern void bubble_sort_double_inc_2(double *, int *, const int);
-extern void bubble_sort_double_dec_2(double *, int *,  const int);
-extern void bubble_sort_int_inc(int *, const int);
+extern void sort_int_inc_2(int *, int *, const int);
+extern void sort_double_inc_2(double *, int *, const int);
+extern void sort_double_dec_2(double *, int *,  const int);
+extern void sort_int_inc(int *, const int);
 
 /* util.c */
 extern int maxv(const int *, const int);
@@ -1021,12 +1157,14 @@ extern int closest_dir_dist(const int, const int, const int);
 /*************************************************************************/
 /*        EXTERNAL GLOBAL VARIABLE DEFINITIONS                           */
 /*************************************************************************/
-extern double dft_coefs[];
-extern LFSPARMS lfsparms;
-extern LFSPARMS lfsparms_V2;
-extern int nbr8_dx[];
-extern int nbr8_dy[];
-extern int chaincodes_nbr8[];
-extern FEATURE_PATTERN feature_patterns[];
+extern const double dft_coefs[];
+extern const int dft_qwaves_V2[];
+extern const LFSPARMS lfsparms;
+extern const LFSPARMS lfsparms_V2;
+extern const LFSPARMS lfsparms_preview;
+extern const int nbr8_dx[];
+extern const int nbr8_dy[];
+extern const int chaincodes_nbr8[];
+extern const FEATURE_PATTERN feature_patterns[];
 
 #endif
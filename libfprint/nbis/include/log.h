@@ -36,10 +36,9 @@ identified are necessarily the best available for the purpose.
 #define LOG_FILE     "log.txt"
 #endif
 
+#ifdef LOG_REPORT
 extern FILE *logfp;
-extern int avrdir;
-extern float dir_strength;
-extern int nvalid;
+#endif
 
 extern int open_logfile(void);
 extern int close_logfile(void);
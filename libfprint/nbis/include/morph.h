@@ -27,13 +27,24 @@ identified are necessarily the best available for the purpose.
 /* Modified 10/26/1999 by MDG to avoid indisciminate erosion of pixels */
 /* along the edge of the binary image.                                 */
 
+/* Byte images are processed a word at a time (SIMD within a register): */
+/* MORPH_LANES pixels are loaded into a 64-bit word with memcpy, so the  */
+/* routines need no alignment, intrinsics or particular byte order.      */
+#define MORPH_LANES      8
+#define MORPH_ONES       0x0101010101010101ULL
+#define MORPH_LOW7       0x7f7f7f7f7f7f7f7fULL
+
+/* Sets each byte of a word to 0xff if it is non-zero, else to 0x00.  */
+/* Adding 0x7f to the low 7 bits never carries into the next byte.    */
+#define MORPH_NZ(x) \
+   ((((((x) & MORPH_LOW7) + MORPH_LOW7) | (x)) >> 7 & MORPH_ONES) * 0xff)
+
+#define MORPH_LOAD(w, p)   memcpy(&(w), (p), MORPH_LANES)
+#define MORPH_STORE(p, w)  memcpy((p), &(w), MORPH_LANES)
+
 extern void erode_charimage_2(unsigned char *, unsigned char *,
                      const int, const int);
 extern void dilate_charimage_2(unsigned char *, unsigned char *,
                      const int, const int);
-extern char get_south8_2(char *, const int, const int, const int, const int);
-extern char get_north8_2(char *, const int, const int, const int);
-extern char get_east8_2(char *, const int, const int, const int);
-extern char get_west8_2(char *, const int, const int);
 
 #endif /* !__MORPH_H__ */
@@ -39,6 +39,9 @@ identified are necessarily the best available for the purpose.
                         binarize_V2()
 			binarize_image_V2()
                         dirbinarize()
+                        dirbin_center_row()
+                        dirbinarize_grid()
+                        binarize_rows()
 
 ***********************************************************************/
 
@@ -101,6 +104,140 @@ int binarize_V2(unsigned char **odata, int *ow, int *oh,
    return(0);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: dirbin_center_row - Returns the (0-oriented) index of the center row
+#cat:               of a rotated grid used for directional binarization.
+
+   Input:
+      grid_h      - height (in pixels) of the rotated grid
+   Return Code:
+      Center row of the grid
+**************************************************************************/
+LFS_KERNEL int dirbin_center_row(const int grid_h)
+{
+   double dcy;
+
+   /* Calculate center (0-oriented) row in grid. */
+   dcy = (grid_h-1)/(double)2.0;
+   /* Need to truncate precision so that answers are consistent */
+   /* on different computer architectures when rounding doubles. */
+   dcy = trunc_dbl_precision(dcy, TRUNC_SCALE);
+   return(sround(dcy));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: dirbinarize_grid - Kernel of dirbinarize().  The grid dimensions are
+#cat:               passed separately so that, when called with constants,
+#cat:               the compiler generates a fully unrolled version.
+
+   Input:
+      pptr        - pointer to current grayscale pixel
+      grid        - rotated grid offsets for the block's direction
+      grid_w      - width (in pixels) of the rotated grid
+      grid_h      - height (in pixels) of the rotated grid
+      cy          - center row of the grid
+   Return Code:
+      BLACK_PIXEL - pixel intensity for BLACK
+      WHITE_PIXEL - pixel intensity of WHITE
+**************************************************************************/
+LFS_KERNEL int dirbinarize_grid(const unsigned char *pptr, const int *grid,
+                const int grid_w, const int grid_h, const int cy)
+{
+   int gx, gy, gi;
+   int rsum, gsum, csum = 0;
+
+   /* Initialize grid's pixel offset index to zero. */
+   gi = 0;
+   /* Initialize grid's pixel accumulator to zero */
+   gsum = 0;
+
+   /* Foreach row in grid ... */
+   for(gy = 0; gy < grid_h; gy++){
+      /* Initialize row pixel sum to zero. */
+      rsum = 0;
+      /* Foreach column in grid ... */
+      for(gx = 0; gx < grid_w; gx++){
+         /* Accumulate next pixel along rotated row in grid. */
+         rsum += *(pptr+grid[gi]);
+         /* Bump grid's pixel offset index. */
+         gi++;
+      }
+      /* Accumulate row sum into grid pixel sum. */
+      gsum += rsum;
+      /* If current row is center row, then save row sum separately. */
+      if(gy == cy)
+         csum = rsum;
+   }
+
+   /* If the center row sum treated as an average is less than the */
+   /* total pixel sum in the rotated grid ...                      */
+   if((csum * grid_h) < gsum)
+      /* Set the binary pixel to BLACK. */
+      return(BLACK_PIXEL);
+   else
+      /* Otherwise set the binary pixel to WHITE. */
+      return(WHITE_PIXEL);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: binarize_rows - Pixel loop of binarize_image_V2(), specialized in the
+#cat:               same way as dirbinarize_grid().
+
+   Input:
+      spptr       - first pixel of the unpadded image within the padded image
+      pw          - padded width (in pixels) of input image
+      bw          - width (in pixels) of the binary image
+      bh          - height (in pixels) of the binary image
+      direction_map - map of image blocks containing directional ridge flow
+      mw          - the number of blocks horizontally in the Direction Map
+      blocksize   - dimension (in pixels) of each NMAP block
+      dirbingrids - set of rotated grid offsets used for directional
+                    binarization
+      grid_w, grid_h, cy - dimensions and center row of the rotated grids
+   Output:
+      bptr        - the binarized image
+**************************************************************************/
+LFS_KERNEL void binarize_rows(unsigned char *bptr, const unsigned char *spptr,
+                   const int pw, const int bw, const int bh,
+                   const int *direction_map, const int mw,
+                   const int blocksize, const ROTGRIDS *dirbingrids,
+                   const int grid_w, const int grid_h, const int cy)
+{
+   int ix, iy, bx, by, mapval;
+   const unsigned char *pptr;
+
+   for(iy = 0; iy < bh; iy++){
+      /* Set pixel pointer to start of next row in grid. */
+      pptr = spptr;
+      for(ix = 0; ix < bw; ix++){
+
+         /* Compute which block the current pixel is in. */
+         bx = (int)(ix/blocksize);
+         by = (int)(iy/blocksize);
+         /* Get corresponding value in Direction Map. */
+         mapval = *(direction_map + (by*mw) + bx);
+         /* If current block has has INVALID direction ... */
+         if(mapval == INVALID_DIR)
+            /* Set binary pixel to white (255). */
+            *bptr = WHITE_PIXEL;
+         /* Otherwise, if block has a valid direction ... */
+         else /*if(mapval >= 0)*/
+            /* Use directional binarization based on block's direction. */
+            *bptr = dirbinarize_grid(pptr, dirbingrids->grids[mapval],
+                                     grid_w, grid_h, cy);
+
+         /* Bump input and output pixel pointers. */
+         pptr++;
+         bptr++;
+      }
+      /* Bump pointer to the next row in padded input image. */
+      spptr += pw;
+   }
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: binarize_image_V2 - Takes a grayscale input image and its associated
@@ -131,9 +268,9 @@ int binarize_image_V2(unsigned char **odata, int *ow, int *oh,
                    const int *direction_map, const int mw, const int mh,
                    const int blocksize, const ROTGRIDS *dirbingrids)
 {
-   int ix, iy, bw, bh, bx, by, mapval;
-   unsigned char *bdata, *bptr;
-   unsigned char *pptr, *spptr;
+   int bw, bh;
+   unsigned char *bdata;
+   unsigned char *spptr;
 
    /* Compute dimensions of "unpadded" binary image results. */
    bw = pw - (dirbingrids->pad<<1);
@@ -145,34 +282,22 @@ int binarize_image_V2(unsigned char **odata, int *ow, int *oh,
       return(-600);
    }
 
-   bptr = bdata;
    spptr = pdata + (dirbingrids->pad * pw) + dirbingrids->pad;
-   for(iy = 0; iy < bh; iy++){
-      /* Set pixel pointer to start of next row in grid. */
-      pptr = spptr;
-      for(ix = 0; ix < bw; ix++){
 
-         /* Compute which block the current pixel is in. */
-         bx = (int)(ix/blocksize);
-         by = (int)(iy/blocksize);
-         /* Get corresponding value in Direction Map. */
-         mapval = *(direction_map + (by*mw) + bx);
-         /* If current block has has INVALID direction ... */
-         if(mapval == INVALID_DIR)
-            /* Set binary pixel to white (255). */
-            *bptr = WHITE_PIXEL;
-         /* Otherwise, if block has a valid direction ... */
-         else /*if(mapval >= 0)*/
-            /* Use directional binarization based on block's direction. */
-            *bptr = dirbinarize(pptr, mapval, dirbingrids);
-
-         /* Bump input and output pixel pointers. */
-         pptr++;
-         bptr++;
-      }
-      /* Bump pointer to the next row in padded input image. */
-      spptr += pw;
-   }
+   /* Use the version specialized for the default LFS parameters when */
+   /* the block size and grids match them.                            */
+   if((blocksize == MAP_BLOCKSIZE_V2) &&
+      (dirbingrids->grid_w == DIRBIN_GRID_W) &&
+      (dirbingrids->grid_h == DIRBIN_GRID_H))
+      binarize_rows(bdata, spptr, pw, bw, bh, direction_map, mw,
+                    MAP_BLOCKSIZE_V2, dirbingrids,
+                    DIRBIN_GRID_W, DIRBIN_GRID_H,
+                    dirbin_center_row(DIRBIN_GRID_H));
+   else
+      binarize_rows(bdata, spptr, pw, bw, bh, direction_map, mw,
+                    blocksize, dirbingrids,
+                    dirbingrids->grid_w, dirbingrids->grid_h,
+                    dirbin_center_row(dirbingrids->grid_h));
 
    *odata = bdata;
    *ow = bw;
@@ -201,49 +326,8 @@ int binarize_image_V2(unsigned char **odata, int *ow, int *oh,
 int dirbinarize(const unsigned char *pptr, const int idir,
                 const ROTGRIDS *dirbingrids)
 {
-   int gx, gy, gi, cy;
-   int rsum, gsum, csum = 0;
-   int *grid;
-   double dcy;
-
-   /* Assign nickname pointer. */
-   grid = dirbingrids->grids[idir];
-   /* Calculate center (0-oriented) row in grid. */
-   dcy = (dirbingrids->grid_h-1)/(double)2.0;
-   /* Need to truncate precision so that answers are consistent */
-   /* on different computer architectures when rounding doubles. */
-   dcy = trunc_dbl_precision(dcy, TRUNC_SCALE);
-   cy = sround(dcy);
-   /* Initialize grid's pixel offset index to zero. */
-   gi = 0;
-   /* Initialize grid's pixel accumulator to zero */
-   gsum = 0;
-
-   /* Foreach row in grid ... */
-   for(gy = 0; gy < dirbingrids->grid_h; gy++){
-      /* Initialize row pixel sum to zero. */
-      rsum = 0;
-      /* Foreach column in grid ... */
-      for(gx = 0; gx < dirbingrids->grid_w; gx++){
-         /* Accumulate next pixel along rotated row in grid. */
-         rsum += *(pptr+grid[gi]);
-         /* Bump grid's pixel offset index. */
-         gi++;
-      }
-      /* Accumulate row sum into grid pixel sum. */
-      gsum += rsum;
-      /* If current row is center row, then save row sum separately. */
-      if(gy == cy)
-         csum = rsum;
-   }
-
-   /* If the center row sum treated as an average is less than the */
-   /* total pixel sum in the rotated grid ...                      */
-   if((csum * dirbingrids->grid_h) < gsum)
-      /* Set the binary pixel to BLACK. */
-      return(BLACK_PIXEL);
-   else
-      /* Otherwise set the binary pixel to WHITE. */
-      return(WHITE_PIXEL);
+   return(dirbinarize_grid(pptr, dirbingrids->grids[idir],
+                           dirbingrids->grid_w, dirbingrids->grid_h,
+                           dirbin_center_row(dirbingrids->grid_h)));
 }
 
@@ -37,7 +37,11 @@ identified are necessarily the best available for the purpose.
 ***********************************************************************
                ROUTINES:
                         block_offsets()
-                        low_contrast_block()
+                        winhist_fill()
+                        winhist_slide()
+                        move_winhist()
+                        init_winhist()
+                        low_contrast_window()
                         find_valid_block()
                         set_margin_blocks()
 
@@ -182,90 +186,220 @@ int block_offsets(int **optr, int *ow, int *oh,
 }
 
 /*************************************************************************
-#cat: low_contrast_block - Takes the offset to an image block of specified
-#cat:             dimension, and analyzes the pixel intensities in the block
-#cat:             to determine if there is sufficient contrast for further
-#cat:             processing.
+**************************************************************************
+#cat: winhist_fill - Rebuilds a window histogram from the pixel intensities
+#cat:             of a square window of the image.  The window size is
+#cat:             passed separately so that, when called with a constant,
+#cat:             the compiler generates a fully unrolled version.
+
+   Input:
+      bins      - histogram to rebuild
+      sptr      - pointer to the origin of the window
+      pw        - width (in pixels) of the padded input image
+      size      - dimension (in pixels) of the window
+   Output:
+      bins      - histogram of the window
+**************************************************************************/
+LFS_KERNEL void winhist_fill(int *bins, const unsigned char *sptr,
+                       const int pw, const int size)
+{
+   int px, py;
+   const unsigned char *pptr;
+
+   memset(bins, 0, WINHIST_BINS * sizeof(int));
+   for(py = 0; py < size; py++){
+      pptr = sptr;
+      for(px = 0; px < size; px++){
+         bins[*pptr]++;
+         pptr++;
+      }
+      sptr += pw;
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: winhist_slide - Updates a window histogram for a window moved to the
+#cat:             right by fewer pixels than its size.  For each row, the
+#cat:             pixels that left the window are removed and those that
+#cat:             entered it are added, in a single pass.
 
    Input:
-      blkoffset - byte offset into the padded input image to the origin of
-                  the block to be analyzed
-      blocksize - dimension (in pixels) of the width and height of the block
-                  (passing separate blocksize from LFSPARMS on purpose)
-      pdata     - padded input image data (8 bits [0..256) grayscale)
+      bins      - histogram of the window at its old position
+      optr      - pointer to the first column that left the window
+      nptr      - pointer to the first column that entered the window
+      pw        - width (in pixels) of the padded input image
+      dx        - number of columns the window moved
+      size      - dimension (in pixels) of the window
+   Output:
+      bins      - histogram of the window at its new position
+**************************************************************************/
+LFS_KERNEL void winhist_slide(int *bins, const unsigned char *optr,
+                       const unsigned char *nptr, const int pw,
+                       const int dx, const int size)
+{
+   int px, py;
+
+   for(py = 0; py < size; py++){
+      for(px = 0; px < dx; px++){
+         bins[optr[px]]--;
+         bins[nptr[px]]++;
+      }
+      optr += pw;
+      nptr += pw;
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: move_winhist - Brings a window histogram up to date for a new window
+#cat:             origin.  If the new window overlaps the current one on the
+#cat:             same rows and to the right, only the columns that left
+#cat:             and entered the window are updated; otherwise the
+#cat:             histogram is rebuilt.
+
+   Input:
+      hist      - window histogram
+      win_x     - X-pixel coord of the new window origin
+      win_y     - Y-pixel coord of the new window origin
+      pdata     - padded input image data (6 bits [0..64) grayscale)
+      pw        - width (in pixels) of the padded input image
+      size      - dimension (in pixels) of the window, equal to hist->size
+   Output:
+      hist      - histogram of the new window
+**************************************************************************/
+LFS_KERNEL void move_winhist(WINHIST *hist, const int win_x, const int win_y,
+                       const unsigned char *pdata, const int pw,
+                       const int size)
+{
+   int dx;
+   const unsigned char *sptr;
+
+   dx = win_x - hist->win_x;
+   sptr = pdata + (win_y * pw) + win_x;
+
+   if((hist->win_x >= 0) && (win_y == hist->win_y) &&
+      (dx >= 0) && (dx < size)){
+      if(dx > 0)
+         winhist_slide(hist->bins, sptr - dx, sptr + size - dx, pw, dx, size);
+   }
+   else
+      winhist_fill(hist->bins, sptr, pw, size);
+
+   hist->win_x = win_x;
+   hist->win_y = win_y;
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: init_winhist - Initializes an empty window histogram for use with
+#cat:             low_contrast_window().
+
+   Input:
+      size      - dimension (in pixels) of the width and height of the
+                  window
+      lfsparms  - parameters and thresholds for controlling LFS
+   Output:
+      hist      - initialized histogram
+**************************************************************************/
+void init_winhist(WINHIST *hist, const int size, const LFSPARMS *lfsparms)
+{
+   int numpix;
+   double tdbl;
+
+   numpix = size*size;
+   tdbl = (lfsparms->percentile_min_max/100.0) * (double)(numpix-1);
+   tdbl = trunc_dbl_precision(tdbl, TRUNC_SCALE);
+
+   hist->size = size;
+   hist->prctthresh = sround(tdbl);
+   hist->win_x = -1;
+   hist->win_y = -1;
+}
+
+/*************************************************************************
+#cat: low_contrast_window - Analyzes the pixel intensities in a window of
+#cat:             the image to determine if there is sufficient contrast
+#cat:             for further processing.  The window histogram is carried
+#cat:             over between calls, so successive windows along a row
+#cat:             should be analyzed from left to right with the same
+#cat:             histogram.
+
+   Input:
+      hist      - window histogram from init_winhist() or a previous call
+      win_x     - X-pixel coord of the window origin
+      win_y     - Y-pixel coord of the window origin
+      pdata     - padded input image data (6 bits [0..64) grayscale)
       pw        - width (in pixels) of the padded input image
-      ph        - height (in pixels) of the padded input image
       lfsparms  - parameters and thresholds for controlling LFS
+   Output:
+      hist      - histogram of the analyzed window
    Return Code:
       TRUE     - block has sufficiently low contrast
       FALSE    - block has sufficiently hight contrast
       Negative - system error
-**************************************************************************
 **************************************************************************/
-int low_contrast_block(const int blkoffset, const int blocksize,
-                       unsigned char *pdata, const int pw, const int ph,
-                       const LFSPARMS *lfsparms)
+int low_contrast_window(WINHIST *hist, const int win_x, const int win_y,
+                        const unsigned char *pdata, const int pw,
+                        const LFSPARMS *lfsparms)
 {
-   int pixtable[IMG_6BIT_PIX_LIMIT], numpix;
-   int px, py, pi;
-   unsigned char *sptr, *pptr;
+   const int ngroups = WINHIST_BINS >> WINHIST_GROUP_BITS;
+   const int prctthresh = hist->prctthresh;
+   int gi, pi;
    int delta;
-   double tdbl;
-   int prctmin = 0, prctmax = 0, prctthresh;
-   int pixsum, found;
-
-   numpix = blocksize*blocksize;
-   memset(pixtable, 0, IMG_6BIT_PIX_LIMIT*sizeof(int));
+   int prctmin, prctmax;
+   int pixsum;
 
-   tdbl = (lfsparms->percentile_min_max/100.0) * (double)(numpix-1);
-   tdbl = trunc_dbl_precision(tdbl, TRUNC_SCALE);
-   prctthresh = sround(tdbl);
-
-   sptr = pdata+blkoffset;
-   for(py = 0; py < blocksize; py++){
-      pptr = sptr;
-      for(px = 0; px < blocksize; px++){
-         pixtable[*pptr]++;
-         pptr++;
-      }
-      sptr += pw;
+   /* Use the version specialized for the default window size. */
+   if(hist->size == MAP_WINDOWSIZE_V2)
+      move_winhist(hist, win_x, win_y, pdata, pw, MAP_WINDOWSIZE_V2);
+   else
+      move_winhist(hist, win_x, win_y, pdata, pw, hist->size);
+
+   /* Sum the bins of each group, so that the percentile walks below */
+   /* step over whole groups before descending into a single one.    */
+   for(gi = 0; gi < ngroups; gi++){
+      pixsum = 0;
+      for(pi = gi << WINHIST_GROUP_BITS;
+          pi < (gi+1) << WINHIST_GROUP_BITS; pi++)
+         pixsum += hist->bins[pi];
+      hist->groups[gi] = pixsum;
    }
 
-   pi = 0;
+   /* Find the lowest intensity at which the cumulative count reaches */
+   /* the percentile threshold: first the group, then the bin.        */
    pixsum = 0;
-   found = FALSE;
-   while(pi < IMG_6BIT_PIX_LIMIT){
-      pixsum += pixtable[pi];
-      if(pixsum >= prctthresh){
-         prctmin = pi;
-         found = TRUE;
+   for(gi = 0; gi < ngroups; gi++){
+      if(pixsum + hist->groups[gi] >= prctthresh)
          break;
-      }
-      pi++;
+      pixsum += hist->groups[gi];
    }
-   if(!found){
+   if(gi == ngroups){
       fprintf(stderr,
-              "ERROR : low_contrast_block : min percentile pixel not found\n");
+              "ERROR : low_contrast_window : min percentile pixel not found\n");
       return(-510);
    }
+   pi = gi << WINHIST_GROUP_BITS;
+   while((pixsum += hist->bins[pi]) < prctthresh)
+      pi++;
+   prctmin = pi;
 
-   pi = IMG_6BIT_PIX_LIMIT-1;
+   /* Likewise for the highest intensity, counting down from the top. */
    pixsum = 0;
-   found = FALSE;
-   while(pi >= 0){
-      pixsum += pixtable[pi];
-      if(pixsum >= prctthresh){
-         prctmax = pi;
-         found = TRUE;
+   for(gi = ngroups-1; gi >= 0; gi--){
+      if(pixsum + hist->groups[gi] >= prctthresh)
          break;
-      }
-      pi--;
+      pixsum += hist->groups[gi];
    }
-   if(!found){
+   if(gi < 0){
       fprintf(stderr,
-              "ERROR : low_contrast_block : max percentile pixel not found\n");
+              "ERROR : low_contrast_window : max percentile pixel not found\n");
       return(-511);
    }
+   pi = ((gi+1) << WINHIST_GROUP_BITS) - 1;
+   while((pixsum += hist->bins[pi]) < prctthresh)
+      pi--;
+   prctmax = pi;
 
    delta = prctmax - prctmin;
 
@@ -37,6 +37,11 @@ identified are necessarily the best available for the purpose.
                ROUTINES:
                         lfs_detect_minutiae_V2()
                         get_minutiae()
+                        get_maps()
+                        get_minutiae_from_maps()
+                        add_lfsstream_row()
+                        get_minutiae_stream()
+                        get_preview_maps()
 
 ***********************************************************************/
 
@@ -45,6 +50,139 @@ identified are necessarily the best available for the purpose.
 #include <lfs.h>
 #include <log.h>
 
+/*************************************************************************
+#cat: detect_from_maps - Second half of the LFS Version 2 pipeline.  Takes
+#cat:          a padded 6-bit image along with its finished block maps,
+#cat:          binarizes the image, and then detects minutiae and counts
+#cat:          the ridges between them.  The maps are left to the caller.
+
+   Input:
+      pdata     - padded input image data (6 bits [0..64) grayscale)
+      pw        - padded width (in pixels) of the input image
+      ph        - padded height (in pixels) of the input image
+      direction_map    - Direction Map
+      low_contrast_map - Low Contrast Map
+      low_flow_map     - Low Ridge Flow Map
+      high_curve_map   - High Curvature Map
+      mw        - width (in blocks) of image maps
+      mh        - height (in blocks) of image maps
+      iw        - width (in pixels) of the image
+      ih        - height (in pixels) of the image
+      lfsctx    - extraction context holding the LFS parameters and
+                  lookup tables
+   Output:
+      ominutiae - resulting list of minutiae
+      obdata    - resulting binarized image
+                  {0 = black pixel (ridge) and 255 = white pixel (valley)}
+      obw       - width (in pixels) of the binary image
+      obh       - height (in pixels) of the binary image
+   Return Code:
+      Zero      - successful completion
+      Negative  - system error
+**************************************************************************/
+static int detect_from_maps(MINUTIAE **ominutiae,
+                        unsigned char **obdata, int *obw, int *obh,
+                        unsigned char *pdata, const int pw, const int ph,
+                        int *direction_map, int *low_contrast_map,
+                        int *low_flow_map, int *high_curve_map,
+                        const int mw, const int mh,
+                        const int iw, const int ih, LFSCTX *lfsctx)
+{
+   const LFSPARMS *lfsparms = lfsctx->lfsparms;
+   unsigned char *bdata;
+   int bw, bh;
+   int ret;
+   MINUTIAE *minutiae;
+
+   /******************/
+   /* BINARIZARION   */
+   /******************/
+
+   /* Binarize input image based on NMAP information. */
+   if((ret = binarize_V2(&bdata, &bw, &bh,
+                      pdata, pw, ph, direction_map, mw, mh,
+                      lfsctx->dirbingrids, lfsparms))){
+      return(ret);
+   }
+
+   /* Check dimension of binary image.  If they are different from */
+   /* the input image, then ERROR.                                 */
+   if((iw != bw) || (ih != bh)){
+      /* Free memory allocated to this point. */
+      free(bdata);
+      fprintf(stderr, "ERROR : detect_from_maps :");
+      fprintf(stderr,"binary image has bad dimensions : %d, %d\n",
+              bw, bh);
+      return(-581);
+   }
+
+   print2log("\nBINARIZATION DONE\n");
+
+   /******************/
+   /*   DETECTION    */
+   /******************/
+
+   /* Convert 8-bit grayscale binary image [0,255] to */
+   /* 8-bit binary image [0,1].                       */
+   gray2bin(1, 1, 0, bdata, iw, ih);
+
+   /* Allocate initial list of minutia pointers. */
+   if((ret = alloc_minutiae(&minutiae, MAX_MINUTIAE))){
+      free(bdata);
+      return(ret);
+   }
+
+   /* Detect the minutiae in the binarized image. */
+   if((ret = detect_minutiae_V2(minutiae, bdata, iw, ih,
+                             direction_map, low_flow_map, high_curve_map,
+                             mw, mh, lfsparms))){
+      /* Free memory allocated to this point. */
+      free(bdata);
+      free_minutiae(minutiae);
+      return(ret);
+   }
+
+   if((ret = remove_false_minutia_V2(minutiae, bdata, iw, ih,
+                       direction_map, low_flow_map, high_curve_map, mw, mh,
+                       lfsparms))){
+      /* Free memory allocated to this point. */
+      free(bdata);
+      free_minutiae(minutiae);
+      return(ret);
+   }
+
+   print2log("\nMINUTIA DETECTION DONE\n");
+
+   /******************/
+   /*  RIDGE COUNTS  */
+   /******************/
+   if((ret = count_minutiae_ridges(minutiae, bdata, iw, ih, lfsparms))){
+      /* Free memory allocated to this point. */
+      free(bdata);
+      free_minutiae(minutiae);
+      return(ret);
+   }
+
+
+   print2log("\nNEIGHBOR RIDGE COUNT DONE\n");
+
+   /******************/
+   /*    WRAP-UP     */
+   /******************/
+
+   /* Convert 8-bit binary image [0,1] to 8-bit */
+   /* grayscale binary image [0,255].           */
+   gray2bin(1, 255, 0, bdata, iw, ih);
+
+   /* Assign results to output pointers. */
+   *obdata = bdata;
+   *obw = bw;
+   *obh = bh;
+   *ominutiae = minutiae;
+
+   return(0);
+}
+
 /*************************************************************************
 #cat: lfs_detect_minutiae_V2 - Takes a grayscale fingerprint image (of
 #cat:          arbitrary size), and returns a set of image block maps,
@@ -59,7 +197,8 @@ identified are necessarily the best available for the purpose.
       idata     - input 8-bit grayscale fingerprint image data
       iw        - width (in pixels) of the image
       ih        - height (in pixels) of the image
-      lfsparms  - parameters and thresholds for controlling LFS
+      lfsctx    - extraction context holding the LFS parameters and
+                  lookup tables
 
    Output:
       ominutiae - resulting list of minutiae
@@ -86,17 +225,14 @@ static int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
                         int *omw, int *omh,
                         unsigned char **obdata, int *obw, int *obh,
                         unsigned char *idata, const int iw, const int ih,
-                        const LFSPARMS *lfsparms)
+                        LFSCTX *lfsctx)
 {
+   const LFSPARMS *lfsparms = lfsctx->lfsparms;
    unsigned char *pdata, *bdata;
    int pw, ph, bw, bh;
-   DIR2RAD *dir2rad;
-   DFTWAVES *dftwaves;
-   ROTGRIDS *dftgrids;
-   ROTGRIDS *dirbingrids;
    int *direction_map, *low_contrast_map, *low_flow_map, *high_curve_map;
    int mw, mh;
-   int ret, maxpad;
+   int ret;
    MINUTIAE *minutiae;
 
    /******************/
@@ -108,73 +244,19 @@ static int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
       /* If system error, exit with error code. */
       return(ret);
 
-   /* Determine the maximum amount of image padding required to support */
-   /* LFS processes.                                                    */
-   maxpad = get_max_padding_V2(lfsparms->windowsize, lfsparms->windowoffset,
-                          lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h);
-
-   /* Initialize lookup table for converting integer directions */
-   /* to angles in radians.                                     */
-   if((ret = init_dir2rad(&dir2rad, lfsparms->num_directions))){
-      /* Free memory allocated to this point. */
-      return(ret);
-   }
-
-   /* Initialize wave form lookup tables for DFT analyses. */
-   /* used for direction binarization.                             */
-   if((ret = init_dftwaves(&dftwaves, dft_coefs, lfsparms->num_dft_waves,
-                        lfsparms->windowsize))){
-      /* Free memory allocated to this point. */
-      free_dir2rad(dir2rad);
+   /* Make sure the context's rotated grids fit this image. */
+   if((ret = prepare_lfsctx(lfsctx, iw, ih)))
       return(ret);
-   }
 
-   /* Initialize lookup table for pixel offsets to rotated grids */
-   /* used for DFT analyses.                                     */
-   if((ret = init_rotgrids(&dftgrids, iw, ih, maxpad,
-                        lfsparms->start_dir_angle, lfsparms->num_directions,
-                        lfsparms->windowsize, lfsparms->windowsize,
-                        RELATIVE2ORIGIN))){
-      /* Free memory allocated to this point. */
-      free_dir2rad(dir2rad);
-      free_dftwaves(dftwaves);
-      return(ret);
-   }
-
-   /* Pad input image based on max padding. */
-   if(maxpad > 0){   /* May not need to pad at all */
-      if((ret = pad_uchar_image(&pdata, &pw, &ph, idata, iw, ih,
-                             maxpad, lfsparms->pad_value))){
-         /* Free memory allocated to this point. */
-         free_dir2rad(dir2rad);
-         free_dftwaves(dftwaves);
-         free_rotgrids(dftgrids);
-         return(ret);
-      }
-   }
-   else{
-      /* If padding is unnecessary, then copy the input image. */
-      pdata = (unsigned char *)malloc(iw*ih);
-      if(pdata == (unsigned char *)NULL){
-         /* Free memory allocated to this point. */
-         free_dir2rad(dir2rad);
-         free_dftwaves(dftwaves);
-         free_rotgrids(dftgrids);
-         fprintf(stderr, "ERROR : lfs_detect_minutiae_V2 : malloc : pdata\n");
-         return(-580);
-      }
-      memcpy(pdata, idata, iw*ih);
-      pw = iw;
-      ph = ih;
-   }
-
-   /* Scale input image to 6 bits [0..63] */
+   /* Pad input image based on max padding, and scale it to 6 bits */
+   /* [0..63].  The padded image is held by the context.           */
    /* !!! Would like to remove this dependency eventualy !!!     */
    /* But, the DFT computations will need to be changed, and     */
    /* could not get this work upon first attempt. Also, if not   */
    /* careful, I think accumulated power magnitudes may overflow */
    /* doubles.                                                   */
-   bits_8to6(pdata, pw, ph);
+   if((ret = pad_lfsctx_image(&pdata, &pw, &ph, lfsctx, idata, iw, ih)))
+      return(ret);
 
    print2log("\nINITIALIZATION AND PADDING DONE\n");
 
@@ -185,33 +267,19 @@ static int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    /* Generate block maps from the input image. */
    if((ret = gen_image_maps(&direction_map, &low_contrast_map,
                     &low_flow_map, &high_curve_map, &mw, &mh,
-                    pdata, pw, ph, dir2rad, dftwaves, dftgrids, lfsparms))){
-      /* Free memory allocated to this point. */
-      free_dir2rad(dir2rad);
-      free_dftwaves(dftwaves);
-      free_rotgrids(dftgrids);
-      free(pdata);
+                    pdata, pw, ph, lfsctx->dir2rad, lfsctx->dftwaves,
+                    lfsctx->dftgrids, lfsparms))){
       return(ret);
    }
-   /* Deallocate working memories. */
-   free_dir2rad(dir2rad);
-   free_dftwaves(dftwaves);
-   free_rotgrids(dftgrids);
 
    print2log("\nMAPS DONE\n");
 
-   /******************/
-   /* BINARIZARION   */
-   /******************/
-
-   /* Initialize lookup table for pixel offsets to rotated grids */
-   /* used for directional binarization.                         */
-   if((ret = init_rotgrids(&dirbingrids, iw, ih, maxpad,
-                        lfsparms->start_dir_angle, lfsparms->num_directions,
-                        lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h,
-                        RELATIVE2CENTER))){
-      /* Free memory allocated to this point. */
-      free(pdata);
+   /* Binarize and detect minutiae based on the maps. */
+   ret = detect_from_maps(&minutiae, &bdata, &bw, &bh,
+                          pdata, pw, ph, direction_map, low_contrast_map,
+                          low_flow_map, high_curve_map, mw, mh,
+                          iw, ih, lfsctx);
+   if(ret){
       free(direction_map);
       free(low_contrast_map);
       free(low_flow_map);
@@ -219,112 +287,144 @@ static int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
       return(ret);
    }
 
-   /* Binarize input image based on NMAP information. */
-   if((ret = binarize_V2(&bdata, &bw, &bh,
-                      pdata, pw, ph, direction_map, mw, mh,
-                      dirbingrids, lfsparms))){
-      /* Free memory allocated to this point. */
-      free(pdata);
-      free(direction_map);
-      free(low_contrast_map);
-      free(low_flow_map);
-      free(high_curve_map);
-      free_rotgrids(dirbingrids);
-      return(ret);
-   }
+   /* Assign results to output pointers. */
+   *odmap = direction_map;
+   *olcmap = low_contrast_map;
+   *olfmap = low_flow_map;
+   *ohcmap = high_curve_map;
+   *omw = mw;
+   *omh = mh;
+   *obdata = bdata;
+   *obw = bw;
+   *obh = bh;
+   *ominutiae = minutiae;
 
-   /* Deallocate working memory. */
-   free_rotgrids(dirbingrids);
+   /* If LOG_REPORT defined, close log report file. */
+   if((ret = close_logfile()))
+      return(ret);
 
-   /* Check dimension of binary image.  If they are different from */
-   /* the input image, then ERROR.                                 */
-   if((iw != bw) || (ih != bh)){
-      /* Free memory allocated to this point. */
-      free(pdata);
-      free(direction_map);
-      free(low_contrast_map);
-      free(low_flow_map);
-      free(high_curve_map);
-      free(bdata);
-      fprintf(stderr, "ERROR : lfs_detect_minutiae_V2 :");
-      fprintf(stderr,"binary image has bad dimensions : %d, %d\n",
-              bw, bh);
-      return(-581);
-   }
+   return(0);
+}
 
-   print2log("\nBINARIZATION DONE\n");
+/*************************************************************************
+#cat: lfs_detect_stream_V2 - Streaming counterpart of lfs_detect_minutiae_V2.
+#cat:          The rows of the image have already been padded, scaled to
+#cat:          6 bits, and partially analyzed by add_lfsstream_row(), so
+#cat:          only the initial analysis of the top rows of blocks remains
+#cat:          before the maps are cleaned up and minutiae detected.
 
-   /******************/
-   /*   DETECTION    */
-   /******************/
+   Input:
+      iw        - width (in pixels) of the image
+      ih        - height (in pixels) of the image, the number of rows
+                  streamed rounded down to a multiple of the block size
+      stream    - stream holding the image rows
+   Output:
+      (as for lfs_detect_minutiae_V2)
+   Return Code:
+      Zero      - successful completion
+      Negative  - system error
+**************************************************************************/
+static int lfs_detect_stream_V2(MINUTIAE **ominutiae,
+                        int **odmap, int **olcmap, int **olfmap, int **ohcmap,
+                        int *omw, int *omh,
+                        unsigned char **obdata, int *obw, int *obh,
+                        const int iw, const int ih, LFSSTREAM *stream)
+{
+   LFSCTX *lfsctx = stream->lfsctx;
+   const LFSPARMS *lfsparms = lfsctx->lfsparms;
+   unsigned char *pdata, *bdata;
+   int pw, ph, bw, bh;
+   int *direction_map, *low_contrast_map, *low_flow_map, *high_curve_map;
+   int *blkoffs;
+   int mw, mh, bsize, nleft, done;
+   int ret, maxpad;
+   MINUTIAE *minutiae;
 
-   /* Convert 8-bit grayscale binary image [0,255] to */
-   /* 8-bit binary image [0,1].                       */
-   gray2bin(1, 1, 0, bdata, iw, ih);
+   /* If LOG_REPORT defined, open log report file. */
+   if((ret = open_logfile()))
+      /* If system error, exit with error code. */
+      return(ret);
 
-   /* Allocate initial list of minutia pointers. */
-   if((ret = alloc_minutiae(&minutiae, MAX_MINUTIAE))){
+   /* The padded image is the bottom "ih" rows of the stream buffer. */
+   /* Rows above it may hold the few rows that were dropped to align */
+   /* the image to the block size, so reset them to padding.         */
+   maxpad = lfsctx->maxpad;
+   pw = stream->pw;
+   ph = ih + (maxpad<<1);
+   pdata = stream->pdata + ((stream->max_ih - ih) * pw);
+   memset(pdata, lfsparms->pad_value>>2, maxpad * pw);
+
+   if((ret = block_offsets(&blkoffs, &mw, &mh, iw, ih,
+                           maxpad, lfsparms->blocksize))){
       return(ret);
    }
-
-   /* Detect the minutiae in the binarized image. */
-   if((ret = detect_minutiae_V2(minutiae, bdata, iw, ih,
-                             direction_map, low_flow_map, high_curve_map,
-                             mw, mh, lfsparms))){
-      /* Free memory allocated to this point. */
-      free(pdata);
+   bsize = mw * mh;
+
+   direction_map = (int *)malloc(bsize * sizeof(int));
+   low_contrast_map = (int *)malloc(bsize * sizeof(int));
+   low_flow_map = (int *)malloc(bsize * sizeof(int));
+   if((direction_map == (int *)NULL) || (low_contrast_map == (int *)NULL) ||
+      (low_flow_map == (int *)NULL)){
+      free(blkoffs);
       free(direction_map);
       free(low_contrast_map);
       free(low_flow_map);
-      free(high_curve_map);
-      free(bdata);
-      return(ret);
+      fprintf(stderr, "ERROR : lfs_detect_stream_V2 : malloc : maps\n");
+      return(-63);
    }
 
-   if((ret = remove_false_minutia_V2(minutiae, bdata, iw, ih,
-                       direction_map, low_flow_map, high_curve_map, mw, mh,
-                       lfsparms))){
-      /* Free memory allocated to this point. */
-      free(pdata);
+   /* Rows of blocks already analyzed were stored bottom row first, */
+   /* while the maps are ordered top row first.                     */
+   done = stream->nblkrows;
+   nleft = (mh - done) * mw;
+   memset(direction_map, INVALID_DIR, nleft * sizeof(int));
+   memset(low_contrast_map, 0, nleft * sizeof(int));
+   memset(low_flow_map, 0, nleft * sizeof(int));
+   for(; done > 0; done--){
+      memcpy(direction_map + nleft, stream->direction_map + ((done-1) * mw),
+             mw * sizeof(int));
+      memcpy(low_contrast_map + nleft,
+             stream->low_contrast_map + ((done-1) * mw), mw * sizeof(int));
+      memcpy(low_flow_map + nleft, stream->low_flow_map + ((done-1) * mw),
+             mw * sizeof(int));
+      nleft += mw;
+   }
+
+   print2log("INITIAL MAP\n");
+
+   /* Analyze the remaining rows of blocks at the top of the image. */
+   nleft = (mh - stream->nblkrows) * mw;
+   ret = gen_initial_map_blocks(direction_map, low_contrast_map, low_flow_map,
+                                blkoffs, nleft, mw, pdata, pw, ph,
+                                lfsctx->dftwaves, lfsctx->dftgrids, lfsparms);
+   free(blkoffs);
+   if(ret){
       free(direction_map);
       free(low_contrast_map);
       free(low_flow_map);
-      free(high_curve_map);
-      free(bdata);
-      free_minutiae(minutiae);
       return(ret);
    }
 
-   print2log("\nMINUTIA DETECTION DONE\n");
+   if((ret = refine_image_maps(&high_curve_map, direction_map,
+                               low_contrast_map, low_flow_map, mw, mh,
+                               lfsctx->dir2rad, lfsparms))){
+      return(ret);
+   }
 
-   /******************/
-   /*  RIDGE COUNTS  */
-   /******************/
-   if((ret = count_minutiae_ridges(minutiae, bdata, iw, ih, lfsparms))){
-      /* Free memory allocated to this point. */
-      free(pdata);
+   print2log("\nMAPS DONE\n");
+
+   /* Binarize and detect minutiae based on the maps. */
+   if((ret = detect_from_maps(&minutiae, &bdata, &bw, &bh,
+                          pdata, pw, ph, direction_map, low_contrast_map,
+                          low_flow_map, high_curve_map, mw, mh,
+                          iw, ih, lfsctx))){
       free(direction_map);
       free(low_contrast_map);
       free(low_flow_map);
       free(high_curve_map);
-      free_minutiae(minutiae);
       return(ret);
    }
 
-
-   print2log("\nNEIGHBOR RIDGE COUNT DONE\n");
-
-   /******************/
-   /*    WRAP-UP     */
-   /******************/
-
-   /* Convert 8-bit binary image [0,1] to 8-bit */
-   /* grayscale binary image [0,255].           */
-   gray2bin(1, 255, 0, bdata, iw, ih);
-
-   /* Deallocate working memory. */
-   free(pdata);
-
    /* Assign results to output pointers. */
    *odmap = direction_map;
    *olcmap = low_contrast_map;
@@ -344,6 +444,89 @@ static int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
    return(0);
 }
 
+/*************************************************************************
+#cat: assign_minutiae_quality - Final step shared by get_minutiae() and
+#cat:          get_minutiae_stream().  Builds the integrated quality map,
+#cat:          assigns each minutia its reliability, and passes the
+#cat:          results back to the caller.  On error everything passed in
+#cat:          is freed.
+
+   Input:
+      minutiae, direction_map, low_contrast_map, low_flow_map,
+      high_curve_map, map_w, map_h, bdata, bw, bh
+                - results of minutiae detection
+      idata     - grayscale fingerprint image data
+      iw        - width (in pixels) of the grayscale image
+      ih        - height (in pixels) of the grayscale image
+      id        - pixel depth (in bits) of the grayscale image
+      ppmm      - the scan resolution (in pixels/mm) of the grayscale image
+      lfsparms  - parameters and thresholds for controlling LFS
+   Output:
+      (as for get_minutiae)
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+static int assign_minutiae_quality(MINUTIAE **ominutiae, int **oquality_map,
+                 int **odirection_map, int **olow_contrast_map,
+                 int **olow_flow_map, int **ohigh_curve_map,
+                 int *omap_w, int *omap_h,
+                 unsigned char **obdata, int *obw, int *obh, int *obd,
+                 MINUTIAE *minutiae, int *direction_map,
+                 int *low_contrast_map, int *low_flow_map,
+                 int *high_curve_map, const int map_w, const int map_h,
+                 unsigned char *bdata, const int bw, const int bh,
+                 unsigned char *idata, const int iw, const int ih,
+                 const int id, const double ppmm, const LFSPARMS *lfsparms)
+{
+   int ret;
+   int *quality_map;
+
+   /* Build integrated quality map. */
+   if((ret = gen_quality_map(&quality_map,
+                            direction_map, low_contrast_map,
+                            low_flow_map, high_curve_map, map_w, map_h))){
+      free_minutiae(minutiae);
+      free(direction_map);
+      free(low_contrast_map);
+      free(low_flow_map);
+      free(high_curve_map);
+      free(bdata);
+      return(ret);
+   }
+
+   /* Assign reliability from quality map. */
+   if((ret = combined_minutia_quality(minutiae, quality_map, map_w, map_h,
+                                     lfsparms->blocksize,
+                                     idata, iw, ih, id, ppmm))){
+      free_minutiae(minutiae);
+      free(direction_map);
+      free(low_contrast_map);
+      free(low_flow_map);
+      free(high_curve_map);
+      free(quality_map);
+      free(bdata);
+      return(ret);
+   }
+
+   /* Set output pointers. */
+   *ominutiae = minutiae;
+   *oquality_map = quality_map;
+   *odirection_map = direction_map;
+   *olow_contrast_map = low_contrast_map;
+   *olow_flow_map = low_flow_map;
+   *ohigh_curve_map = high_curve_map;
+   *omap_w = map_w;
+   *omap_h = map_h;
+   *obdata = bdata;
+   *obw = bw;
+   *obh = bh;
+   *obd = id;
+
+   /* Return normally. */
+   return(0);
+}
+
 /*************************************************************************
 **************************************************************************
 #cat:   get_minutiae - Takes a grayscale fingerprint image, binarizes the input
@@ -357,7 +540,9 @@ static int lfs_detect_minutiae_V2(MINUTIAE **ominutiae,
       ih       - height (in pixels) of the grayscale image
       id       - pixel depth (in bits) of the grayscale image
       ppmm     - the scan resolution (in pixels/mm) of the grayscale image
-      lfsparms - parameters and thresholds for controlling LFS
+      lfsctx   - caller-owned extraction context (see alloc_lfsctx()).
+                 All working state lives here, so concurrent calls are
+                 safe as long as each thread uses its own context.
    Output:
       ominutiae         - points to a structure containing the
                           detected minutiae
@@ -382,12 +567,12 @@ int get_minutiae(MINUTIAE **ominutiae, int **oquality_map,
                  int *omap_w, int *omap_h,
                  unsigned char **obdata, int *obw, int *obh, int *obd,
                  unsigned char *idata, const int iw, const int ih,
-                 const int id, const double ppmm, const LFSPARMS *lfsparms)
+                 const int id, const double ppmm, LFSCTX *lfsctx)
 {
    int ret;
    MINUTIAE *minutiae;
    int *direction_map, *low_contrast_map, *low_flow_map;
-   int *high_curve_map, *quality_map;
+   int *high_curve_map;
    int map_w, map_h;
    unsigned char *bdata;
    int bw, bh;
@@ -405,51 +590,386 @@ int get_minutiae(MINUTIAE **ominutiae, int **oquality_map,
                                    &low_flow_map, &high_curve_map,
                                    &map_w, &map_h,
                                    &bdata, &bw, &bh,
-                                   idata, iw, ih, lfsparms))){
+                                   idata, iw, ih, lfsctx))){
       return(ret);
    }
 
-   /* Build integrated quality map. */
+   return(assign_minutiae_quality(ominutiae, oquality_map, odirection_map,
+                 olow_contrast_map, olow_flow_map, ohigh_curve_map,
+                 omap_w, omap_h, obdata, obw, obh, obd,
+                 minutiae, direction_map, low_contrast_map, low_flow_map,
+                 high_curve_map, map_w, map_h, bdata, bw, bh,
+                 idata, iw, ih, id, ppmm, lfsctx->lfsparms));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat:   get_maps - First stage of get_minutiae() on its own.  Takes a
+#cat:                grayscale fingerprint image and computes the image
+#cat:                quality maps, without binarizing the image or detecting
+#cat:                minutiae.  The maps can later be handed to
+#cat:                get_minutiae_from_maps() to finish the extraction.
+
+   Input:
+      idata    - grayscale fingerprint image data
+      iw       - width (in pixels) of the grayscale image
+      ih       - height (in pixels) of the grayscale image
+      id       - pixel depth (in bits) of the grayscale image
+      lfsctx   - caller-owned extraction context (see alloc_lfsctx())
+   Output:
+      oquality_map      - resulting integrated image quality map
+      odirection_map    - resulting direction map
+      olow_contrast_map - resulting low contrast map
+      olow_flow_map     - resulting low ridge flow map
+      ohigh_curve_map   - resulting high curvature map
+      omap_w   - width (in blocks) of image maps
+      omap_h   - height (in blocks) of image maps
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int get_maps(int **oquality_map, int **odirection_map,
+             int **olow_contrast_map, int **olow_flow_map,
+             int **ohigh_curve_map, int *omap_w, int *omap_h,
+             unsigned char *idata, const int iw, const int ih,
+             const int id, LFSCTX *lfsctx)
+{
+   unsigned char *pdata;
+   int pw, ph;
+   int *quality_map, *direction_map, *low_contrast_map, *low_flow_map;
+   int *high_curve_map;
+   int map_w, map_h;
+   int ret;
+
+   /* If input image is not 8-bit grayscale ... */
+   if(id != 8){
+      fprintf(stderr, "ERROR : get_maps : input image pixel ");
+      fprintf(stderr, "depth = %d != 8.\n", id);
+      return(-2);
+   }
+
+   if((ret = prepare_lfsctx(lfsctx, iw, ih)))
+      return(ret);
+   if((ret = pad_lfsctx_image(&pdata, &pw, &ph, lfsctx, idata, iw, ih)))
+      return(ret);
+
+   if((ret = gen_image_maps(&direction_map, &low_contrast_map,
+                    &low_flow_map, &high_curve_map, &map_w, &map_h,
+                    pdata, pw, ph, lfsctx->dir2rad, lfsctx->dftwaves,
+                    lfsctx->dftgrids, lfsctx->lfsparms)))
+      return(ret);
+
    if((ret = gen_quality_map(&quality_map,
                             direction_map, low_contrast_map,
                             low_flow_map, high_curve_map, map_w, map_h))){
-      free_minutiae(minutiae);
       free(direction_map);
       free(low_contrast_map);
       free(low_flow_map);
       free(high_curve_map);
-      free(bdata);
       return(ret);
    }
 
+   *oquality_map = quality_map;
+   *odirection_map = direction_map;
+   *olow_contrast_map = low_contrast_map;
+   *olow_flow_map = low_flow_map;
+   *ohigh_curve_map = high_curve_map;
+   *omap_w = map_w;
+   *omap_h = map_h;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: get_minutiae_from_maps - Second stage of get_minutiae().  Takes a
+#cat:                grayscale fingerprint image along with the maps that
+#cat:                get_maps() computed for it, binarizes the image and
+#cat:                detects minutiae.  The results are the same as those
+#cat:                of get_minutiae().  The maps are only read, and remain
+#cat:                owned by the caller.
+
+   Input:
+      quality_map      - integrated image quality map
+      direction_map    - direction map
+      low_contrast_map - low contrast map
+      low_flow_map     - low ridge flow map
+      high_curve_map   - high curvature map
+      map_w    - width (in blocks) of image maps
+      map_h    - height (in blocks) of image maps
+      idata    - grayscale fingerprint image data
+      iw       - width (in pixels) of the grayscale image
+      ih       - height (in pixels) of the grayscale image
+      id       - pixel depth (in bits) of the grayscale image
+      ppmm     - the scan resolution (in pixels/mm) of the grayscale image
+      lfsctx   - caller-owned extraction context (see alloc_lfsctx())
+   Output:
+      ominutiae - points to a structure containing the detected minutiae
+      obdata   - points to binarized image data
+      obw      - width (in pixels) of binarized image
+      obh      - height (in pixels) of binarized image
+      obd      - pixel depth (in bits) of binarized image
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int get_minutiae_from_maps(MINUTIAE **ominutiae,
+                 unsigned char **obdata, int *obw, int *obh, int *obd,
+                 int *quality_map, int *direction_map,
+                 int *low_contrast_map, int *low_flow_map,
+                 int *high_curve_map, const int map_w, const int map_h,
+                 unsigned char *idata, const int iw, const int ih,
+                 const int id, const double ppmm, LFSCTX *lfsctx)
+{
+   unsigned char *pdata, *bdata;
+   int pw, ph, bw, bh;
+   MINUTIAE *minutiae;
+   int ret;
+
+   /* If input image is not 8-bit grayscale ... */
+   if(id != 8){
+      fprintf(stderr, "ERROR : get_minutiae_from_maps : input image pixel ");
+      fprintf(stderr, "depth = %d != 8.\n", id);
+      return(-2);
+   }
+
+   if((ret = prepare_lfsctx(lfsctx, iw, ih)))
+      return(ret);
+   if((ret = pad_lfsctx_image(&pdata, &pw, &ph, lfsctx, idata, iw, ih)))
+      return(ret);
+
+   if((ret = detect_from_maps(&minutiae, &bdata, &bw, &bh,
+                          pdata, pw, ph, direction_map, low_contrast_map,
+                          low_flow_map, high_curve_map, map_w, map_h,
+                          iw, ih, lfsctx)))
+      return(ret);
+
    /* Assign reliability from quality map. */
    if((ret = combined_minutia_quality(minutiae, quality_map, map_w, map_h,
-                                     lfsparms->blocksize,
+                                     lfsctx->lfsparms->blocksize,
                                      idata, iw, ih, id, ppmm))){
       free_minutiae(minutiae);
-      free(direction_map);
-      free(low_contrast_map);
-      free(low_flow_map);
-      free(high_curve_map);
-      free(quality_map);
       free(bdata);
       return(ret);
    }
 
-   /* Set output pointers. */
    *ominutiae = minutiae;
-   *oquality_map = quality_map;
-   *odirection_map = direction_map;
-   *olow_contrast_map = low_contrast_map;
-   *olow_flow_map = low_flow_map;
-   *ohigh_curve_map = high_curve_map;
-   *omap_w = map_w;
-   *omap_h = map_h;
    *obdata = bdata;
    *obw = bw;
    *obh = bh;
    *obd = id;
+   return(0);
+}
 
-   /* Return normally. */
+/*************************************************************************
+**************************************************************************
+#cat: add_lfsstream_row - Appends the next row of a fingerprint image that
+#cat:                is being acquired from the bottom up.  The row is padded
+#cat:                and scaled to 6 bits into the stream buffer, and then
+#cat:                every row of blocks whose rotated DFT grids are fully
+#cat:                covered by received pixels is given its initial
+#cat:                direction and contrast analysis.  Only whole multiples
+#cat:                of the block size are treated as received, as the final
+#cat:                image is cropped to that height; the block grid is then
+#cat:                the same whether it is anchored at the top or bottom.
+
+   Input:
+      stream   - stream created by alloc_lfsstream()
+      row      - "iw" 8-bit grayscale pixels, the row directly above the
+                 previous one
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int add_lfsstream_row(LFSSTREAM *stream, const unsigned char *row)
+{
+   const LFSCTX *lfsctx = stream->lfsctx;
+   const LFSPARMS *lfsparms = lfsctx->lfsparms;
+   const int bs = lfsparms->blocksize;
+   unsigned char *pptr;
+   int i, by, win_y, ymaxlimit, safe_top;
+   int ret;
+
+   if(stream->nrows >= stream->max_ih){
+      fprintf(stderr, "ERROR : add_lfsstream_row : ");
+      fprintf(stderr, "stream is full at %d rows\n", stream->max_ih);
+      return(-64);
+   }
+
+   pptr = stream->pdata +
+          ((lfsctx->maxpad + stream->max_ih - 1 - stream->nrows) * stream->pw) +
+          lfsctx->maxpad;
+   for(i = 0; i < stream->iw; i++)
+      pptr[i] = row[i] >> 2;
+   stream->nrows++;
+
+   /* Top of the rows that are certain to be part of the final image. */
+   safe_top = lfsctx->maxpad + stream->max_ih - ((stream->nrows / bs) * bs);
+   /* Same low contrast window limit as gen_initial_map_blocks(). */
+   ymaxlimit = stream->ph - lfsctx->maxpad - lfsparms->windowsize - 1;
+
+   while(stream->nblkrows < stream->max_ih / bs){
+      by = stream->nblkrows;
+      win_y = lfsctx->maxpad + stream->max_ih - ((by + 1) * bs) -
+              lfsparms->windowoffset;
+      win_y = min(ymaxlimit, win_y);
+      /* Rotated grids reach up to "pad" pixels beyond the window. */
+      if(win_y - lfsctx->dftgrids->pad < safe_top)
+         break;
+
+      if((ret = gen_initial_map_blocks(stream->direction_map + (by * stream->mw),
+                     stream->low_contrast_map + (by * stream->mw),
+                     stream->low_flow_map + (by * stream->mw),
+                     stream->blkoffs + (by * stream->mw), stream->mw,
+                     stream->mw, stream->pdata, stream->pw, stream->ph,
+                     lfsctx->dftwaves, lfsctx->dftgrids, lfsparms)))
+         return(ret);
+      stream->nblkrows++;
+   }
+
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: get_minutiae_stream - Finishes minutiae detection for an image whose
+#cat:                rows were fed through add_lfsstream_row().  The results
+#cat:                are identical to calling get_minutiae() on the same
+#cat:                image.  The stream may not be fed any more rows
+#cat:                afterwards.
+
+   Input:
+      idata    - grayscale fingerprint image data, made up of the streamed
+                 rows with the bottom row streamed first
+      iw       - width (in pixels) of the grayscale image
+      ih       - height (in pixels) of the grayscale image.  Must be the
+                 number of rows streamed, rounded down to a multiple of
+                 the block size; any rows above are ignored.
+      id       - pixel depth (in bits) of the grayscale image
+      ppmm     - the scan resolution (in pixels/mm) of the grayscale image
+      stream   - stream created by alloc_lfsstream()
+   Output:
+      (as for get_minutiae)
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int get_minutiae_stream(MINUTIAE **ominutiae, int **oquality_map,
+                 int **odirection_map, int **olow_contrast_map,
+                 int **olow_flow_map, int **ohigh_curve_map,
+                 int *omap_w, int *omap_h,
+                 unsigned char **obdata, int *obw, int *obh, int *obd,
+                 unsigned char *idata, const int iw, const int ih,
+                 const int id, const double ppmm, LFSSTREAM *stream)
+{
+   const int bs = stream->lfsctx->lfsparms->blocksize;
+   int ret;
+   MINUTIAE *minutiae;
+   int *direction_map, *low_contrast_map, *low_flow_map;
+   int *high_curve_map;
+   int map_w, map_h;
+   unsigned char *bdata;
+   int bw, bh;
+
+   /* If input image is not 8-bit grayscale ... */
+   if(id != 8){
+      fprintf(stderr, "ERROR : get_minutiae_stream : input image pixel ");
+      fprintf(stderr, "depth = %d != 8.\n", id);
+      return(-2);
+   }
+
+   if((iw != stream->iw) || (ih != (stream->nrows / bs) * bs) || (ih < bs)){
+      fprintf(stderr, "ERROR : get_minutiae_stream : image %dx%d ", iw, ih);
+      fprintf(stderr, "does not match %d streamed rows\n", stream->nrows);
+      return(-65);
+   }
+
+   /* Detect minutiae in the streamed fingerprint image. */
+   if((ret = lfs_detect_stream_V2(&minutiae,
+                                  &direction_map, &low_contrast_map,
+                                  &low_flow_map, &high_curve_map,
+                                  &map_w, &map_h,
+                                  &bdata, &bw, &bh,
+                                  iw, ih, stream))){
+      return(ret);
+   }
+
+   return(assign_minutiae_quality(ominutiae, oquality_map, odirection_map,
+                 olow_contrast_map, olow_flow_map, ohigh_curve_map,
+                 omap_w, omap_h, obdata, obw, obh, obd,
+                 minutiae, direction_map, low_contrast_map, low_flow_map,
+                 high_curve_map, map_w, map_h, bdata, bw, bh,
+                 idata, iw, ih, id, ppmm, stream->lfsctx->lfsparms));
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: get_preview_maps - Takes a grayscale fingerprint image and quickly
+#cat:                computes coarse Direction and Low Contrast Maps from the
+#cat:                image subsampled by PREVIEW_SCALE.  Only the initial
+#cat:                block analysis is done, without the cleanup steps of
+#cat:                gen_image_maps(), binarization or minutiae detection,
+#cat:                so the maps are good for judging the extent and flow of
+#cat:                the print while it is still on the sensor.
+
+   Input:
+      idata    - 8-bit grayscale fingerprint image data
+      iw       - width (in pixels) of the grayscale image
+      ih       - height (in pixels) of the grayscale image
+      lfsctx   - extraction context allocated with the preview
+                 parameters (lfsparms_preview)
+   Output:
+      odmap    - resulting direction map
+      olcmap   - resulting low contrast map
+      omw      - width (in blocks) of the maps
+      omh      - height (in blocks) of the maps
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int get_preview_maps(int **odmap, int **olcmap, int *omw, int *omh,
+                     unsigned char *idata, const int iw, const int ih,
+                     LFSCTX *lfsctx)
+{
+   const LFSPARMS *lfsparms = lfsctx->lfsparms;
+   unsigned char *hdata, *pdata;
+   int hw, hh, pw, ph, mw, mh;
+   int *blkoffs, *direction_map, *low_contrast_map, *low_flow_map;
+   int ret;
+
+   /* Subsample the input image. */
+   if((ret = half_uchar_image(&hdata, &hw, &hh, idata, iw, ih)))
+      return(ret);
+
+   /* Make sure the context's rotated grids fit the subsampled image. */
+   if((ret = prepare_lfsctx(lfsctx, hw, hh))){
+      free(hdata);
+      return(ret);
+   }
+
+   /* Pad the subsampled image and scale it to 6 bits, as is done */
+   /* by lfs_detect_minutiae_V2().                                */
+   ret = pad_lfsctx_image(&pdata, &pw, &ph, lfsctx, hdata, hw, hh);
+   free(hdata);
+   if(ret)
+      return(ret);
+
+   if((ret = block_offsets(&blkoffs, &mw, &mh, hw, hh,
+                        lfsctx->maxpad, lfsparms->blocksize)))
+      return(ret);
+
+   ret = gen_initial_maps(&direction_map, &low_contrast_map, &low_flow_map,
+                          blkoffs, mw, mh, pdata, pw, ph,
+                          lfsctx->dftwaves, lfsctx->dftgrids, lfsparms);
+   free(blkoffs);
+   if(ret)
+      return(ret);
+
+   /* The Low Flow Map is not needed without the map cleanup. */
+   free(low_flow_map);
+
+   *odmap = direction_map;
+   *olcmap = low_contrast_map;
+   *omw = mw;
+   *omh = mh;
    return(0);
 }
@@ -38,6 +38,9 @@ identified are necessarily the best available for the purpose.
                         dft_dir_powers()
                         sum_rot_block_rows()
                         dft_power()
+                        dft_block_powers()
+                        dft_qpower()
+                        dft_block_qpowers()
                         dft_power_stats()
                         get_max_norm()
                         sort_dft_waves()
@@ -64,10 +67,10 @@ identified are necessarily the best available for the purpose.
    Output:
       rowsums   - the resulting vector of pixel row sums
 **************************************************************************/
-static void sum_rot_block_rows(int *rowsums, const unsigned char *blkptr,
+LFS_KERNEL void sum_rot_block_rows(int *rowsums, const unsigned char *blkptr,
                         const int *grid_offsets, const int blocksize)
 {
-   int ix, iy, gi;
+   int ix, iy, gi, rsum;
 
    /* Initialize rotation offset index. */
    gi = 0;
@@ -75,14 +78,17 @@ static void sum_rot_block_rows(int *rowsums, const unsigned char *blkptr,
    /* For each row in block ... */
    for(iy = 0; iy < blocksize; iy++){
       /* The sums are accumlated along the rotated rows of the grid, */
-      /* so initialize row sum to 0.                                 */
-      rowsums[iy] = 0;
+      /* so initialize row sum to 0.  The sum is kept in a local, as */
+      /* the pixel reads could otherwise alias rowsums[] and force   */
+      /* it through memory on every pixel.                           */
+      rsum = 0;
       /* Foreach column in block ... */
       for(ix = 0; ix < blocksize; ix++){
          /* Accumulate pixel value at rotated grid position in image */
-         rowsums[iy] += *(blkptr + grid_offsets[gi]);
+         rsum += *(blkptr + grid_offsets[gi]);
          gi++;
       }
+      rowsums[iy] = rsum;
    }
 }
 
@@ -103,7 +109,7 @@ static void sum_rot_block_rows(int *rowsums, const unsigned char *blkptr,
       power   - the computed DFT power for the given wave form at the
                 given orientation within the image block
 **************************************************************************/
-static void dft_power(double *power, const int *rowsums,
+LFS_KERNEL void dft_power(double *power, const int *rowsums,
                const DFTWAVE *wave, const int wavelen)
 {
    int i;
@@ -125,6 +131,120 @@ static void dft_power(double *power, const int *rowsums,
    *power = (cospart * cospart) + (sinpart * sinpart);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: dft_block_powers - Inner loops of dft_dir_powers().  The dimensions
+#cat:         are passed separately from the grid and wave structures so
+#cat:         that, when called with constants, the compiler generates a
+#cat:         version with fixed trip counts that it can fully unroll.
+
+   Input:
+      rowsums   - scratch vector of at least grid_w entries
+      blkptr    - the pixel address of the origin of the current window
+      dftwaves  - structure containing the DFT wave forms
+      dftgrids  - structure containing the rotated pixel grid offsets
+      grid_w    - width and height of the rotated grids
+      ngrids    - number of rotated grids (directions)
+      wavelen   - length of each wave form
+      nwaves    - number of wave forms
+   Output:
+      powers    - DFT power computed from each wave form frequencies at each
+                  orientation (direction) in the current image block
+**************************************************************************/
+LFS_KERNEL void dft_block_powers(double **powers, int *rowsums,
+               const unsigned char *blkptr, const DFTWAVES *dftwaves,
+               const ROTGRIDS *dftgrids, const int grid_w, const int ngrids,
+               const int wavelen, const int nwaves)
+{
+   int w, dir;
+
+   /* Foreach direction ... */
+   for(dir = 0; dir < ngrids; dir++){
+      /* Compute vector of line sums from rotated grid */
+      sum_rot_block_rows(rowsums, blkptr, dftgrids->grids[dir], grid_w);
+
+      /* Foreach DFT wave ... */
+      for(w = 0; w < nwaves; w++){
+         dft_power(&(powers[w][dir]), rowsums, dftwaves->waves[w], wavelen);
+      }
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: dft_qpower - Fixed-point version of dft_power().  The row sums are
+#cat:             applied to a wave form held in DFT_QWAVE_SCALE fixed
+#cat:             point, so the dot products run in 32-bit integers (and
+#cat:             vectorize), and the power is scaled back to the units
+#cat:             of dft_power() on output.
+
+   Input:
+      rowsums - accumulated rows of pixels from within a rotated grid
+                overlaying an input image block
+      qcos    - the cosine component of the wave form in fixed point
+      qsin    - the sine component of the wave form in fixed point
+      wavelen - the length of the wave form (must match the height of the
+                image block which is the length of the rowsum vector)
+   Output:
+      power   - the computed DFT power for the given wave form at the
+                given orientation within the image block
+**************************************************************************/
+LFS_KERNEL void dft_qpower(double *power, const int *rowsums,
+               const int *qcos, const int *qsin, const int wavelen)
+{
+   int i, cospart, sinpart;
+
+   cospart = 0;
+   sinpart = 0;
+   for(i = 0; i < wavelen; i++){
+      cospart += rowsums[i] * qcos[i];
+      sinpart += rowsums[i] * qsin[i];
+   }
+
+   /* Square in 64 bits, then remove the scale twice over. */
+   *power = (double)((long long)cospart * cospart +
+                     (long long)sinpart * sinpart) /
+            ((double)DFT_QWAVE_SCALE * (double)DFT_QWAVE_SCALE);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: dft_block_qpowers - Inner loops of dft_dir_powers() for the fixed-point
+#cat:         wave forms.  As with dft_block_powers(), the dimensions are
+#cat:         passed separately so that constant dimensions unroll.
+
+   Input:
+      rowsums   - scratch vector of at least grid_w entries
+      blkptr    - the pixel address of the origin of the current window
+      qwaves    - fixed-point wave forms, cos then sin for each wave
+      dftgrids  - structure containing the rotated pixel grid offsets
+      grid_w    - width and height of the rotated grids, and wave length
+      ngrids    - number of rotated grids (directions)
+      nwaves    - number of wave forms
+   Output:
+      powers    - DFT power computed from each wave form frequencies at each
+                  orientation (direction) in the current image block
+**************************************************************************/
+LFS_KERNEL void dft_block_qpowers(double **powers, int *rowsums,
+               const unsigned char *blkptr, const int *qwaves,
+               const ROTGRIDS *dftgrids, const int grid_w, const int ngrids,
+               const int nwaves)
+{
+   int w, dir;
+   const int *qwave;
+
+   for(dir = 0; dir < ngrids; dir++){
+      sum_rot_block_rows(rowsums, blkptr, dftgrids->grids[dir], grid_w);
+
+      qwave = qwaves;
+      for(w = 0; w < nwaves; w++){
+         dft_qpower(&(powers[w][dir]), rowsums, qwave, qwave + grid_w,
+                    grid_w);
+         qwave += 2 * grid_w;
+      }
+   }
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: dft_dir_powers - Conducts the DFT analysis on a block of image data.
@@ -161,35 +281,46 @@ int dft_dir_powers(double **powers, unsigned char *pdata,
                const int blkoffset, const int pw, const int ph,
                const DFTWAVES *dftwaves, const ROTGRIDS *dftgrids)
 {
-   int w, dir;
    int *rowsums;
+   int v2_rowsums[MAP_WINDOWSIZE_V2];
    unsigned char *blkptr;
 
-   /* Allocate line sum vector, and initialize to zeros */
    /* This routine requires square block (grid), so ERROR otherwise. */
    if(dftgrids->grid_w != dftgrids->grid_h){
       fprintf(stderr, "ERROR : dft_dir_powers : DFT grids must be square\n");
       return(-90);
    }
+
+   blkptr = pdata + blkoffset;
+
+   /* If the grids and waves are those of the default LFS parameters, */
+   /* use the version of the kernels specialized for them, in fixed   */
+   /* point when the waves carry their precomputed integer copy.      */
+   if((dftgrids->grid_w == MAP_WINDOWSIZE_V2) &&
+      (dftgrids->ngrids == NUM_DIRECTIONS) &&
+      (dftwaves->wavelen == MAP_WINDOWSIZE_V2) &&
+      (dftwaves->nwaves == NUM_DFT_WAVES)){
+      if(dftwaves->qwaves != (const int *)NULL)
+         dft_block_qpowers(powers, v2_rowsums, blkptr, dftwaves->qwaves,
+                           dftgrids, MAP_WINDOWSIZE_V2, NUM_DIRECTIONS,
+                           NUM_DFT_WAVES);
+      else
+         dft_block_powers(powers, v2_rowsums, blkptr, dftwaves, dftgrids,
+                          MAP_WINDOWSIZE_V2, NUM_DIRECTIONS,
+                          MAP_WINDOWSIZE_V2, NUM_DFT_WAVES);
+      return(0);
+   }
+
+   /* Allocate line sum vector */
    rowsums = (int *)malloc(dftgrids->grid_w * sizeof(int));
    if(rowsums == (int *)NULL){
       fprintf(stderr, "ERROR : dft_dir_powers : malloc : rowsums\n");
       return(-91);
    }
 
-   /* Foreach direction ... */
-   for(dir = 0; dir < dftgrids->ngrids; dir++){
-      /* Compute vector of line sums from rotated grid */
-      blkptr = pdata + blkoffset;
-      sum_rot_block_rows(rowsums, blkptr,
-                         dftgrids->grids[dir], dftgrids->grid_w);
-
-      /* Foreach DFT wave ... */
-      for(w = 0; w < dftwaves->nwaves; w++){
-         dft_power(&(powers[w][dir]), rowsums,
-                   dftwaves->waves[w], dftwaves->wavelen);
-      }
-   }
+   dft_block_powers(powers, rowsums, blkptr, dftwaves, dftgrids,
+                    dftgrids->grid_w, dftgrids->ngrids,
+                    dftwaves->wavelen, dftwaves->nwaves);
 
    /* Deallocate working memory. */
    free(rowsums);
@@ -292,7 +423,7 @@ static int sort_dft_waves(int *wis, const double *powmaxs, const double *pownorm
    }
 
    /* Sort the statistic indices on the normalized squared power. */
-   bubble_sort_double_dec_2(pownorms2, wis, nstats);
+   sort_double_dec_2(pownorms2, wis, nstats);
 
    /* Deallocate the working memory. */
    free(pownorms2);
@@ -37,6 +37,8 @@ identified are necessarily the best available for the purpose.
                         free_dftwaves()
                         free_rotgrids()
                         free_dir_powers()
+                        free_lfsctx()
+                        free_lfsstream()
 ***********************************************************************/
 
 #include <stdio.h>
@@ -114,3 +116,47 @@ void free_dir_powers(double **powers, const int nwaves)
    free(powers);
 }
 
+
+/*************************************************************************
+**************************************************************************
+#cat: free_lfsctx - Deallocates an extraction context and all of the
+#cat:               lookup tables it holds
+
+   Input:
+      ctx - pointer to memory to be freed
+**************************************************************************/
+void free_lfsctx(LFSCTX *ctx)
+{
+   if(ctx == (LFSCTX *)NULL)
+      return;
+
+   free_dir2rad(ctx->dir2rad);
+   free_dftwaves(ctx->dftwaves);
+   if(ctx->dftgrids != (ROTGRIDS *)NULL){
+      free_rotgrids(ctx->dftgrids);
+      free_rotgrids(ctx->dirbingrids);
+   }
+   free(ctx->pdata);
+   free(ctx);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: free_lfsstream - Deallocates a row stream.  The extraction context
+#cat:               it was created with is left to the caller.
+
+   Input:
+      stream - pointer to memory to be freed
+**************************************************************************/
+void free_lfsstream(LFSSTREAM *stream)
+{
+   if(stream == (LFSSTREAM *)NULL)
+      return;
+
+   free(stream->pdata);
+   free(stream->blkoffs);
+   free(stream->direction_map);
+   free(stream->low_contrast_map);
+   free(stream->low_flow_map);
+   free(stream);
+}
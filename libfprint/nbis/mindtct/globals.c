@@ -39,10 +39,6 @@ identified are necessarily the best available for the purpose.
 /*        GOBAL DECLARATIONS                                             */
 /*************************************************************************/
 
-#ifdef LOG_REPORT
-FILE *logfp;
-#endif
-
 /* Constants (C) for defining 4 DFT frequencies, where  */
 /* frequency is defined as C*(PI_FACTOR).  PI_FACTOR    */
 /* regulates the period of the function in x, so:       */
@@ -50,10 +46,50 @@ FILE *logfp;
 /*      2 = twice the frequency in range X.             */
 /*      3 = three times the frequency in reange X.      */
 /*      4 = four times the frequency in ranage X.       */
-double dft_coefs[NUM_DFT_WAVES] = { 1,2,3,4 };
+const double dft_coefs[NUM_DFT_WAVES] = { 1,2,3,4 };
+
+/* The default DFT wave forms (dft_coefs[] over MAP_WINDOWSIZE_V2 */
+/* samples) in DFT_QWAVE_SCALE fixed point, stored as the rounded  */
+/* cos and then sin components of each wave in turn:               */
+/*      round(cos(2*PI*C*j/24) * 16384)                            */
+/* Used by dft_dir_powers() in place of the double wave forms.     */
+const int dft_qwaves_V2[NUM_DFT_WAVES * 2 * MAP_WINDOWSIZE_V2] = {
+   /* C=1 cos */
+    16384,  15826,  14189,  11585,   8192,   4240,      0,  -4240,
+    -8192, -11585, -14189, -15826, -16384, -15826, -14189, -11585,
+    -8192,  -4240,      0,   4240,   8192,  11585,  14189,  15826,
+   /* C=1 sin */
+        0,   4240,   8192,  11585,  14189,  15826,  16384,  15826,
+    14189,  11585,   8192,   4240,      0,  -4240,  -8192, -11585,
+   -14189, -15826, -16384, -15826, -14189, -11585,  -8192,  -4240,
+   /* C=2 cos */
+    16384,  14189,   8192,      0,  -8192, -14189, -16384, -14189,
+    -8192,      0,   8192,  14189,  16384,  14189,   8192,      0,
+    -8192, -14189, -16384, -14189,  -8192,      0,   8192,  14189,
+   /* C=2 sin */
+        0,   8192,  14189,  16384,  14189,   8192,      0,  -8192,
+   -14189, -16384, -14189,  -8192,      0,   8192,  14189,  16384,
+    14189,   8192,      0,  -8192, -14189, -16384, -14189,  -8192,
+   /* C=3 cos */
+    16384,  11585,      0, -11585, -16384, -11585,      0,  11585,
+    16384,  11585,      0, -11585, -16384, -11585,      0,  11585,
+    16384,  11585,      0, -11585, -16384, -11585,      0,  11585,
+   /* C=3 sin */
+        0,  11585,  16384,  11585,      0, -11585, -16384, -11585,
+        0,  11585,  16384,  11585,      0, -11585, -16384, -11585,
+        0,  11585,  16384,  11585,      0, -11585, -16384, -11585,
+   /* C=4 cos */
+    16384,   8192,  -8192, -16384,  -8192,   8192,  16384,   8192,
+    -8192, -16384,  -8192,   8192,  16384,   8192,  -8192, -16384,
+    -8192,   8192,  16384,   8192,  -8192, -16384,  -8192,   8192,
+   /* C=4 sin */
+        0,  14189,  14189,      0, -14189, -14189,      0,  14189,
+    14189,      0, -14189, -14189,      0,  14189,  14189,      0,
+   -14189, -14189,      0,  14189,  14189,      0, -14189, -14189
+};
 
-/* Allocate and initialize a global LFS parameters structure. */
-LFSPARMS lfsparms = {
+/* Global (read-only) LFS parameters structure. */
+const LFSPARMS lfsparms = {
    /* Image Controls */
    PAD_VALUE,
    JOIN_LINE_RADIUS,
@@ -136,8 +172,8 @@ LFSPARMS lfsparms = {
 };
 
 
-/* Allocate and initialize VERSION 2 global LFS parameters structure. */
-LFSPARMS lfsparms_V2 = {
+/* VERSION 2 global (read-only) LFS parameters structure. */
+const LFSPARMS lfsparms_V2 = {
    /* Image Controls */
    PAD_VALUE,
    JOIN_LINE_RADIUS,
@@ -219,19 +255,104 @@ LFSPARMS lfsparms_V2 = {
    MAX_RIDGE_STEPS
 };
 
+/* Version 2 parameters adapted for get_preview_maps(), which        */
+/* analyzes the image subsampled by PREVIEW_SCALE.  Only the map      */
+/* controls are used.                                                 */
+const LFSPARMS lfsparms_preview = {
+   /* Image Controls */
+   PAD_VALUE,
+   JOIN_LINE_RADIUS,
+
+   /* Map Controls */
+   MAP_BLOCKSIZE_PREVIEW,
+   MAP_WINDOWSIZE_PREVIEW,
+   MAP_WINDOWOFFSET_PREVIEW,
+   NUM_DIRECTIONS,
+   START_DIR_ANGLE,
+   RMV_VALID_NBR_MIN,
+   DIR_STRENGTH_MIN,
+   DIR_DISTANCE_MAX,
+   SMTH_VALID_NBR_MIN,
+   VORT_VALID_NBR_MIN,
+   HIGHCURV_VORTICITY_MIN,
+   HIGHCURV_CURVATURE_MIN,
+   MIN_INTERPOLATE_NBRS,
+   PERCENTILE_MIN_MAX,
+   MIN_CONTRAST_DELTA,
+
+   /* DFT Controls */
+   NUM_DFT_WAVES,
+   POWMAX_MIN_PREVIEW,
+   POWNORM_MIN,
+   POWMAX_MAX_PREVIEW,
+   FORK_INTERVAL,
+   FORK_PCT_POWMAX,
+   FORK_PCT_POWNORM,
+
+   /* Binarization Controls */
+   DIRBIN_GRID_W,
+   DIRBIN_GRID_H,
+   UNUSED_INT,          /* isobin_grid_dim */
+   NUM_FILL_HOLES,
+
+   /* Minutiae Detection Controls */
+   MAX_MINUTIA_DELTA,
+   MAX_HIGH_CURVE_THETA,
+   HIGH_CURVE_HALF_CONTOUR,
+   MIN_LOOP_LEN,
+   MIN_LOOP_ASPECT_DIST,
+   MIN_LOOP_ASPECT_RATIO,
+
+   /* Minutiae Link Controls */
+   UNUSED_INT,          /* link_table_dim     */
+   UNUSED_INT,          /* max_link_dist      */
+   UNUSED_INT,          /* min_theta_dist     */
+   MAXTRANS,            /* used for removing overlaps as well */
+   UNUSED_DBL,          /* score_theta_norm   */
+   UNUSED_DBL,          /* score_dist_norm    */
+   UNUSED_DBL,          /* score_dist_weight  */
+   UNUSED_DBL,          /* score_numerator    */
+
+   /* False Minutiae Removal Controls */
+   MAX_RMTEST_DIST_V2,
+   MAX_HOOK_LEN_V2,
+   MAX_HALF_LOOP_V2,
+   TRANS_DIR_PIX_V2,
+   SMALL_LOOP_LEN,
+   SIDE_HALF_CONTOUR,
+   INV_BLOCK_MARGIN_V2,
+   RM_VALID_NBR_MIN,
+   MAX_OVERLAP_DIST,
+   MAX_OVERLAP_JOIN_DIST,
+   MALFORMATION_STEPS_1,
+   MALFORMATION_STEPS_2,
+   MIN_MALFORMATION_RATIO,
+   MAX_MALFORMATION_DIST,
+   PORES_TRANS_R,
+   PORES_PERP_STEPS,
+   PORES_STEPS_FWD,
+   PORES_STEPS_BWD,
+   PORES_MIN_DIST2,
+   PORES_MAX_RATIO,
+
+   /* Ridge Counting Controls */
+   MAX_NBRS,
+   MAX_RIDGE_STEPS
+};
+
 /* Variables for conducting 8-connected neighbor analyses. */
 /* Pixel neighbor offsets:  0  1  2  3  4  5  6  7  */     /* 7 0 1 */
-int nbr8_dx[] =          {  0, 1, 1, 1, 0,-1,-1,-1 };      /* 6 C 2 */
-int nbr8_dy[] =          { -1,-1, 0, 1, 1, 1, 0,-1 };      /* 5 4 3 */
+const int nbr8_dx[] =    {  0, 1, 1, 1, 0,-1,-1,-1 };      /* 6 C 2 */
+const int nbr8_dy[] =    { -1,-1, 0, 1, 1, 1, 0,-1 };      /* 5 4 3 */
 
 /* The chain code lookup matrix for 8-connected neighbors. */
 /* Should put this in globals.                             */
-int chaincodes_nbr8[]={ 3, 2, 1,
-                        4,-1, 0,
-                        5, 6, 7};
+const int chaincodes_nbr8[]={ 3, 2, 1,
+                              4,-1, 0,
+                              5, 6, 7};
 
 /* Global array of feature pixel pairs. */
-FEATURE_PATTERN feature_patterns[]=
+const FEATURE_PATTERN feature_patterns[]=
                        {{RIDGE_ENDING,  /* a. Ridge Ending (appearing) */
                          APPEARING,
                          {0,0},
@@ -38,6 +38,8 @@ identified are necessarily the best available for the purpose.
                         bits_8to6()
                         gray2bin()
                         pad_uchar_image()
+                        half_uchar_image()
+                        transpose_uchar_image()
                         fill_holes()
                         free_path()
                         search_in_direction()
@@ -48,6 +50,12 @@ identified are necessarily the best available for the purpose.
 #include <stdlib.h>
 #include <memory.h>
 #include <lfs.h>
+#include <morph.h>
+
+/* Number of columns fill_holes() carries down the image at a time. */
+#define FILL_HOLES_STRIP   256
+/* Width and height of the tiles copied by transpose_uchar_image(). */
+#define TRANSPOSE_TILE      32
 
 /*************************************************************************
 **************************************************************************
@@ -207,6 +215,99 @@ int pad_uchar_image(unsigned char **optr, int *ow, int *oh,
    return(0);
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: half_uchar_image - Subsamples an 8-bit grayscale image by 2 in each
+#cat:              dimension, each output pixel being the rounded mean of
+#cat:              a 2X2 neighborhood of input pixels.  A trailing odd
+#cat:              row or column of the input is dropped.
+
+   Input:
+      idata     - input image data
+      iw        - width (in pixels) of the input image
+      ih        - height (in pixels) of the input image
+   Output:
+      optr      - points to the newly subsampled image
+      ow        - width (in pixels) of the subsampled image
+      oh        - height (in pixels) of the subsampled image
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int half_uchar_image(unsigned char **optr, int *ow, int *oh,
+                     unsigned char *idata, const int iw, const int ih)
+{
+   unsigned char *hdata, *hptr, *iptr;
+   int x, y, hw, hh;
+
+   hw = iw >> 1;
+   hh = ih >> 1;
+
+   hdata = (unsigned char *)malloc(hw * hh * sizeof(unsigned char));
+   if(hdata == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : half_uchar_image : malloc : hdata\n");
+      return(-66);
+   }
+
+   hptr = hdata;
+   for(y = 0; y < hh; y++){
+      iptr = idata + ((y << 1) * iw);
+      for(x = 0; x < hw; x++){
+         *hptr++ = (iptr[0] + iptr[1] + iptr[iw] + iptr[iw+1] + 2) >> 2;
+         iptr += 2;
+      }
+   }
+
+   *optr = hdata;
+   *ow = hw;
+   *oh = hh;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: transpose_uchar_image - Allocates and returns a transposed copy of an
+#cat:              8-bit image, so that its columns can be walked as
+#cat:              contiguous rows.  The copy is made in square tiles to
+#cat:              keep both the reads and the writes within cache.
+
+   Input:
+      idata     - input image data
+      iw        - width (in pixels) of the input image
+      ih        - height (in pixels) of the input image
+   Output:
+      optr      - points to the transposed image, ih pixels wide and
+                  iw pixels high
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int transpose_uchar_image(unsigned char **optr, const unsigned char *idata,
+                          const int iw, const int ih)
+{
+   unsigned char *tdata;
+   int x, y, tx, ty, ex, ey;
+
+   tdata = (unsigned char *)malloc(iw * ih * sizeof(unsigned char));
+   if(tdata == (unsigned char *)NULL){
+      fprintf(stderr, "ERROR : transpose_uchar_image : malloc : tdata\n");
+      return(-68);
+   }
+
+   for(ty = 0; ty < ih; ty += TRANSPOSE_TILE){
+      ey = min(ty + TRANSPOSE_TILE, ih);
+      for(tx = 0; tx < iw; tx += TRANSPOSE_TILE){
+         ex = min(tx + TRANSPOSE_TILE, iw);
+         for(x = tx; x < ex; x++)
+            for(y = ty; y < ey; y++)
+               tdata[(x * ih) + y] = idata[(y * iw) + x];
+      }
+   }
+
+   *optr = tdata;
+   return(0);
+}
+
 /*************************************************************************
 **************************************************************************
 #cat: fill_holes - Takes an input image and analyzes triplets of horizontal
@@ -215,6 +316,8 @@ int pad_uchar_image(unsigned char **optr, int *ow, int *oh,
 #cat:              the neighboring 2 pixels are equal, AND the center pixel
 #cat:              is different.  Each hole is filled with the value of its
 #cat:              immediate neighbors. This routine modifies the input image.
+#cat:              Pixels are tested MORPH_LANES at a time, and the vertical
+#cat:              pass walks the image a row at a time.
 
    Input:
       bdata - binary image data to be processed
@@ -225,75 +328,82 @@ int pad_uchar_image(unsigned char **optr, int *ow, int *oh,
 **************************************************************************/
 void fill_holes(unsigned char *bdata, const int iw, const int ih)
 {
-   int ix, iy, iw2;
-   unsigned char *lptr, *mptr, *rptr, *tptr, *bptr, *sptr;
+   int ix, iy, i, x0, n;
+   int skip;
+   unsigned char *rptr, *mptr, *tptr, *bptr;
+   unsigned char filled[FILL_HOLES_STRIP], lanes[MORPH_LANES];
+   unsigned long long l, m, r, t, b, f, holes;
 
    /* 1. Fill 1-pixel wide holes in horizontal runs first ... */
-   sptr = bdata + 1;
-   /* Foreach row in image ... */
+   /* Once a hole is filled it equals both its neighbors, so the pixel */
+   /* to its right can no longer be a hole and is skipped.  Holes are  */
+   /* flagged a word at a time on the unfilled pixels, and only words  */
+   /* with holes are walked pixel by pixel to apply that skip.         */
    for(iy = 0; iy < ih; iy++){
-      /* Initialize pointers to start of next line ... */
-      lptr = sptr-1;   /* Left pixel   */
-      mptr = sptr;     /* Middle pixel */
-      rptr = sptr+1;   /* Right pixel  */
-      /* Foreach column in image (less far left and right pixels) ... */
-      for(ix = 1; ix < iw-1; ix++){
-         /* Do we have a horizontal hole of length 1? */
-         if((*lptr != *mptr) && (*lptr == *rptr)){
-            /* If so, then fill it. */
-            *mptr = *lptr;
-            /* Bump passed right pixel because we know it will not */
-            /* be a hole.                                          */
-            lptr+=2;
-            mptr+=2;
-            rptr+=2;
-            /* We bump ix once here and then the FOR bumps it again. */
-            ix++;
+      rptr = bdata + (iy * iw);
+      skip = FALSE;
+      for(ix = 1; ix + MORPH_LANES < iw; ix += MORPH_LANES){
+         MORPH_LOAD(l, rptr + ix - 1);
+         MORPH_LOAD(m, rptr + ix);
+         MORPH_LOAD(r, rptr + ix + 1);
+         holes = MORPH_NZ(l ^ m) & ~MORPH_NZ(l ^ r);
+         if(holes == 0){
+            skip = FALSE;
+            continue;
          }
-         else{
-            /* Otherwise, bump to the next pixel to the right. */
-            lptr++;
-            mptr++;
-            rptr++;
+         MORPH_STORE(lanes, holes);
+         for(i = 0; i < MORPH_LANES; i++){
+            if(lanes[i] && !skip){
+               rptr[ix+i] = rptr[ix+i-1];
+               skip = TRUE;
+            }
+            else
+               skip = FALSE;
+         }
+      }
+      /* Remaining pixels (less the far right one) ... */
+      for(; ix < iw-1; ix++){
+         if(!skip && (rptr[ix-1] != rptr[ix]) &&
+            (rptr[ix-1] == rptr[ix+1])){
+            rptr[ix] = rptr[ix-1];
+            skip = TRUE;
          }
+         else
+            skip = FALSE;
       }
-      /* Bump to start of next row. */
-      sptr += iw;
    }
 
    /* 2. Now, fill 1-pixel wide holes in vertical runs ... */
-   iw2 = iw<<1;
-   /* Start processing column one row down from the top of the image. */
-   sptr = bdata + iw;
-   /* Foreach column in image ... */
-   for(ix = 0; ix < iw; ix++){
-      /* Initialize pointers to start of next column ... */
-      tptr = sptr-iw;   /* Top pixel     */
-      mptr = sptr;      /* Middle pixel  */
-      bptr = sptr+iw;   /* Bottom pixel  */
-      /* Foreach row in image (less top and bottom row) ... */
+   /* Columns are independent, so rather than walking each column, a */
+   /* strip of columns is walked down a row at a time, remembering   */
+   /* per column whether the pixel above was just filled (0xff).     */
+   for(x0 = 0; x0 < iw; x0 += FILL_HOLES_STRIP){
+      n = min(FILL_HOLES_STRIP, iw - x0);
+      memset(filled, 0, n);
       for(iy = 1; iy < ih-1; iy++){
-         /* Do we have a vertical hole of length 1? */
-         if((*tptr != *mptr) && (*tptr == *bptr)){
-            /* If so, then fill it. */
-            *mptr = *tptr;
-            /* Bump passed bottom pixel because we know it will not */
-            /* be a hole.                                           */
-            tptr+=iw2;
-            mptr+=iw2;
-            bptr+=iw2;
-            /* We bump iy once here and then the FOR bumps it again. */
-            iy++;
+         mptr = bdata + (iy * iw) + x0;
+         tptr = mptr - iw;
+         bptr = mptr + iw;
+         for(ix = 0; ix + MORPH_LANES <= n; ix += MORPH_LANES){
+            MORPH_LOAD(t, tptr + ix);
+            MORPH_LOAD(m, mptr + ix);
+            MORPH_LOAD(b, bptr + ix);
+            MORPH_LOAD(f, filled + ix);
+            f = MORPH_NZ(t ^ m) & ~MORPH_NZ(t ^ b) & ~f;
+            m = (m & ~f) | (t & f);
+            MORPH_STORE(mptr + ix, m);
+            MORPH_STORE(filled + ix, f);
          }
-         else{
-            /* Otherwise, bump to the next pixel below. */
-            tptr+=iw;
-            mptr+=iw;
-            bptr+=iw;
+         for(; ix < n; ix++){
+            if(!filled[ix] && (tptr[ix] != mptr[ix]) &&
+               (tptr[ix] == bptr[ix])){
+               mptr[ix] = tptr[ix];
+               filled[ix] = 0xff;
+            }
+            else
+               filled[ix] = 0;
          }
       }
-      /* Bump to start of next column. */
-      sptr++;
    }
 }
 
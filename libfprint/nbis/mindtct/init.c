@@ -41,10 +41,15 @@ identified are necessarily the best available for the purpose.
                         init_rotgrids()
                         alloc_dir_powers()
                         alloc_power_stats()
+                        alloc_lfsctx()
+                        prepare_lfsctx()
+                        pad_lfsctx_image()
+                        alloc_lfsstream()
 ***********************************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <lfs.h>
 
 /*************************************************************************
@@ -238,6 +243,9 @@ int init_dftwaves(DFTWAVES **optr, const double *dft_coefs,
       }
    }
 
+   /* No fixed-point copy unless the caller attaches one. */
+   dftwaves->qwaves = (const int *)NULL;
+
    *optr = dftwaves;
    return(0);
 }
@@ -691,3 +699,266 @@ int alloc_power_stats(int **owis, double **opowmaxs, int **opowmax_dirs,
 
 
 
+
+/*************************************************************************
+**************************************************************************
+#cat: alloc_lfsctx - Allocates an extraction context for use with
+#cat:             get_minutiae().  The direction and DFT wave lookup tables
+#cat:             are computed up front; the rotated grids are deferred
+#cat:             until prepare_lfsctx() learns the image dimensions.
+
+   Input:
+      lfsparms  - parameters and thresholds for controlling LFS.  Must
+                  remain valid for the lifetime of the context.
+   Output:
+      octx      - points to the allocated/initialized LFSCTX structure
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int alloc_lfsctx(LFSCTX **octx, const LFSPARMS *lfsparms)
+{
+   LFSCTX *ctx;
+   int ret;
+
+   ctx = (LFSCTX *)calloc(1, sizeof(LFSCTX));
+   if(ctx == (LFSCTX *)NULL){
+      fprintf(stderr, "ERROR : alloc_lfsctx : calloc : ctx\n");
+      return(-60);
+   }
+
+   ctx->lfsparms = lfsparms;
+
+   /* Determine the maximum amount of image padding required to support */
+   /* LFS processes.                                                    */
+   ctx->maxpad = get_max_padding_V2(lfsparms->windowsize,
+                          lfsparms->windowoffset,
+                          lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h);
+
+   /* Initialize lookup table for converting integer directions */
+   /* to angles in radians.                                     */
+   if((ret = init_dir2rad(&(ctx->dir2rad), lfsparms->num_directions))){
+      free(ctx);
+      return(ret);
+   }
+
+   /* Initialize wave form lookup tables for DFT analyses. */
+   if((ret = init_dftwaves(&(ctx->dftwaves), dft_coefs,
+                           lfsparms->num_dft_waves, lfsparms->windowsize))){
+      free_dir2rad(ctx->dir2rad);
+      free(ctx);
+      return(ret);
+   }
+   /* The default wave forms have a precomputed fixed-point copy */
+   /* that lets dft_dir_powers() run in integer arithmetic.      */
+   if((lfsparms->num_dft_waves == NUM_DFT_WAVES) &&
+      (lfsparms->windowsize == MAP_WINDOWSIZE_V2))
+      ctx->dftwaves->qwaves = dft_qwaves_V2;
+
+   *octx = ctx;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: prepare_lfsctx - Makes sure the rotated grids held in an extraction
+#cat:             context match the dimensions of the image about to be
+#cat:             processed.  Grid offsets are relative to the padded
+#cat:             image width, so they are only rebuilt when it changes.
+
+   Input:
+      ctx       - extraction context
+      iw        - width (in pixels) of the input image
+      ih        - height (in pixels) of the input image
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int prepare_lfsctx(LFSCTX *ctx, const int iw, const int ih)
+{
+   const LFSPARMS *lfsparms = ctx->lfsparms;
+   ROTGRIDS *dftgrids, *dirbingrids;
+   int ret;
+
+   if(ctx->dftgrids != (ROTGRIDS *)NULL && ctx->iw == iw)
+      return(0);
+
+   /* Initialize lookup table for pixel offsets to rotated grids */
+   /* used for DFT analyses.                                     */
+   if((ret = init_rotgrids(&dftgrids, iw, ih, ctx->maxpad,
+                        lfsparms->start_dir_angle, lfsparms->num_directions,
+                        lfsparms->windowsize, lfsparms->windowsize,
+                        RELATIVE2ORIGIN)))
+      return(ret);
+
+   /* Initialize lookup table for pixel offsets to rotated grids */
+   /* used for directional binarization.                         */
+   if((ret = init_rotgrids(&dirbingrids, iw, ih, ctx->maxpad,
+                        lfsparms->start_dir_angle, lfsparms->num_directions,
+                        lfsparms->dirbin_grid_w, lfsparms->dirbin_grid_h,
+                        RELATIVE2CENTER))){
+      free_rotgrids(dftgrids);
+      return(ret);
+   }
+
+   if(ctx->dftgrids != (ROTGRIDS *)NULL){
+      free_rotgrids(ctx->dftgrids);
+      free_rotgrids(ctx->dirbingrids);
+   }
+   ctx->dftgrids = dftgrids;
+   ctx->dirbingrids = dirbingrids;
+   ctx->iw = iw;
+
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: pad_lfsctx_image - Copies an image into the padded image buffer of an
+#cat:             extraction context, scaling it to 6 bits [0..63] on the
+#cat:             way.  This does the work of pad_uchar_image() followed by
+#cat:             bits_8to6() in a single pass, and the buffer is reused
+#cat:             from one image to the next, so no allocation is needed
+#cat:             unless the image is larger than any before it.
+
+   Input:
+      ctx       - extraction context
+      idata     - input image data (8 bits [0..256) grayscale)
+      iw        - width (in pixels) of the input image
+      ih        - height (in pixels) of the input image
+   Output:
+      optr      - points to the padded image, which is owned by the
+                  context and valid until its next use
+      ow        - width (in pixels) of the padded image
+      oh        - height (in pixels) of the padded image
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int pad_lfsctx_image(unsigned char **optr, int *ow, int *oh, LFSCTX *ctx,
+                     const unsigned char *idata, const int iw, const int ih)
+{
+   const int pad = ctx->maxpad;
+   const unsigned char pad_value = ctx->lfsparms->pad_value >> 2;
+   unsigned char *pdata, *pptr;
+   int i, j, pw, ph, psize;
+
+   pw = iw + (pad<<1);
+   ph = ih + (pad<<1);
+   psize = pw * ph;
+
+   if(psize > ctx->pdata_size){
+      pdata = (unsigned char *)malloc(psize * sizeof(unsigned char));
+      if(pdata == (unsigned char *)NULL){
+         fprintf(stderr, "ERROR : pad_lfsctx_image : malloc : pdata\n");
+         return(-67);
+      }
+      free(ctx->pdata);
+      ctx->pdata = pdata;
+      ctx->pdata_size = psize;
+   }
+   pdata = ctx->pdata;
+
+   /* Top pad rows, plus the left pad of the first image row. */
+   memset(pdata, pad_value, (pad * pw) + pad);
+   pptr = pdata + (pad * pw) + pad;
+   for(i = 0; i < ih; i++){
+      for(j = 0; j < iw; j++)
+         pptr[j] = idata[j] >> 2;
+      idata += iw;
+      pptr += iw;
+      /* Right pad of this row and left pad of the next. */
+      memset(pptr, pad_value, pad<<1);
+      pptr += pad<<1;
+   }
+   /* Remaining bottom pad rows. */
+   memset(pptr, pad_value, (pad * pw) - pad);
+
+   *optr = pdata;
+   *ow = pw;
+   *oh = ph;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: alloc_lfsstream - Allocates a stream for feeding an image to the
+#cat:             extractor row by row, bottom row first, while it is
+#cat:             still being acquired.  See add_lfsstream_row() and
+#cat:             get_minutiae_stream().
+
+   Input:
+      ctx       - extraction context, which must outlive the stream and
+                  not be used for anything else until the stream is done
+      iw        - width (in pixels) of the image rows
+      max_ih    - maximum number of rows that will be streamed
+   Output:
+      ostream   - points to the allocated/initialized LFSSTREAM structure
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int alloc_lfsstream(LFSSTREAM **ostream, LFSCTX *ctx,
+                    const int iw, const int max_ih)
+{
+   const LFSPARMS *lfsparms = ctx->lfsparms;
+   LFSSTREAM *stream;
+   int *rowoffs;
+   int i, mw, mh, nblks, by, bx;
+   int ret;
+
+   if((ret = prepare_lfsctx(ctx, iw, max_ih)))
+      return(ret);
+
+   /* Offsets of a single row of blocks at the top of the padded image. */
+   if((ret = block_offsets(&rowoffs, &mw, &mh, iw, lfsparms->blocksize,
+                           ctx->maxpad, lfsparms->blocksize)))
+      return(ret);
+
+   stream = (LFSSTREAM *)calloc(1, sizeof(LFSSTREAM));
+   if(stream == (LFSSTREAM *)NULL){
+      free(rowoffs);
+      fprintf(stderr, "ERROR : alloc_lfsstream : calloc : stream\n");
+      return(-61);
+   }
+   stream->lfsctx = ctx;
+   stream->iw = iw;
+   stream->max_ih = max_ih;
+   stream->pw = iw + (ctx->maxpad<<1);
+   stream->ph = max_ih + (ctx->maxpad<<1);
+   stream->mw = mw;
+
+   nblks = mw * (max_ih / lfsparms->blocksize);
+   stream->pdata = (unsigned char *)malloc(stream->pw * stream->ph);
+   stream->blkoffs = (int *)malloc(nblks * sizeof(int));
+   stream->direction_map = (int *)malloc(nblks * sizeof(int));
+   stream->low_contrast_map = (int *)calloc(nblks, sizeof(int));
+   stream->low_flow_map = (int *)calloc(nblks, sizeof(int));
+   if((stream->pdata == (unsigned char *)NULL) ||
+      (stream->blkoffs == (int *)NULL) ||
+      (stream->direction_map == (int *)NULL) ||
+      (stream->low_contrast_map == (int *)NULL) ||
+      (stream->low_flow_map == (int *)NULL)){
+      free(rowoffs);
+      free_lfsstream(stream);
+      fprintf(stderr, "ERROR : alloc_lfsstream : malloc : buffers\n");
+      return(-62);
+   }
+
+   /* Whole buffer starts out as padding, scaled to 6 bits like the rows. */
+   memset(stream->pdata, lfsparms->pad_value>>2, stream->pw * stream->ph);
+   memset(stream->direction_map, INVALID_DIR, nblks * sizeof(int));
+
+   /* Rows of blocks are laid out upwards from the bottom of the buffer. */
+   i = 0;
+   for(by = 0; by < max_ih / lfsparms->blocksize; by++){
+      for(bx = 0; bx < mw; bx++){
+         stream->blkoffs[i++] = rowoffs[bx] +
+            ((max_ih - ((by + 1) * lfsparms->blocksize)) * stream->pw);
+      }
+   }
+   free(rowoffs);
+
+   *ostream = stream;
+   return(0);
+}
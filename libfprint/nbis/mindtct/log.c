@@ -40,12 +40,12 @@ identified are necessarily the best available for the purpose.
 
 #include <log.h>
 
-/* If logging is on, declare global file pointer and supporting */
-/* global variable for logging intermediate results.            */
+/* If logging is on, declare global file pointer for logging     */
+/* intermediate results.  The log file is shared by every caller, */
+/* so LOG_REPORT builds must not run extractions concurrently.    */
+#ifdef LOG_REPORT
 FILE *logfp;
-int avrdir;
-float dir_strength;
-int nvalid;
+#endif
 
 /***************************************************************************/
 /***************************************************************************/
@@ -789,7 +789,7 @@ int process_loop(MINUTIAE *minutiae,
    int mid_x, mid_y, mid_pix;
    int feature_pix;
    int ret;
-   MINUTIA *minutia;
+   MINUTIA minutia;
 
    /* If contour is empty, then just return. */
    if(ncontour <= 0)
@@ -841,21 +841,13 @@ int process_loop(MINUTIAE *minutiae,
                return(appearing);
             }
             /* Create new minutia object. */
-            if((ret = create_minutia(&minutia,
-                                    contour_x[max_fr], contour_y[max_fr],
-                                    contour_ex[max_fr], contour_ey[max_fr],
-                                    idir, DEFAULT_RELIABILITY,
-                                    type, appearing, LOOP_ID))){
-               /* Return system error code. */
-               return(ret);
-            }
+            init_minutia(&minutia,
+                         contour_x[max_fr], contour_y[max_fr],
+                         contour_ex[max_fr], contour_ey[max_fr],
+                         idir, DEFAULT_RELIABILITY,
+                         type, appearing, LOOP_ID);
             /* Update the minutiae list with potential new minutia. */
-            ret = update_minutiae(minutiae, minutia, bdata, iw, ih, lfsparms);
-
-            /* If minuitia IGNORED and not added to the minutia list ... */
-            if(ret == IGNORE)
-               /* Deallocate the minutia. */
-               free_minutia(minutia);
+            ret = update_minutiae(minutiae, &minutia, bdata, iw, ih, lfsparms);
 
             /* 2. Treat point opposite of maximum distance point as */
             /*    a potential minutia.                              */
@@ -875,21 +867,13 @@ int process_loop(MINUTIAE *minutiae,
                return(appearing);
             }
             /* Create new minutia object. */
-            if((ret = create_minutia(&minutia,
-                                    contour_x[max_to], contour_y[max_to],
-                                    contour_ex[max_to], contour_ey[max_to],
-                                    idir, DEFAULT_RELIABILITY,
-                                    type, appearing, LOOP_ID))){
-               /* Return system error code. */
-               return(ret);
-            }
+            init_minutia(&minutia,
+                         contour_x[max_to], contour_y[max_to],
+                         contour_ex[max_to], contour_ey[max_to],
+                         idir, DEFAULT_RELIABILITY,
+                         type, appearing, LOOP_ID);
             /* Update the minutiae list with potential new minutia. */
-            ret = update_minutiae(minutiae, minutia, bdata, iw, ih, lfsparms);
-
-            /* If minuitia IGNORED and not added to the minutia list ... */
-            if(ret == IGNORE)
-               /* Deallocate the minutia. */
-               free_minutia(minutia);
+            ret = update_minutiae(minutiae, &minutia, bdata, iw, ih, lfsparms);
 
             /* Done successfully processing this loop, so return normally. */
             return(0);
@@ -947,7 +931,7 @@ int process_loop_V2(MINUTIAE *minutiae,
    int mid_x, mid_y, mid_pix;
    int feature_pix;
    int ret;
-   MINUTIA *minutia;
+   MINUTIA minutia;
    int fmapval;
    double reliability;
 
@@ -1013,22 +997,14 @@ int process_loop_V2(MINUTIAE *minutiae,
                reliability = HIGH_RELIABILITY;
 
             /* Create new minutia object. */
-            if((ret = create_minutia(&minutia,
-                                    contour_x[max_fr], contour_y[max_fr],
-                                    contour_ex[max_fr], contour_ey[max_fr],
-                                    idir, reliability,
-                                    type, appearing, LOOP_ID))){
-               /* Return system error code. */
-               return(ret);
-            }
+            init_minutia(&minutia,
+                         contour_x[max_fr], contour_y[max_fr],
+                         contour_ex[max_fr], contour_ey[max_fr],
+                         idir, reliability,
+                         type, appearing, LOOP_ID);
             /* Update the minutiae list with potential new minutia.  */
             /* NOTE: Deliberately using version one of this routine. */
-            ret = update_minutiae(minutiae, minutia, bdata, iw, ih, lfsparms);
-
-            /* If minuitia IGNORED and not added to the minutia list ... */
-            if(ret == IGNORE)
-               /* Deallocate the minutia. */
-               free_minutia(minutia);
+            ret = update_minutiae(minutiae, &minutia, bdata, iw, ih, lfsparms);
 
             /* 2. Treat point opposite of maximum distance point as */
             /*    a potential minutia.                              */
@@ -1060,23 +1036,15 @@ int process_loop_V2(MINUTIAE *minutiae,
                reliability = HIGH_RELIABILITY;
 
             /* Create new minutia object. */
-            if((ret = create_minutia(&minutia,
-                                    contour_x[max_to], contour_y[max_to],
-                                    contour_ex[max_to], contour_ey[max_to],
-                                    idir, reliability,
-                                    type, appearing, LOOP_ID))){
-               /* Return system error code. */
-               return(ret);
-            }
+            init_minutia(&minutia,
+                         contour_x[max_to], contour_y[max_to],
+                         contour_ex[max_to], contour_ey[max_to],
+                         idir, reliability,
+                         type, appearing, LOOP_ID);
 
             /* Update the minutiae list with potential new minutia. */
             /* NOTE: Deliberately using version one of this routine. */
-            ret = update_minutiae(minutiae, minutia, bdata, iw, ih, lfsparms);
-
-            /* If minuitia IGNORED and not added to the minutia list ... */
-            if(ret == IGNORE)
-               /* Deallocate the minutia. */
-               free_minutia(minutia);
+            ret = update_minutiae(minutiae, &minutia, bdata, iw, ih, lfsparms);
 
             /* Done successfully processing this loop, so return normally. */
             return(0);
@@ -40,7 +40,9 @@ identified are necessarily the best available for the purpose.
 ***********************************************************************
                ROUTINES:
                         gen_image_maps()
+                        refine_image_maps()
                         gen_initial_maps()
+                        gen_initial_map_blocks()
                         interpolate_direction_map()
                         morph_TF_map()
                         pixelize_map()
@@ -137,6 +139,57 @@ int gen_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
       return(ret);
    }
 
+   /* 3-9. Clean up the initial maps and derive the High Curvature Map. */
+   if((ret = refine_image_maps(&high_curve_map, direction_map,
+                               low_contrast_map, low_flow_map, mw, mh,
+                               dir2rad, lfsparms))){
+      return(ret);
+   }
+
+   /* Deallocate working memory. */
+   free(blkoffs);
+
+   *odmap = direction_map;
+   *olcmap = low_contrast_map;
+   *olfmap = low_flow_map;
+   *ohcmap = high_curve_map;
+   *omw = mw;
+   *omh = mh;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: refine_image_maps - Takes the initial Direction, Low Contrast, and
+#cat:            Low Flow Maps produced by the block-wise DFT analysis and
+#cat:            applies the image-wide cleanup steps of gen_image_maps():
+#cat:            removal of inconsistent directions, smoothing, and
+#cat:            interpolation.  The High Curvature Map is then generated
+#cat:            from the resulting Direction Map.
+
+   Input:
+      direction_map    - initial Direction Map
+      low_contrast_map - Low Contrast Map
+      low_flow_map     - initial Low Ridge Flow Map
+      mw        - width (in blocks) of the maps
+      mh        - height (in blocks) of the maps
+      dir2rad   - lookup table for converting integer directions
+      lfsparms  - parameters and thresholds for controlling LFS
+   Output:
+      direction_map    - contains the cleaned up Direction Map
+      low_flow_map     - contains the morphed Low Ridge Flow Map
+      ohcmap    - points to the created High Curvature Map
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int refine_image_maps(int **ohcmap, int *direction_map,
+              int *low_contrast_map, int *low_flow_map,
+              const int mw, const int mh,
+              const DIR2RAD *dir2rad, const LFSPARMS *lfsparms)
+{
+   int ret; /* return code */
+
    if((ret = morph_TF_map(low_flow_map, mw, mh, lfsparms))){
       return(ret);
    }
@@ -169,21 +222,7 @@ int gen_image_maps(int **odmap, int **olcmap, int **olfmap, int **ohcmap,
    set_margin_blocks(direction_map, mw, mh, INVALID_DIR);
 
    /* 9. Generate High Curvature Map from interpolated Direction Map. */
-   if((ret = gen_high_curve_map(&high_curve_map, direction_map, mw, mh,
-                                lfsparms))){
-      return(ret);
-   }
-
-   /* Deallocate working memory. */
-   free(blkoffs);
-
-   *odmap = direction_map;
-   *olcmap = low_contrast_map;
-   *olfmap = low_flow_map;
-   *ohcmap = high_curve_map;
-   *omw = mw;
-   *omh = mh;
-   return(0);
+   return(gen_high_curve_map(ohcmap, direction_map, mw, mh, lfsparms));
 }
 
 /*************************************************************************
@@ -230,14 +269,8 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
                 const LFSPARMS *lfsparms)
 {
    int *direction_map, *low_contrast_map, *low_flow_map;
-   int bi, bsize, blkdir;
-   int *wis, *powmax_dirs;
-   double **powers, *powmaxs, *pownorms;
-   int nstats;
+   int bsize;
    int ret; /* return code */
-   int dft_offset;
-   int xminlimit, xmaxlimit, yminlimit, ymaxlimit;
-   int win_x, win_y, low_contrast_offset;
 
    print2log("INITIAL MAP\n");
 
@@ -277,15 +310,76 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
    /* Initialize the Low Flow Map to FALSE (0). */
    memset(low_flow_map, 0, bsize * sizeof(int));
 
-   /* Allocate DFT directional power vectors */
-   if((ret = alloc_dir_powers(&powers, dftwaves->nwaves, dftgrids->ngrids))){
-      /* Free memory allocated to this point. */
+   /* Analyze each block in the image. */
+   if((ret = gen_initial_map_blocks(direction_map, low_contrast_map,
+                                    low_flow_map, blkoffs, bsize, mw,
+                                    pdata, pw, ph, dftwaves, dftgrids,
+                                    lfsparms))){
       free(direction_map);
       free(low_contrast_map);
       free(low_flow_map);
       return(ret);
    }
 
+   *odmap = direction_map;
+   *olcmap = low_contrast_map;
+   *olfmap = low_flow_map;
+   return(0);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: gen_initial_map_blocks - Runs the low contrast test and the DFT-based
+#cat:             direction analysis of gen_initial_maps() on a list of
+#cat:             blocks, storing the results in the corresponding entries
+#cat:             of the given maps.  Each block only depends on the pixels
+#cat:             under its rotated grids, so disjoint lists of blocks may
+#cat:             be analyzed at different times, such as when an image is
+#cat:             still being acquired.
+
+   Input:
+      direction_map    - Direction Map entries for the blocks, preset to
+                         INVALID
+      low_contrast_map - Low Contrast Map entries, preset to FALSE
+      low_flow_map     - Low Flow Map entries, preset to FALSE
+      blkoffs   - offsets to the pixel origin of each block in the padded image
+      nblocks   - number of blocks in the list
+      mw        - number of blocks horizontally in the padded input image
+      pdata     - padded input image data (8 bits [0..256) grayscale)
+      pw        - width (in pixels) of the padded input image
+      ph        - height (in pixels) of the padded input image
+      dftwaves  - structure containing the DFT wave forms
+      dftgrids  - structure containing the rotated pixel grid offsets
+      lfsparms  - parameters and thresholds for controlling LFS
+   Output:
+      direction_map    - valid directions for the analyzed blocks
+      low_contrast_map - blocks flagged as LOW CONTRAST
+      low_flow_map     - blocks flagged as LOW RIDGE FLOW
+   Return Code:
+      Zero     - successful completion
+      Negative - system error
+**************************************************************************/
+int gen_initial_map_blocks(int *direction_map, int *low_contrast_map,
+                int *low_flow_map, const int *blkoffs, const int nblocks,
+                const int mw, unsigned char *pdata, const int pw,
+                const int ph, const DFTWAVES *dftwaves,
+                const ROTGRIDS *dftgrids, const LFSPARMS *lfsparms)
+{
+   int bi, blkdir;
+   int *wis, *powmax_dirs;
+   double **powers, *powmaxs, *pownorms;
+   int nstats;
+   int ret; /* return code */
+   int dft_offset;
+   int xminlimit, xmaxlimit, yminlimit, ymaxlimit;
+   int win_x, win_y, low_contrast_offset;
+   WINHIST winhist;
+
+   /* Allocate DFT directional power vectors */
+   if((ret = alloc_dir_powers(&powers, dftwaves->nwaves, dftgrids->ngrids))){
+      return(ret);
+   }
+
    /* Allocate DFT power statistic arrays */
    /* Compute length of statistics arrays.  Statistics not needed   */
    /* for the first DFT wave, so the length is number of waves - 1. */
@@ -293,9 +387,6 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
    if((ret = alloc_power_stats(&wis, &powmaxs, &powmax_dirs,
                             &pownorms, nstats))){
       /* Free memory allocated to this point. */
-      free(direction_map);
-      free(low_contrast_map);
-      free(low_flow_map);
       free_dir_powers(powers, dftwaves->nwaves);
       return(ret);
    }
@@ -307,8 +398,12 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
    xmaxlimit = pw - dftgrids->pad - lfsparms->windowsize - 1;
    ymaxlimit = ph - dftgrids->pad - lfsparms->windowsize - 1;
 
-   /* Foreach block in image ... */
-   for(bi = 0; bi < bsize; bi++){
+   /* Windows of neighboring blocks overlap, so the contrast histogram */
+   /* is slid along each row of blocks rather than rebuilt.            */
+   init_winhist(&winhist, lfsparms->windowsize, lfsparms);
+
+   /* Foreach block in list ... */
+   for(bi = 0; bi < nblocks; bi++){
       /* Adjust block offset from pointing to block origin to pointing */
       /* to surrounding window origin.                                 */
       dft_offset = blkoffs[bi] - (lfsparms->windowoffset * pw) -
@@ -329,13 +424,10 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
       print2log("   BLOCK %2d (%2d, %2d) ", bi, bi%mw, bi/mw);
 
       /* If block is low contrast ... */
-      if((ret = low_contrast_block(low_contrast_offset, lfsparms->windowsize,
-                                  pdata, pw, ph, lfsparms))){
+      if((ret = low_contrast_window(&winhist, win_x, win_y,
+                                    pdata, pw, lfsparms))){
          /* If system error ... */
          if(ret < 0){
-            free(direction_map);
-            free(low_contrast_map);
-            free(low_flow_map);
             free_dir_powers(powers, dftwaves->nwaves);
             free(wis);
             free(powmaxs);
@@ -357,9 +449,6 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
          if((ret = dft_dir_powers(powers, pdata, low_contrast_offset, pw, ph,
                                dftwaves, dftgrids))){
             /* Free memory allocated to this point. */
-            free(direction_map);
-            free(low_contrast_map);
-            free(low_flow_map);
             free_dir_powers(powers, dftwaves->nwaves);
             free(wis);
             free(powmaxs);
@@ -374,9 +463,6 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
          if((ret = dft_power_stats(wis, powmaxs, powmax_dirs, pownorms, powers,
                                 1, dftwaves->nwaves, dftgrids->ngrids))){
             /* Free memory allocated to this point. */
-            free(direction_map);
-            free(low_contrast_map);
-            free(low_flow_map);
             free_dir_powers(powers, dftwaves->nwaves);
             free(wis);
             free(powmaxs);
@@ -426,9 +512,6 @@ int gen_initial_maps(int **odmap, int **olcmap, int **olfmap,
    free(powmax_dirs);
    free(pownorms);
 
-   *odmap = direction_map;
-   *olcmap = low_contrast_map;
-   *olfmap = low_flow_map;
    return(0);
 }
 
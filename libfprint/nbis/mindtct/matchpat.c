@@ -39,11 +39,19 @@ identified are necessarily the best available for the purpose.
                         match_3rd_pair()
                         skip_repeated_horizontal_pair()
                         skip_repeated_vertical_pair()
+                        next_unequal_pair()
+                        next_changed_pair()
 ***********************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 #include <lfs.h>
 
+/* Pixels compared at a time by next_unequal_pair() and */
+/* next_changed_pair(), as one 64-bit word.             */
+#define PAIR_LANES      8
+#define PAIR_ONES       0x0101010101010101ULL
+
 /*************************************************************************
 **************************************************************************
 #cat: match_1st_pair - Determines which of the feature_patterns[] have their
@@ -269,3 +277,84 @@ void skip_repeated_vertical_pair(int *cy, const int ey,
    }
 }
 
+/*************************************************************************
+**************************************************************************
+#cat: next_unequal_pair - Takes two adjacent scan lines (rows, or columns of
+#cat:            a transposed image) and finds the next position at which
+#cat:            their pixels differ.  Only such a pixel pair can be the
+#cat:            second pair of a feature, so the scan can step over all
+#cat:            the equal pairs before it.  The lines are compared
+#cat:            PAIR_LANES pixels at a time.
+
+   Input:
+      p1line - first scan line
+      p2line - second scan line
+      start  - position at which to start looking
+      end    - position one past the end of the scan lines
+   Return Code:
+      Position - of the first unequal pixel pair at or after start,
+                 or end if there is none
+*************************************************************************/
+int next_unequal_pair(const unsigned char *p1line,
+                   const unsigned char *p2line, const int start, const int end)
+{
+   int i;
+   unsigned long long w1, w2;
+
+   /* Skip whole words in which every pair is equal. */
+   for(i = start; i + PAIR_LANES <= end; i += PAIR_LANES){
+      memcpy(&w1, p1line + i, PAIR_LANES);
+      memcpy(&w2, p2line + i, PAIR_LANES);
+      if(w1 != w2)
+         break;
+   }
+   /* Locate the unequal pair within the word (or the tail). */
+   for(; i < end; i++){
+      if(p1line[i] != p2line[i])
+         return(i);
+   }
+   return(end);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: next_changed_pair - Takes two adjacent scan lines and finds the next
+#cat:            position at which the pixel pair is no longer the given
+#cat:            pair of values.  Equivalent to skip_repeated_horizontal_pair()
+#cat:            and skip_repeated_vertical_pair() on contiguous scan lines,
+#cat:            comparing PAIR_LANES pixels at a time.
+
+   Input:
+      p1line - first scan line
+      p2line - second scan line
+      start  - position at which to start looking
+      end    - position one past the end of the scan lines
+      v1     - repeated value in the first scan line
+      v2     - repeated value in the second scan line
+   Return Code:
+      Position - of the first pixel pair at or after start that differs
+                 from (v1, v2), or end if there is none
+*************************************************************************/
+int next_changed_pair(const unsigned char *p1line,
+                   const unsigned char *p2line, const int start, const int end,
+                   const unsigned char v1, const unsigned char v2)
+{
+   int i;
+   unsigned long long w1, w2, r1, r2;
+
+   /* Repeat the pair values across a word. */
+   r1 = v1 * PAIR_ONES;
+   r2 = v2 * PAIR_ONES;
+
+   for(i = start; i + PAIR_LANES <= end; i += PAIR_LANES){
+      memcpy(&w1, p1line + i, PAIR_LANES);
+      memcpy(&w2, p2line + i, PAIR_LANES);
+      if((w1 ^ r1) | (w2 ^ r2))
+         break;
+   }
+   for(; i < end; i++){
+      if((p1line[i] != v1) || (p2line[i] != v2))
+         return(i);
+   }
+   return(end);
+}
@@ -35,6 +35,7 @@ identified are necessarily the best available for the purpose.
 
 ***********************************************************************
                ROUTINES:
+                        link_minutiae()
                         alloc_minutiae()
                         realloc_minutiae()
                         detect_minutiae_V2()
@@ -46,9 +47,8 @@ identified are necessarily the best available for the purpose.
                         dump_minutiae()
                         dump_minutiae_pts()
                         dump_reliable_minutiae_pts()
-                        create_minutia()
+                        init_minutia()
                         free_minutiae()
-                        free_minutia()
                         remove_minutia()
                         join_minutia()
                         minutia_type()
@@ -79,14 +79,33 @@ identified are necessarily the best available for the purpose.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <lfs.h>
 
+/*************************************************************************
+**************************************************************************
+#cat: link_minutiae - Points each entry of a minutiae list's pointer view
+#cat:            at the matching entry of its contiguous minutia storage.
+
+   Input:
+      minutiae - list of minutiae with items allocated
+   Output:
+      minutiae - list with list[i] == &items[i] for every allocated entry
+**************************************************************************/
+static void link_minutiae(MINUTIAE *minutiae)
+{
+   int i;
 
+   for(i = 0; i < minutiae->alloc; i++)
+      minutiae->list[i] = minutiae->items + i;
+}
 
 /*************************************************************************
 **************************************************************************
 #cat: alloc_minutiae - Allocates and initializes a minutia list based on the
 #cat:            specified maximum number of minutiae to be detected.
+#cat:            The minutiae are stored contiguously in items[], and
+#cat:            list[] is a pointer view of that storage.
 
    Input:
       max_minutiae - number of minutia to be allocated in list
@@ -110,9 +129,16 @@ int alloc_minutiae(MINUTIAE **ominutiae, const int max_minutiae)
       fprintf(stderr, "ERROR : alloc_minutiae : malloc : minutiae->list\n");
       exit(-431);
    }
+   minutiae->items = (MINUTIA *)malloc(max_minutiae * sizeof(MINUTIA));
+   if(minutiae->items == (MINUTIA *)NULL){
+      fprintf(stderr, "ERROR : alloc_minutiae : malloc : minutiae->items\n");
+      exit(-433);
+   }
 
    minutiae->alloc = max_minutiae;
    minutiae->num = 0;
+   minutiae->nbr_store = (int *)NULL;
+   link_minutiae(minutiae);
 
    *ominutiae = minutiae;
    return(0);
@@ -142,6 +168,14 @@ int realloc_minutiae(MINUTIAE *minutiae, const int incr_minutiae)
       fprintf(stderr, "ERROR : realloc_minutiae : realloc : minutiae->list\n");
       exit(-432);
    }
+   minutiae->items = (MINUTIA *)realloc(minutiae->items,
+                                     minutiae->alloc * sizeof(MINUTIA));
+   if(minutiae->items == (MINUTIA *)NULL){
+      fprintf(stderr, "ERROR : realloc_minutiae : realloc : minutiae->items\n");
+      exit(-434);
+   }
+   /* The storage may have moved, so repoint the whole view. */
+   link_minutiae(minutiae);
 
    return(0);
 }
@@ -229,7 +263,8 @@ int detect_minutiae_V2(MINUTIAE *minutiae,
 #cat:                the list.
 
    Input:
-      minutia   - minutia structure for detected point
+      minutia   - minutia structure for detected point (copied into
+                  the list, so the caller's structure may live anywhere)
       bdata     - binary image data (0==while & 1==black)
       iw        - width (in pixels) of image
       ih        - height (in pixels) of image
@@ -333,8 +368,8 @@ int update_minutiae(MINUTIAE *minutiae, MINUTIA *minutia,
       } /* End FOR minutia in list. */
    } /* Otherwise, minutiae list is empty. */
 
-   /* Otherwise, assume new minutia is not in the list, so add it. */
-   minutiae->list[minutiae->num] = minutia;
+   /* Otherwise, assume new minutia is not in the list, so copy it in. */
+   minutiae->items[minutiae->num] = *minutia;
    (minutiae->num)++;
 
    /* New minutia was successfully added to the list. */
@@ -350,7 +385,8 @@ int update_minutiae(MINUTIAE *minutiae, MINUTIA *minutia,
 #cat:                it to the list.
 
    Input:
-      minutia   - minutia structure for detected point
+      minutia   - minutia structure for detected point (copied into
+                  the list, so the caller's structure may live anywhere)
       scan_dir  - orientation of scan when minutia was detected
       dmapval   - directional ridge flow of block minutia is in
       bdata     - binary image data (0==while & 1==black)
@@ -477,8 +513,8 @@ int update_minutiae_V2(MINUTIAE *minutiae, MINUTIA *minutia,
    } /* Otherwise, minutiae list is empty. */
 
    /* Otherwise, assume new minutia is not in the list, or those that */
-   /* were close neighbors were selectively removed, so add it.       */
-   minutiae->list[minutiae->num] = minutia;
+   /* were close neighbors were selectively removed, so copy it in.   */
+   minutiae->items[minutiae->num] = *minutia;
    (minutiae->num)++;
 
    /* New minutia was successfully added to the list. */
@@ -505,7 +541,7 @@ int sort_minutiae_y_x(MINUTIAE *minutiae, const int iw, const int ih)
 {
    int *ranks, *order;
    int i, ret;
-   MINUTIA **newlist;
+   MINUTIA *newitems;
 
    /* Allocate a list of integers to hold 1-D image pixel offsets */
    /* for each of the 2-D minutia coordinate points.               */
@@ -525,23 +561,24 @@ int sort_minutiae_y_x(MINUTIAE *minutiae, const int iw, const int ih)
       return(ret);
    }
 
-   /* Allocate new MINUTIA list to hold sorted minutiae. */
-   newlist = (MINUTIA **)malloc(minutiae->num * sizeof(MINUTIA *));
-   if(newlist == (MINUTIA **)NULL){
+   /* Allocate new MINUTIA storage to hold sorted minutiae. */
+   newitems = (MINUTIA *)malloc(minutiae->alloc * sizeof(MINUTIA));
+   if(newitems == (MINUTIA *)NULL){
       free(ranks);
       free(order);
-      fprintf(stderr, "ERROR : sort_minutiae_y_x : malloc : newlist\n");
+      fprintf(stderr, "ERROR : sort_minutiae_y_x : malloc : newitems\n");
       return(-311);
    }
 
-   /* Put minutia into sorted order in new list. */
+   /* Put minutia into sorted order in new storage. */
    for(i = 0; i < minutiae->num; i++)
-      newlist[i] = minutiae->list[order[i]];
+      newitems[i] = minutiae->items[order[i]];
 
-   /* Deallocate non-sorted list of minutia pointers. */
-   free(minutiae->list);
-   /* Assign new sorted list of minutia to minutiae list. */
-   minutiae->list = newlist;
+   /* Deallocate non-sorted minutia storage. */
+   free(minutiae->items);
+   /* Assign new sorted storage and repoint the list at it. */
+   minutiae->items = newitems;
+   link_minutiae(minutiae);
 
    /* Free the working memories supporting the sort. */
    free(order);
@@ -570,7 +607,7 @@ int sort_minutiae_x_y(MINUTIAE *minutiae, const int iw, const int ih)
 {
    int *ranks, *order;
    int i, ret;
-   MINUTIA **newlist;
+   MINUTIA *newitems;
 
    /* Allocate a list of integers to hold 1-D image pixel offsets */
    /* for each of the 2-D minutia coordinate points.               */
@@ -590,23 +627,24 @@ int sort_minutiae_x_y(MINUTIAE *minutiae, const int iw, const int ih)
       return(ret);
    }
 
-   /* Allocate new MINUTIA list to hold sorted minutiae. */
-   newlist = (MINUTIA **)malloc(minutiae->num * sizeof(MINUTIA *));
-   if(newlist == (MINUTIA **)NULL){
+   /* Allocate new MINUTIA storage to hold sorted minutiae. */
+   newitems = (MINUTIA *)malloc(minutiae->alloc * sizeof(MINUTIA));
+   if(newitems == (MINUTIA *)NULL){
       free(ranks);
       free(order);
-      fprintf(stderr, "ERROR : sort_minutiae_x_y : malloc : newlist\n");
+      fprintf(stderr, "ERROR : sort_minutiae_x_y : malloc : newitems\n");
       return(-441);
    }
 
-   /* Put minutia into sorted order in new list. */
+   /* Put minutia into sorted order in new storage. */
    for(i = 0; i < minutiae->num; i++)
-      newlist[i] = minutiae->list[order[i]];
+      newitems[i] = minutiae->items[order[i]];
 
-   /* Deallocate non-sorted list of minutia pointers. */
-   free(minutiae->list);
-   /* Assign new sorted list of minutia to minutiae list. */
-   minutiae->list = newlist;
+   /* Deallocate non-sorted minutia storage. */
+   free(minutiae->items);
+   /* Assign new sorted storage and repoint the list at it. */
+   minutiae->items = newitems;
+   link_minutiae(minutiae);
 
    /* Free the working memories supporting the sort. */
    free(order);
@@ -770,8 +808,8 @@ void dump_reliable_minutiae_pts(FILE *fpout, const MINUTIAE *minutiae,
 
 /*************************************************************************
 **************************************************************************
-#cat: create_minutia - Takes attributes associated with a detected minutia
-#cat:            point and allocates and initializes a minutia structure.
+#cat: init_minutia - Takes attributes associated with a detected minutia
+#cat:            point and initializes a minutia structure with them.
 
    Input:
       x_loc   - x-pixel coord of minutia (interior to feature)
@@ -784,26 +822,13 @@ void dump_reliable_minutiae_pts(FILE *fpout, const MINUTIAE *minutiae,
       appearing  - designates the minutia as appearing or disappearing
       feature_id - index of minutia's matching feature_patterns[]
    Output:
-      ominutia - ponter to an allocated and initialized minutia structure
-   Return Code:
-      Zero       - minutia structure successfully allocated and initialized
-      Negative   - system error
+      minutia - initialized minutia structure
 *************************************************************************/
-int create_minutia(MINUTIA **ominutia, const int x_loc, const int y_loc,
-                   const int x_edge, const int y_edge, const int idir,
-                   const double reliability,
-                   const int type, const int appearing, const int feature_id)
+void init_minutia(MINUTIA *minutia, const int x_loc, const int y_loc,
+                  const int x_edge, const int y_edge, const int idir,
+                  const double reliability,
+                  const int type, const int appearing, const int feature_id)
 {
-   MINUTIA *minutia;
-
-   /* Allocate a minutia structure. */
-   minutia = (MINUTIA *)malloc(sizeof(MINUTIA));
-   /* If allocation error... */
-   if(minutia == (MINUTIA *)NULL){
-      fprintf(stderr, "ERROR : create_minutia : malloc : minutia\n");
-      return(-230);
-   }
-
    /* Assign minutia structure attributes. */
    minutia->x = x_loc;
    minutia->y = y_loc;
@@ -817,11 +842,6 @@ int create_minutia(MINUTIA **ominutia, const int x_loc, const int y_loc,
    minutia->nbrs = (int *)NULL;
    minutia->ridge_counts = (int *)NULL;
    minutia->num_nbrs = 0;
-
-   /* Set minutia object to output pointer. */
-   *ominutia = minutia;
-   /* Return normally. */
-   return(0);
 }
 
 /*************************************************************************
@@ -834,38 +854,17 @@ int create_minutia(MINUTIA **ominutia, const int x_loc, const int y_loc,
 *************************************************************************/
 void free_minutiae(MINUTIAE *minutiae)
 {
-   int i;
-
-   /* Deallocate minutia structures in the list. */
-   for(i = 0; i < minutiae->num; i++)
-      free_minutia(minutiae->list[i]);
-   /* Deallocate list of minutia pointers. */
+   /* Deallocate the minutia storage and its pointer view. */
+   free(minutiae->items);
    free(minutiae->list);
+   /* Deallocate the neighbor lists, if ridges were counted. */
+   if(minutiae->nbr_store != (int *)NULL)
+      free(minutiae->nbr_store);
 
    /* Deallocate the list structure. */
    free(minutiae);
 }
 
-/*************************************************************************
-**************************************************************************
-#cat: free_minutia - Takes a minutia pointer and deallocates all memory
-#cat:            associated with it.
-
-   Input:
-      minutia - pointer to allocated minutia structure
-*************************************************************************/
-void free_minutia(MINUTIA *minutia)
-{
-   /* Deallocate sublists. */
-   if(minutia->nbrs != (int *)NULL)
-      free(minutia->nbrs);
-   if(minutia->ridge_counts != (int *)NULL)
-      free(minutia->ridge_counts);
-
-   /* Deallocate the minutia structure. */
-   free(minutia);
-}
-
 /*************************************************************************
 **************************************************************************
 #cat: remove_minutia - Removes the specified minutia point from the input
@@ -882,21 +881,17 @@ void free_minutia(MINUTIA *minutia)
 **************************************************************************/
 int remove_minutia(const int index, MINUTIAE *minutiae)
 {
-   int fr, to;
-
    /* Make sure the requested index is within range. */
    if((index < 0) && (index >= minutiae->num)){
       fprintf(stderr, "ERROR : remove_minutia : index out of range\n");
       return(-380);
    }
 
-   /* Deallocate the minutia structure to be removed. */
-   free_minutia(minutiae->list[index]);
-
-   /* Slide the remaining list of minutiae up over top of the */
-   /* position of the minutia being removed.                 */
-   for(to = index, fr = index+1; fr < minutiae->num; to++, fr++)
-      minutiae->list[to] = minutiae->list[fr];
+   /* Slide the remaining minutiae up over top of the position of */
+   /* the minutia being removed.  The pointer view is unchanged,  */
+   /* as list[i] keeps pointing at the i-th stored minutia.       */
+   memmove(minutiae->items + index, minutiae->items + index + 1,
+           (minutiae->num - index - 1) * sizeof(MINUTIA));
 
    /* Decrement the number of minutiae remaining in the list. */
    minutiae->num--;
@@ -1379,6 +1374,10 @@ int scan4minutiae_horizontally(MINUTIAE *minutiae,
 #cat:                horizontally, detecting potential minutiae points.
 #cat:                Minutia detected via the horizontal scan process are
 #cat:                by nature vertically oriented (orthogonal to the scan).
+#cat:                Runs of equal pixel pairs, which can never be a
+#cat:                feature's second pair, are stepped over a word at a
+#cat:                time; the feature patterns are only matched around the
+#cat:                remaining pairs.
 
    Input:
       bdata     - binary image data (0==while & 1==black)
@@ -1400,7 +1399,7 @@ int scan4minutiae_horizontally_V2(MINUTIAE *minutiae,
                 const LFSPARMS *lfsparms)
 {
    int sx, sy, ex, ey, cx, cy, x2;
-   unsigned char *p1ptr, *p2ptr;
+   unsigned char *p1line, *p2line;
    int possible[NFEATURES], nposs;
    int ret;
 
@@ -1414,72 +1413,74 @@ int scan4minutiae_horizontally_V2(MINUTIAE *minutiae,
    cy = sy;
    /* While second scan row not outside the bottom of the scan region... */
    while(cy+1 < ey){
+      /* Set the current and next scan rows. */
+      p1line = bdata+(cy*iw);
+      p2line = p1line+iw;
       /* Start at beginning of new scan row in region. */
       cx = sx;
       /* While not at end of region's current scan row. */
       while(cx < ex){
-         /* Get pixel pair from current x position in current and next */
-         /* scan rows. */
-         p1ptr = bdata+(cy*iw)+cx;
-         p2ptr = bdata+((cy+1)*iw)+cx;
+         /* A scan pixel pair can only match a second feature pair if  */
+         /* its pixels differ.  Until then, each step just moves on to */
+         /* the next pair, so skip to the one before the next pair     */
+         /* whose pixels differ, or finish the row if there is none.   */
+         cx = next_unequal_pair(p1line, p2line, cx+1, ex) - 1;
+         if(cx+1 >= ex)
+            break;
+
          /* If scan pixel pair matches first pixel pair of */
          /* 1 or more features... */
-         if(match_1st_pair(*p1ptr, *p2ptr, possible, &nposs)){
-            /* Bump forward to next scan pixel pair. */
+         if(match_1st_pair(p1line[cx], p2line[cx], possible, &nposs)){
+            /* Bump forward to next scan pixel pair (known to exist). */
             cx++;
-            p1ptr++;
-            p2ptr++;
-            /* If not at end of region's current scan row... */
-            if(cx < ex){
-               /* If scan pixel pair matches second pixel pair of */
-               /* 1 or more features... */
-               if(match_2nd_pair(*p1ptr, *p2ptr, possible, &nposs)){
-                  /* Store current x location. */
-                  x2 = cx;
-                  /* Skip repeated pixel pairs. */
-                  skip_repeated_horizontal_pair(&cx, ex, &p1ptr, &p2ptr,
-                                                    iw, ih);
-                  /* If not at end of region's current scan row... */
-                  if(cx < ex){
-                     /* If scan pixel pair matches third pixel pair of */
-                     /* a single feature... */
-                     if(match_3rd_pair(*p1ptr, *p2ptr, possible, &nposs)){
-                        /* Process detected minutia point. */
-                        if((ret = process_horizontal_scan_minutia_V2(minutiae,
-                                         cx, cy, x2, possible[0],
-                                         bdata, iw, ih, pdirection_map,
-                                         plow_flow_map, phigh_curve_map,
-                                         lfsparms))){
-                           /* Return code may be:                       */
-                           /* 1.  ret< 0 (implying system error)        */
-                           /* 2. ret==IGNORE (ignore current feature)   */
-                           if(ret < 0)
-                              return(ret);
-                           /* Otherwise, IGNORE and continue. */
-                        }
+            /* If scan pixel pair matches second pixel pair of */
+            /* 1 or more features... */
+            if(match_2nd_pair(p1line[cx], p2line[cx], possible, &nposs)){
+               /* Store current x location. */
+               x2 = cx;
+               /* Skip repeated pixel pairs. */
+               cx = next_changed_pair(p1line, p2line, cx+1, ex,
+                                      p1line[cx], p2line[cx]);
+               /* If not at end of region's current scan row... */
+               if(cx < ex){
+                  /* If scan pixel pair matches third pixel pair of */
+                  /* a single feature... */
+                  if(match_3rd_pair(p1line[cx], p2line[cx],
+                                    possible, &nposs)){
+                     /* Process detected minutia point. */
+                     if((ret = process_horizontal_scan_minutia_V2(minutiae,
+                                      cx, cy, x2, possible[0],
+                                      bdata, iw, ih, pdirection_map,
+                                      plow_flow_map, phigh_curve_map,
+                                      lfsparms))){
+                        /* Return code may be:                       */
+                        /* 1.  ret< 0 (implying system error)        */
+                        /* 2. ret==IGNORE (ignore current feature)   */
+                        if(ret < 0)
+                           return(ret);
+                        /* Otherwise, IGNORE and continue. */
                      }
-
-                     /* Set up to resume scan. */
-                     /* Test to see if 3rd pair can slide into 2nd pair. */
-                     /* The values of the 2nd pair MUST be different.    */
-                     /* If 3rd pair values are different ... */
-                     if(*p1ptr != *p2ptr){
-                        /* Set next first pair to last of repeated */
-                        /* 2nd pairs, ie. back up one pair.        */
-                        cx--;
-                     }
-
-                     /* Otherwise, 3rd pair can't be a 2nd pair, so  */
-                     /* keep pointing to 3rd pair so that it is used */
-                     /* in the next first pair test.                 */
-
-                  } /* Else, at end of current scan row. */
-               }
-
-               /* Otherwise, 2nd pair failed, so keep pointing to it */
-               /* so that it is used in the next first pair test.    */
-
-            } /* Else, at end of current scan row. */
+                  }
+
+                  /* Set up to resume scan. */
+                  /* Test to see if 3rd pair can slide into 2nd pair. */
+                  /* The values of the 2nd pair MUST be different.    */
+                  /* If 3rd pair values are different ... */
+                  if(p1line[cx] != p2line[cx]){
+                     /* Set next first pair to last of repeated */
+                     /* 2nd pairs, ie. back up one pair.        */
+                     cx--;
+                  }
+
+                  /* Otherwise, 3rd pair can't be a 2nd pair, so  */
+                  /* keep pointing to 3rd pair so that it is used */
+                  /* in the next first pair test.                 */
+
+               } /* Else, at end of current scan row. */
+            }
+
+            /* Otherwise, 2nd pair failed, so keep pointing to it */
+            /* so that it is used in the next first pair test.    */
          }
          /* Otherwise, 1st pair failed... */
          else{
@@ -1640,6 +1641,9 @@ int scan4minutiae_vertically(MINUTIAE *minutiae,
 #cat:                vertically, detecting potential minutiae points.
 #cat:                Minutia detected via the vetical scan process are
 #cat:                by nature horizontally oriented (orthogonal to  the scan).
+#cat:                The columns are scanned as rows of a transposed copy of
+#cat:                the image, so that runs of equal pixel pairs can be
+#cat:                stepped over a word at a time as in the horizontal scan.
 
    Input:
       bdata     - binary image data (0==while & 1==black)
@@ -1661,10 +1665,14 @@ int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
                 const LFSPARMS *lfsparms)
 {
    int sx, sy, ex, ey, cx, cy, y2;
-   unsigned char *p1ptr, *p2ptr;
+   unsigned char *tdata, *p1line, *p2line;
    int possible[NFEATURES], nposs;
    int ret;
 
+   /* Transpose the image so that each column is a contiguous line. */
+   if((ret = transpose_uchar_image(&tdata, bdata, iw, ih)))
+      return(ret);
+
    /* Set scan region to entire image. */
    sx = 0;
    ex = iw;
@@ -1675,72 +1683,74 @@ int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
    cx = sx;
    /* While second scan column not outside the right of the region ... */
    while(cx+1 < ex){
+      /* Set the current and next scan columns. */
+      p1line = tdata+(cx*ih);
+      p2line = p1line+ih;
       /* Start at beginning of new scan column in region. */
       cy = sy;
       /* While not at end of region's current scan column. */
       while(cy < ey){
-         /* Get pixel pair from current y position in current and next */
-         /* scan columns. */
-         p1ptr = bdata+(cy*iw)+cx;
-         p2ptr = p1ptr+1;
+         /* Skip to the pair before the next pair whose pixels differ, */
+         /* as in scan4minutiae_horizontally_V2().                     */
+         cy = next_unequal_pair(p1line, p2line, cy+1, ey) - 1;
+         if(cy+1 >= ey)
+            break;
+
          /* If scan pixel pair matches first pixel pair of */
          /* 1 or more features... */
-         if(match_1st_pair(*p1ptr, *p2ptr, possible, &nposs)){
-            /* Bump forward to next scan pixel pair. */
+         if(match_1st_pair(p1line[cy], p2line[cy], possible, &nposs)){
+            /* Bump forward to next scan pixel pair (known to exist). */
             cy++;
-            p1ptr+=iw;
-            p2ptr+=iw;
-            /* If not at end of region's current scan column... */
-            if(cy < ey){
-               /* If scan pixel pair matches second pixel pair of */
-               /* 1 or more features... */
-               if(match_2nd_pair(*p1ptr, *p2ptr, possible, &nposs)){
-                  /* Store current y location. */
-                  y2 = cy;
-                  /* Skip repeated pixel pairs. */
-                  skip_repeated_vertical_pair(&cy, ey, &p1ptr, &p2ptr,
-                                                  iw, ih);
-                  /* If not at end of region's current scan column... */
-                  if(cy < ey){
-                     /* If scan pixel pair matches third pixel pair of */
-                     /* a single feature... */
-                     if(match_3rd_pair(*p1ptr, *p2ptr, possible, &nposs)){
-                        /* Process detected minutia point. */
-                        if((ret = process_vertical_scan_minutia_V2(minutiae,
-                                         cx, cy, y2, possible[0],
-                                         bdata, iw, ih, pdirection_map,
-                                         plow_flow_map, phigh_curve_map,
-                                         lfsparms))){
-                           /* Return code may be:                       */
-                           /* 1.  ret< 0 (implying system error)        */
-                           /* 2. ret==IGNORE (ignore current feature)   */
-                           if(ret < 0)
-                              return(ret);
-                           /* Otherwise, IGNORE and continue. */
+            /* If scan pixel pair matches second pixel pair of */
+            /* 1 or more features... */
+            if(match_2nd_pair(p1line[cy], p2line[cy], possible, &nposs)){
+               /* Store current y location. */
+               y2 = cy;
+               /* Skip repeated pixel pairs. */
+               cy = next_changed_pair(p1line, p2line, cy+1, ey,
+                                      p1line[cy], p2line[cy]);
+               /* If not at end of region's current scan column... */
+               if(cy < ey){
+                  /* If scan pixel pair matches third pixel pair of */
+                  /* a single feature... */
+                  if(match_3rd_pair(p1line[cy], p2line[cy],
+                                    possible, &nposs)){
+                     /* Process detected minutia point. */
+                     if((ret = process_vertical_scan_minutia_V2(minutiae,
+                                      cx, cy, y2, possible[0],
+                                      bdata, iw, ih, pdirection_map,
+                                      plow_flow_map, phigh_curve_map,
+                                      lfsparms))){
+                        /* Return code may be:                       */
+                        /* 1.  ret< 0 (implying system error)        */
+                        /* 2. ret==IGNORE (ignore current feature)   */
+                        if(ret < 0){
+                           free(tdata);
+                           return(ret);
                         }
+                        /* Otherwise, IGNORE and continue. */
                      }
-
-                     /* Set up to resume scan. */
-                     /* Test to see if 3rd pair can slide into 2nd pair. */
-                     /* The values of the 2nd pair MUST be different.    */
-                     /* If 3rd pair values are different ... */
-                     if(*p1ptr != *p2ptr){
-                        /* Set next first pair to last of repeated */
-                        /* 2nd pairs, ie. back up one pair.        */
-                        cy--;
-                     }
-
-                     /* Otherwise, 3rd pair can't be a 2nd pair, so  */
-                     /* keep pointing to 3rd pair so that it is used */
-                     /* in the next first pair test.                 */
-
-                  } /* Else, at end of current scan row. */
-               }
-
-               /* Otherwise, 2nd pair failed, so keep pointing to it */
-               /* so that it is used in the next first pair test.    */
-
-            } /* Else, at end of current scan column. */
+                  }
+
+                  /* Set up to resume scan. */
+                  /* Test to see if 3rd pair can slide into 2nd pair. */
+                  /* The values of the 2nd pair MUST be different.    */
+                  /* If 3rd pair values are different ... */
+                  if(p1line[cy] != p2line[cy]){
+                     /* Set next first pair to last of repeated */
+                     /* 2nd pairs, ie. back up one pair.        */
+                     cy--;
+                  }
+
+                  /* Otherwise, 3rd pair can't be a 2nd pair, so  */
+                  /* keep pointing to 3rd pair so that it is used */
+                  /* in the next first pair test.                 */
+
+               } /* Else, at end of current scan column. */
+            }
+
+            /* Otherwise, 2nd pair failed, so keep pointing to it */
+            /* so that it is used in the next first pair test.    */
          }
          /* Otherwise, 1st pair failed... */
          else{
@@ -1752,6 +1762,8 @@ int scan4minutiae_vertically_V2(MINUTIAE *minutiae,
       cx++;
    } /* While not out of scan columns. */
 
+   free(tdata);
+
    /* Return normally. */
    return(0);
 }
@@ -2505,7 +2517,7 @@ int process_horizontal_scan_minutia(MINUTIAE *minutiae,
                     const int imapval, const int nmapval,
                     const LFSPARMS *lfsparms)
 {
-   MINUTIA *minutia;
+   MINUTIA minutia;
    int x_loc, y_loc;
    int x_edge, y_edge;
    int idir, ret;
@@ -2555,20 +2567,13 @@ int process_horizontal_scan_minutia(MINUTIAE *minutiae,
    }
 
    /* Create a minutia object based on derived attributes. */
-   if((ret = create_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
-                     DEFAULT_RELIABILITY,
-                     feature_patterns[feature_id].type,
-                     feature_patterns[feature_id].appearing, feature_id)))
-      /* Return system error. */
-      return(ret);
+   init_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
+                DEFAULT_RELIABILITY,
+                feature_patterns[feature_id].type,
+                feature_patterns[feature_id].appearing, feature_id);
 
    /* Update the minutiae list with potential new minutia. */
-   ret = update_minutiae(minutiae, minutia, bdata, iw, ih, lfsparms);
-
-   /* If minuitia IGNORED and not added to the minutia list ... */
-   if(ret == IGNORE)
-      /* Deallocate the minutia. */
-      free_minutia(minutia);
+   ret = update_minutiae(minutiae, &minutia, bdata, iw, ih, lfsparms);
 
    /* Otherwise, return normally. */
    return(0);
@@ -2609,7 +2614,7 @@ int process_horizontal_scan_minutia_V2(MINUTIAE *minutiae,
                  int *pdirection_map, int *plow_flow_map, int *phigh_curve_map,
                  const LFSPARMS *lfsparms)
 {
-   MINUTIA *minutia;
+   MINUTIA minutia;
    int x_loc, y_loc;
    int x_edge, y_edge;
    int idir, ret;
@@ -2678,22 +2683,15 @@ int process_horizontal_scan_minutia_V2(MINUTIAE *minutiae,
       reliability = HIGH_RELIABILITY;
 
    /* Create a minutia object based on derived attributes. */
-   if((ret = create_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
-                     reliability,
-                     feature_patterns[feature_id].type,
-                     feature_patterns[feature_id].appearing, feature_id)))
-      /* Return system error. */
-      return(ret);
+   init_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
+                reliability,
+                feature_patterns[feature_id].type,
+                feature_patterns[feature_id].appearing, feature_id);
 
    /* Update the minutiae list with potential new minutia. */
-   ret = update_minutiae_V2(minutiae, minutia, SCAN_HORIZONTAL,
+   ret = update_minutiae_V2(minutiae, &minutia, SCAN_HORIZONTAL,
                             dmapval, bdata, iw, ih, lfsparms);
 
-   /* If minuitia IGNORED and not added to the minutia list ... */
-   if(ret == IGNORE)
-      /* Deallocate the minutia. */
-      free_minutia(minutia);
-
    /* Otherwise, return normally. */
    return(0);
 }
@@ -2732,7 +2730,7 @@ int process_vertical_scan_minutia(MINUTIAE *minutiae,
                     const int imapval, const int nmapval,
                     const LFSPARMS *lfsparms)
 {
-   MINUTIA *minutia;
+   MINUTIA minutia;
    int x_loc, y_loc;
    int x_edge, y_edge;
    int idir, ret;
@@ -2781,20 +2779,13 @@ int process_vertical_scan_minutia(MINUTIAE *minutiae,
    }
 
    /* Create a minutia object based on derived attributes. */
-   if((ret = create_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
-                     DEFAULT_RELIABILITY,
-                     feature_patterns[feature_id].type,
-                     feature_patterns[feature_id].appearing, feature_id)))
-      /* Return system error. */
-      return(ret);
+   init_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
+                DEFAULT_RELIABILITY,
+                feature_patterns[feature_id].type,
+                feature_patterns[feature_id].appearing, feature_id);
 
    /* Update the minutiae list with potential new minutia. */
-   ret = update_minutiae(minutiae, minutia, bdata, iw, ih, lfsparms);
-
-   /* If minuitia IGNORED and not added to the minutia list ... */
-   if(ret == IGNORE)
-      /* Deallocate the minutia. */
-      free_minutia(minutia);
+   ret = update_minutiae(minutiae, &minutia, bdata, iw, ih, lfsparms);
 
    /* Otherwise, return normally. */
    return(0);
@@ -2835,7 +2826,7 @@ int process_vertical_scan_minutia_V2(MINUTIAE *minutiae,
                  int *pdirection_map, int *plow_flow_map, int *phigh_curve_map,
                  const LFSPARMS *lfsparms)
 {
-   MINUTIA *minutia;
+   MINUTIA minutia;
    int x_loc, y_loc;
    int x_edge, y_edge;
    int idir, ret;
@@ -2903,22 +2894,15 @@ int process_vertical_scan_minutia_V2(MINUTIAE *minutiae,
       reliability = HIGH_RELIABILITY;
 
    /* Create a minutia object based on derived attributes. */
-   if((ret = create_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
-                     reliability,
-                     feature_patterns[feature_id].type,
-                     feature_patterns[feature_id].appearing, feature_id)))
-      /* Return system error. */
-      return(ret);
+   init_minutia(&minutia, x_loc, y_loc, x_edge, y_edge, idir,
+                reliability,
+                feature_patterns[feature_id].type,
+                feature_patterns[feature_id].appearing, feature_id);
 
    /* Update the minutiae list with potential new minutia. */
-   ret = update_minutiae_V2(minutiae, minutia, SCAN_VERTICAL,
+   ret = update_minutiae_V2(minutiae, &minutia, SCAN_VERTICAL,
                             dmapval, bdata, iw, ih, lfsparms);
 
-   /* If minuitia IGNORED and not added to the minutia list ... */
-   if(ret == IGNORE)
-      /* Deallocate the minutia. */
-      free_minutia(minutia);
-
    /* Otherwise, return normally. */
    return(0);
 }
@@ -39,15 +39,11 @@ identified are necessarily the best available for the purpose.
                ROUTINES:
                         erode_charimage_2()
                         dilate_charimage_2()
-                        get_south8_2()
-                        get_north8_2()
-                        get_east8_2()
-                        get_west8_2()
 
 ***********************************************************************/
 
-#include <morph.h>
 #include <string.h>
+#include <morph.h>
 
 /*************************************************************************
 **************************************************************************
@@ -56,6 +52,7 @@ identified are necessarily the best available for the purpose.
 #cat:             output image is the responsibility of the caller.  The
 #cat:             input image remains unchanged.  This routine will NOT
 #cat:             erode pixels indiscriminately along the image border.
+#cat:             Interior pixels are eroded MORPH_LANES at a time.
 
    Input:
       inp       - input 8-bit image to be eroded
@@ -68,26 +65,40 @@ void erode_charimage_2(unsigned char *inp, unsigned char *out,
                      const int iw, const int ih)
 {
    int row, col;
-   unsigned char *itr = inp, *otr = out;
- 
-   memcpy(out, inp, iw*ih);
- 
-   /* for true pixels. kill pixel if there is at least one false neighbor */
-   for ( row = 0 ; row < ih ; row++ )
-      for ( col = 0 ; col < iw ; col++ )
-      {  
-         if (*itr)      /* erode only operates on true pixels */
-         {
-            /* more efficient with C's left to right evaluation of     */
-            /* conjuctions. E N S functions not executed if W is false */
-            if (!(get_west8_2 ((char *)itr, col        , 1 ) &&
-                  get_east8_2 ((char *)itr, col, iw    , 1 ) &&
-                  get_north8_2((char *)itr, row, iw    , 1 ) &&
-                  get_south8_2((char *)itr, row, iw, ih, 1)))
-               *otr = 0;
-         }
-         itr++ ; otr++;
-      }  
+   unsigned char *itr, *otr, *nptr, *sptr;
+   unsigned long long c, w, e, n, s;
+
+   for(row = 0; row < ih; row++){
+      itr = inp + (row * iw);
+      otr = out + (row * iw);
+      /* A neighbor off the edge of the image is replaced by the pixel */
+      /* itself.  A true pixel then counts it as true, so border pixels */
+      /* are not eroded indiscriminately, just as before.              */
+      nptr = (row > 0) ? itr - iw : itr;
+      sptr = (row < ih-1) ? itr + iw : itr;
+
+      /* Interior columns, a word at a time. */
+      for(col = 1; col + MORPH_LANES < iw; col += MORPH_LANES){
+         MORPH_LOAD(c, itr + col);
+         MORPH_LOAD(w, itr + col - 1);
+         MORPH_LOAD(e, itr + col + 1);
+         MORPH_LOAD(n, nptr + col);
+         MORPH_LOAD(s, sptr + col);
+         c &= MORPH_NZ(w) & MORPH_NZ(e) & MORPH_NZ(n) & MORPH_NZ(s);
+         MORPH_STORE(otr + col, c);
+      }
+
+      /* Remaining columns, one at a time, then the first column. */
+      for(; col < iw; col++){
+         e = (col < iw-1) ? itr[col+1] : itr[col];
+         otr[col] = (itr[col-1] && e && nptr[col] && sptr[col]) ?
+                    itr[col] : 0;
+      }
+      if(iw > 0){
+         e = (iw > 1) ? itr[1] : itr[0];
+         otr[0] = (e && nptr[0] && sptr[0]) ? itr[0] : 0;
+      }
+   }
 }
 
 /*************************************************************************
@@ -95,7 +106,8 @@ void erode_charimage_2(unsigned char *inp, unsigned char *out,
 #cat: dilate_charimage_2 - Dilates an 8-bit image by setting false pixels to
 #cat:             one if any of their 4 neighbors is non-zero.  Allocation
 #cat:             of the output image is the responsibility of the caller.
-#cat:             The input image remains unchanged.
+#cat:             The input image remains unchanged.  Interior pixels are
+#cat:             dilated MORPH_LANES at a time.
 
    Input:
       inp       - input 8-bit image to be dilated
@@ -108,119 +120,37 @@ void dilate_charimage_2(unsigned char *inp, unsigned char *out,
                       const int iw, const int ih)
 {
    int row, col;
-   unsigned char *itr = inp, *otr = out;
- 
-   memcpy(out, inp, iw*ih);
- 
-   /* for all pixels. set pixel if there is at least one true neighbor */
-   for ( row = 0 ; row < ih ; row++ )
-      for ( col = 0 ; col < iw ; col++ )
-      {  
-         if (!*itr)     /* pixel is already true, neighbors irrelevant */
-         {
-            /* more efficient with C's left to right evaluation of     */
-            /* conjuctions. E N S functions not executed if W is false */
-            if (get_west8_2 ((char *)itr, col        , 0) ||
-                get_east8_2 ((char *)itr, col, iw    , 0) ||
-                get_north8_2((char *)itr, row, iw    , 0) ||
-                get_south8_2((char *)itr, row, iw, ih, 0))
-               *otr = 1;
-         }
-         itr++ ; otr++;
-      }  
-}
-
-/*************************************************************************
-**************************************************************************
-#cat: get_south8_2 - Returns the value of the 8-bit image pixel 1 below the
-#cat:                current pixel if defined else it returns  (char)0.
-
-   Input:
-      ptr       - points to current pixel in image
-      row       - y-coord of current pixel
-      iw        - width (in pixels) of image
-      ih        - height (in pixels) of image
-      failcode  - return value if desired pixel does not exist
-   Return Code:
-      Zero      - if neighboring pixel is undefined
-                  (outside of image boundaries)
-      Pixel     - otherwise, value of neighboring pixel
-**************************************************************************/
-char get_south8_2(char *ptr, const int row, const int iw, const int ih,
-                  const int failcode)
-{
-   if (row >= ih-1) /* catch case where image is undefined southwards   */
-      return failcode; /* use plane geometry and return code.           */
-
-      return *(ptr+iw);
-}
-
-/*************************************************************************
-**************************************************************************
-#cat: get_north8_2 - Returns the value of the 8-bit image pixel 1 above the
-#cat:                current pixel if defined else it returns  (char)0.
-
-   Input:
-      ptr       - points to current pixel in image
-      row       - y-coord of current pixel
-      iw        - width (in pixels) of image
-      failcode  - return value if desired pixel does not exist
-   Return Code:
-      Zero      - if neighboring pixel is undefined
-                  (outside of image boundaries)
-      Pixel     - otherwise, value of neighboring pixel
-**************************************************************************/
-char get_north8_2(char *ptr, const int row, const int iw,
-                  const int failcode)
-{
-   if (row < 1)     /* catch case where image is undefined northwards   */
-      return failcode; /* use plane geometry and return code.           */
-
-      return *(ptr-iw);
-}
-
-/*************************************************************************
-**************************************************************************
-#cat: get_east8_2 - Returns the value of the 8-bit image pixel 1 right of the
-#cat:               current pixel if defined else it returns  (char)0.
-
-   Input:
-      ptr       - points to current pixel in image
-      col       - x-coord of current pixel
-      iw        - width (in pixels) of image
-      failcode  - return value if desired pixel does not exist
-   Return Code:
-      Zero      - if neighboring pixel is undefined
-                  (outside of image boundaries)
-      Pixel     - otherwise, value of neighboring pixel
-**************************************************************************/
-char get_east8_2(char *ptr, const int col, const int iw,
-                 const int failcode)
-{
-   if (col >= iw-1) /* catch case where image is undefined eastwards    */
-      return failcode; /* use plane geometry and return code.           */
-
-      return *(ptr+ 1);
-}
-
-/*************************************************************************
-**************************************************************************
-#cat: get_west8_2 - Returns the value of the 8-bit image pixel 1 left of the
-#cat:              current pixel if defined else it returns  (char)0.
-
-   Input:
-      ptr       - points to current pixel in image
-      col       - x-coord of current pixel
-      failcode  - return value if desired pixel does not exist
-   Return Code:
-      Zero      - if neighboring pixel is undefined
-                  (outside of image boundaries)
-      Pixel     - otherwise, value of neighboring pixel
-**************************************************************************/
-char get_west8_2(char *ptr, const int col, const int failcode)
-{
-   if (col < 1)     /* catch case where image is undefined westwards     */
-      return failcode; /* use plane geometry and return code.            */
-
-      return *(ptr- 1);
+   unsigned char *itr, *otr, *nptr, *sptr;
+   unsigned long long c, w, e, n, s;
+
+   for(row = 0; row < ih; row++){
+      itr = inp + (row * iw);
+      otr = out + (row * iw);
+      /* A neighbor off the edge of the image is replaced by the pixel */
+      /* itself, which can never set a false pixel.                    */
+      nptr = (row > 0) ? itr - iw : itr;
+      sptr = (row < ih-1) ? itr + iw : itr;
+
+      /* Interior columns, a word at a time. */
+      for(col = 1; col + MORPH_LANES < iw; col += MORPH_LANES){
+         MORPH_LOAD(c, itr + col);
+         MORPH_LOAD(w, itr + col - 1);
+         MORPH_LOAD(e, itr + col + 1);
+         MORPH_LOAD(n, nptr + col);
+         MORPH_LOAD(s, sptr + col);
+         c |= ~MORPH_NZ(c) & MORPH_NZ(w | e | n | s) & MORPH_ONES;
+         MORPH_STORE(otr + col, c);
+      }
+
+      /* Remaining columns, one at a time, then the first column. */
+      for(; col < iw; col++){
+         e = (col < iw-1) ? itr[col+1] : 0;
+         otr[col] = itr[col] ? itr[col] :
+                    ((itr[col-1] || e || nptr[col] || sptr[col]) ? 1 : 0);
+      }
+      if(iw > 0){
+         e = (iw > 1) ? itr[1] : 0;
+         otr[0] = itr[0] ? itr[0] : ((e || nptr[0] || sptr[0]) ? 1 : 0);
+      }
+   }
 }
@@ -39,6 +39,7 @@ identified are necessarily the best available for the purpose.
                         combined_minutia_quality()
                         grayscale_reliability()
                         get_neighborhood_stats()
+                        integral_images()
 
 ***********************************************************************/
 
@@ -172,6 +173,84 @@ int gen_quality_map(int **oqmap, int *direction_map, int *low_contrast_map,
    return(0);
 }
 
+/***********************************************************************
+************************************************************************
+#cat: integral_images - Builds summed-area tables of the pixel values and
+#cat:              the squared pixel values of an 8-bit grayscale image,
+#cat:              so that the sums over any rectangular neighborhood can
+#cat:              be read with four lookups into each table.
+
+   The tables are (iw+1) x (ih+1) with a leading row and column of
+   zeros, so that entry (x,y) holds the sum over all pixels above and
+   to the left of pixel (x,y).  They are kept as unsigned int and may
+   wrap on very large images; differences taken over a neighborhood
+   are still exact as long as the neighborhood sums themselves fit.
+
+   Input:
+      idata      - 8-bit grayscale fingerprint image
+      iw         - width (in pixels) of the image
+      ih         - height (in pixels) of the image
+   Output:
+      osum       - table of summed pixel values
+      osumsq     - table of summed squared pixel values
+   Return Code:
+      Zero       - successful completion
+      Negative   - system error
+************************************************************************/
+static int integral_images(unsigned int **osum, unsigned int **osumsq,
+                     unsigned char *idata, const int iw, const int ih)
+{
+   unsigned int *sum, *sumsq;
+   unsigned int *sptr, *qptr;
+   unsigned int rowsum, rowsumsq, v;
+   unsigned char *iptr;
+   int x, y, tw;
+
+   tw = iw + 1;
+
+   sum = (unsigned int *)malloc(tw * (ih+1) * sizeof(unsigned int));
+   if(sum == (unsigned int *)NULL){
+      fprintf(stderr, "ERROR : integral_images : malloc : sum\n");
+      return(-4);
+   }
+   sumsq = (unsigned int *)malloc(tw * (ih+1) * sizeof(unsigned int));
+   if(sumsq == (unsigned int *)NULL){
+      free(sum);
+      fprintf(stderr, "ERROR : integral_images : malloc : sumsq\n");
+      return(-5);
+   }
+
+   /* Leading row of zeros. */
+   memset(sum, 0, tw * sizeof(unsigned int));
+   memset(sumsq, 0, tw * sizeof(unsigned int));
+
+   iptr = idata;
+   for(y = 1; y <= ih; y++){
+      sptr = sum + (y * tw);
+      qptr = sumsq + (y * tw);
+      /* Leading column of zeros. */
+      sptr[0] = 0;
+      qptr[0] = 0;
+      rowsum = 0;
+      rowsumsq = 0;
+      /* Each entry is the running sum along the row plus the */
+      /* entry directly above it.                              */
+      for(x = 1; x <= iw; x++){
+         v = *iptr++;
+         rowsum += v;
+         rowsumsq += v * v;
+         sptr[x] = sptr[x-tw] + rowsum;
+         qptr[x] = qptr[x-tw] + rowsumsq;
+      }
+   }
+
+   *osum = sum;
+   *osumsq = sumsq;
+
+   /* Return normally. */
+   return(0);
+}
+
 /***********************************************************************
 ************************************************************************
 #cat: get_neighborhood_stats - Given a minutia point, computes the mean
@@ -184,6 +263,9 @@ int gen_quality_map(int **oqmap, int *direction_map, int *low_contrast_map,
    Input:
       minutia    - structure containing detected minutia
       idata      - 8-bit grayscale fingerprint image
+      sum        - summed-area table of pixel values from integral_images(),
+                   or NULL to sum the neighborhood from idata directly
+      sumsq      - summed-area table of squared pixel values
       iw         - width (in pixels) of the image
       ih         - height (in pixels) of the image
       radius_pix - pixel radius of surrounding neighborhood
@@ -192,15 +274,13 @@ int gen_quality_map(int **oqmap, int *direction_map, int *low_contrast_map,
       stdev      - standard deviation of neighboring pixels
 ************************************************************************/
 static void get_neighborhood_stats(double *mean, double *stdev, MINUTIA *minutia,
-                     unsigned char *idata, const int iw, const int ih,
-                     const int radius_pix)
+                     unsigned char *idata,
+                     const unsigned int *sum, const unsigned int *sumsq,
+                     const int iw, const int ih, const int radius_pix)
 {
-   int i, x, y, rows, cols;
-   int n = 0, sumX = 0, sumXX = 0;
-   int histogram[256];
-
-   /* Zero out histogram. */
-   memset(histogram, 0, 256 * sizeof(int));
+   int x, y, rows, cols, tw, top, bottom, left, right;
+   int n, sumX, sumXX;
+   unsigned char *iptr;
 
    /* Set minutia's coordinate variables. */
    x = minutia->x;
@@ -217,28 +297,37 @@ static void get_neighborhood_stats(double *mean, double *stdev, MINUTIA *minutia
       
    }
 
-   /* Foreach row in neighborhood ... */
-   for(rows = y - radius_pix;
-       rows <= y + radius_pix;
-       rows++){
-      /* Foreach column in neighborhood ... */
-      for(cols = x - radius_pix;
-          cols <= x + radius_pix;
-          cols++){
-         /* Bump neighbor's pixel value bin in histogram. */
-         histogram[*(idata+(rows * iw)+cols)]++;
-      }
+   /* N samples */
+   n = (2*radius_pix + 1) * (2*radius_pix + 1);
+
+   /* If summed-area tables are available ... */
+   if(sum != (unsigned int *)NULL){
+      /* Table offsets of the corners bounding the neighborhood. */
+      tw = iw + 1;
+      top = (y - radius_pix) * tw;
+      bottom = (y + radius_pix + 1) * tw;
+      left = x - radius_pix;
+      right = x + radius_pix + 1;
+
+      /* Sum(X[i]) and Sum(X[i]^2) from the four corners. */
+      sumX = (int)(sum[bottom+right] - sum[bottom+left] -
+                   sum[top+right] + sum[top+left]);
+      sumXX = (int)(sumsq[bottom+right] - sumsq[bottom+left] -
+                    sumsq[top+right] + sumsq[top+left]);
    }
-
-   /* Foreach grayscale pixel bin ... */
-   for(i = 0; i < 256; i++){
-      if(histogram[i]){
-         /* Accumulate Sum(X[i]) */
-         sumX += (i * histogram[i]);
-         /* Accumulate Sum(X[i]^2) */
-         sumXX += (i * i * histogram[i]);
-         /* Accumulate N samples */
-         n += histogram[i];
+   /* Otherwise, sum the neighborhood directly. */
+   else{
+      sumX = 0;
+      sumXX = 0;
+      /* Foreach row in neighborhood ... */
+      for(rows = y - radius_pix; rows <= y + radius_pix; rows++){
+         iptr = idata + (rows * iw) + x - radius_pix;
+         /* Foreach column in neighborhood ... */
+         for(cols = 0; cols <= radius_pix<<1; cols++){
+            /* Accumulate Sum(X[i]) and Sum(X[i]^2) */
+            sumX += iptr[cols];
+            sumXX += iptr[cols] * iptr[cols];
+         }
       }
    }
 
@@ -266,6 +355,9 @@ static void get_neighborhood_stats(double *mean, double *stdev, MINUTIA *minutia
    Input:
       minutia    - structure containing detected minutia
       idata      - 8-bit grayscale fingerprint image
+      sum        - summed-area table of pixel values from integral_images(),
+                   or NULL to sum the neighborhood from idata directly
+      sumsq      - summed-area table of squared pixel values
       iw         - width (in pixels) of the image
       ih         - height (in pixels) of the image
       radius_pix - pixel radius of surrounding neighborhood
@@ -273,12 +365,14 @@ static void get_neighborhood_stats(double *mean, double *stdev, MINUTIA *minutia
       reliability - computed reliability measure
 ************************************************************************/
 static double grayscale_reliability(MINUTIA *minutia, unsigned char *idata,
-                             const int iw, const int ih, const int radius_pix)
+                     const unsigned int *sum, const unsigned int *sumsq,
+                     const int iw, const int ih, const int radius_pix)
 {
    double mean, stdev;
    double reliability;
 
-   get_neighborhood_stats(&mean, &stdev, minutia, idata, iw, ih, radius_pix);
+   get_neighborhood_stats(&mean, &stdev, minutia, idata, sum, sumsq,
+                          iw, ih, radius_pix);
 
    reliability = min((stdev>IDEALSTDEV ? 1.0 : stdev/(double)IDEALSTDEV),
                          (1.0-(fabs(mean-IDEALMEAN)/(double)IDEALMEAN)));
@@ -314,8 +408,9 @@ int combined_minutia_quality(MINUTIAE *minutiae,
              unsigned char *idata, const int iw, const int ih, const int id,
              const double ppmm)
 {
-   int ret, i, index, radius_pix;
-   int *pquality_map, qmap_value;
+   int ret, i, bx, by, radius_pix, side;
+   int qmap_value;
+   unsigned int *sum, *sumsq;
    MINUTIA *minutia;
    double gs_reliability, reliability;
 
@@ -330,10 +425,15 @@ int combined_minutia_quality(MINUTIAE *minutiae,
    /* Compute pixel radius of neighborhood based on image's scan resolution. */
    radius_pix = sround(RADIUS_MM * ppmm);
 
-   /* Expand block map values to pixel map. */
-   if((ret = pixelize_map(&pquality_map, iw, ih,
-                         quality_map, mw, mh, blocksize))){
-      return(ret);
+   /* Summing the whole image once only pays off when the minutia   */
+   /* neighborhoods together cover more pixels than the image holds. */
+   sum = (unsigned int *)NULL;
+   sumsq = (unsigned int *)NULL;
+   side = (2*radius_pix) + 1;
+   if(minutiae->num * side * side > QUALITY_INTEGRAL_RATIO * iw * ih){
+      if((ret = integral_images(&sum, &sumsq, idata, iw, ih))){
+         return(ret);
+      }
    }
 
    /* Foreach minutiae detected ... */
@@ -342,14 +442,16 @@ int combined_minutia_quality(MINUTIAE *minutiae,
       minutia = minutiae->list[i];
 
       /* Compute reliability from stdev and mean of pixel neighborhood. */
-      gs_reliability = grayscale_reliability(minutia,
-                                             idata, iw, ih, radius_pix);
+      gs_reliability = grayscale_reliability(minutia, idata, sum, sumsq,
+                                             iw, ih, radius_pix);
 
-      /* Lookup quality map value. */
-      /* Compute minutia pixel index. */
-      index = (minutia->y * iw) + minutia->x;
-      /* Switch on pixel's quality value ... */
-      qmap_value = pquality_map[index];
+      /* Lookup quality map value.  Blocks in the last row and column */
+      /* are aligned to the far image edge by block_offsets(), so     */
+      /* pixels within a block of that edge belong to them.           */
+      bx = (minutia->x >= iw - blocksize) ? mw - 1 : minutia->x / blocksize;
+      by = (minutia->y >= ih - blocksize) ? mh - 1 : minutia->y / blocksize;
+      /* Switch on block's quality value ... */
+      qmap_value = quality_map[(by * mw) + bx];
 
       /* Combine grayscale reliability and quality map value. */
       switch(qmap_value){
@@ -378,16 +480,16 @@ int combined_minutia_quality(MINUTIAE *minutiae,
             fprintf(stderr, "ERROR : combined_miutia_quality : ");
             fprintf(stderr, "unexpected quality map value %d ", qmap_value);
             fprintf(stderr, "not in range [0..4]\n");
-            free(pquality_map);
+            free(sum);
+            free(sumsq);
             return(-3);
       }
       minutia->reliability = reliability;
    }
 
-   /* NEW 05-08-2002 */
-   free(pquality_map);
+   free(sum);
+   free(sumsq);
 
    /* Return normally. */
    return(0);
 }
-
@@ -871,11 +871,11 @@ static int remove_near_invblock_V2(MINUTIAE *minutiae, int *direction_map,
    /*                           |    |                       */
 
    /* LUT for starting neighbor index given (ix, iy).        */
-   static int startblk[9] = { 6, 0, 0,
+   static const int startblk[9] = { 6, 0, 0,
                               6,-1, 2,
                               4, 4, 2 };
    /* LUT for ending neighbor index given (ix, iy).          */
-   static int endblk[9] =   { 8, 0, 2,
+   static const int endblk[9] =   { 8, 0, 2,
                               6,-1, 2,
                               6, 4, 4 };
 
@@ -889,8 +889,8 @@ static int remove_near_invblock_V2(MINUTIAE *minutiae, int *direction_map,
    /*                      5 4 3                                    */
    /*                                                               */
    /*                       0  1  2  3  4  5  6  7  8                    */
-   static int blkdx[9] = {  0, 1, 1, 1, 0,-1,-1,-1, 0 };  /* Delta-X     */
-   static int blkdy[9] = { -1,-1, 0, 1, 1, 1, 0,-1,-1 };  /* Delta-Y     */
+   static const int blkdx[9] = {  0, 1, 1, 1, 0,-1,-1,-1, 0 };  /* Delta-X     */
+   static const int blkdy[9] = { -1,-1, 0, 1, 1, 1, 0,-1,-1 };  /* Delta-Y     */
 
    print2log("\nREMOVING MINUTIA NEAR INVALID BLOCKS:\n");
 
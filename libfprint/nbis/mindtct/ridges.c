@@ -217,37 +217,22 @@ static int update_nbr_dists(int *nbr_list, double *nbr_sqr_dists,
       max_nbrs - maximum number of closest neighbors to be returned
       first    - index of the primary minutia point
       minutiae - list of minutiae
+      nbr_sqr_dists - scratch list of max_nbrs squared distances
    Output:
-      onbr_list - points to list of detected closest neighbors
-      onnbrs    - points to number of neighbors returned
+      nbr_list - list of detected closest neighbors (max_nbrs long)
+      onnbrs   - points to number of neighbors returned
    Return Code:
       Zero      - successful completion
       Negative  - system error
 **************************************************************************/
-static int find_neighbors(int **onbr_list, int *onnbrs, const int max_nbrs,
+static int find_neighbors(int *nbr_list, double *nbr_sqr_dists,
+                   int *onnbrs, const int max_nbrs,
                    const int first, MINUTIAE *minutiae)
 {
    int ret, second, last_nbr;
    MINUTIA *minutia1, *minutia2;
-   int *nbr_list, nnbrs;
-   double *nbr_sqr_dists, xdist, xdist2;
-
-   /* Allocate list of neighbor minutiae indices. */
-   nbr_list = (int *)malloc(max_nbrs * sizeof(int));
-   if(nbr_list == (int *)NULL){
-      fprintf(stderr, "ERROR : find_neighbors : malloc : nbr_list\n");
-      return(-460);
-   }
-
-   /* Allocate list of squared euclidean distances between neighbors */
-   /* and current primary minutia point.                             */
-   nbr_sqr_dists = (double *)malloc(max_nbrs * sizeof(double));
-   if(nbr_sqr_dists == (double *)NULL){
-      free(nbr_list);
-      fprintf(stderr,
-              "ERROR : find_neighbors : malloc : nbr_sqr_dists\n");
-      return(-461);
-   }
+   int nnbrs;
+   double xdist, xdist2;
 
    /* Initialize number of stored neighbors to 0. */
    nnbrs = 0;
@@ -278,7 +263,6 @@ static int find_neighbors(int **onbr_list, int *onnbrs, const int max_nbrs,
          /* Append or insert the new neighbor into the neighbor lists. */
          if((ret = update_nbr_dists(nbr_list, nbr_sqr_dists, &nnbrs, max_nbrs,
                           first, second, minutiae))){
-            free(nbr_sqr_dists);
             return(ret);
          }
       }
@@ -293,20 +277,7 @@ static int find_neighbors(int **onbr_list, int *onnbrs, const int max_nbrs,
        second++;
    }
 
-   /* Deallocate working memory. */
-   free(nbr_sqr_dists);
-
-   /* If no neighbors found ... */
-   if(nnbrs == 0){
-      /* Deallocate the neighbor list. */
-      free(nbr_list);
-      *onnbrs = 0;
-   }
-   /* Otherwise, assign neighbors to output pointer. */
-   else{
-      *onbr_list = nbr_list;
-      *onnbrs = nnbrs;
-   }
+   *onnbrs = nnbrs;
 
    /* Return normally. */
    return(0);
@@ -336,7 +307,7 @@ static int sort_neighbors(int *nbr_list, const int nnbrs, const int first,
 {
    double *join_thetas, theta;
    int i;
-   static double pi2 = M_PI*2.0;
+   static const double pi2 = M_PI*2.0;
 
    /* List of angles of lines joining the current primary to each */
    /* of the secondary neighbors.                                 */
@@ -363,7 +334,7 @@ static int sort_neighbors(int *nbr_list, const int nnbrs, const int first,
    }
 
    /* Sort the neighbor indicies into rank order. */
-   bubble_sort_double_inc_2(join_thetas, nbr_list, nnbrs);
+   sort_double_inc_2(join_thetas, nbr_list, nnbrs);
 
    /* Deallocate the list of angles. */
    free(join_thetas);
@@ -705,6 +676,9 @@ static int ridge_count(const int first, const int second, MINUTIAE *minutiae,
 
    Input:
       minutia   - input minutia
+      nbr_slot  - storage for the minutia's neighbor indices followed by
+                  their ridge counts (2 x max_nbrs long)
+      nbr_sqr_dists - scratch list of max_nbrs squared distances
       bdata     - binary image data (0==while & 1==black)
       iw        - width (in pixels) of image
       ih        - height (in pixels) of image
@@ -716,15 +690,18 @@ static int ridge_count(const int first, const int second, MINUTIAE *minutiae,
       Negative - system error
 **************************************************************************/
 static int count_minutia_ridges(const int first, MINUTIAE *minutiae,
+                      int *nbr_slot, double *nbr_sqr_dists,
                       unsigned char *bdata, const int iw, const int ih,
                       const LFSPARMS *lfsparms)
 {
    int i, ret, *nbr_list, *nbr_nridges, nnbrs;
 
+   nbr_list = nbr_slot;
+   nbr_nridges = nbr_slot + lfsparms->max_nbrs;
+
    /* Find up to the maximum number of qualifying neighbors. */
-   if((ret = find_neighbors(&nbr_list, &nnbrs, lfsparms->max_nbrs,
-                           first, minutiae))){
-      free(nbr_list);
+   if((ret = find_neighbors(nbr_list, nbr_sqr_dists, &nnbrs,
+                           lfsparms->max_nbrs, first, minutiae))){
       return(ret);
    }
 
@@ -739,28 +716,16 @@ static int count_minutia_ridges(const int first, MINUTIAE *minutiae,
 
    /* Sort neighbors on delta dirs. */
    if((ret = sort_neighbors(nbr_list, nnbrs, first, minutiae))){
-      free(nbr_list);
       return(ret);
    }
 
    /* Count ridges between first and neighbors. */
-   /* List of ridge counts, one for each neighbor stored. */
-   nbr_nridges = (int *)malloc(nnbrs * sizeof(int));
-   if(nbr_nridges == (int *)NULL){
-      free(nbr_list);
-      fprintf(stderr, "ERROR : count_minutia_ridges : malloc : nbr_nridges\n");
-      return(-450);
-   }
-
    /* Foreach neighbor found and sorted in list ... */
    for(i = 0; i < nnbrs; i++){
       /* Count the ridges between the primary minutia and the neighbor. */
       ret = ridge_count(first, nbr_list[i], minutiae, bdata, iw, ih, lfsparms);
       /* If system error ... */
       if(ret < 0){
-         /* Deallocate working memories. */
-         free(nbr_list);
-         free(nbr_nridges);
          /* Return error code. */
          return(ret);
       }
@@ -802,7 +767,8 @@ int count_minutiae_ridges(MINUTIAE *minutiae,
                       const LFSPARMS *lfsparms)
 {
    int ret;
-   int i;
+   int i, slot_size;
+   double *nbr_sqr_dists;
 
    print2log("\nFINDING NBRS AND COUNTING RIDGES:\n");
 
@@ -816,16 +782,44 @@ int count_minutiae_ridges(MINUTIAE *minutiae,
       return(ret);
    }
 
+   if(minutiae->num < 2)
+      return(0);
+
+   /* Neighbor indices and ridge counts for every minutia are kept in  */
+   /* a single block owned by the list, 2 x max_nbrs ints per minutia. */
+   slot_size = lfsparms->max_nbrs << 1;
+   if(minutiae->nbr_store != (int *)NULL)
+      free(minutiae->nbr_store);
+   minutiae->nbr_store = (int *)malloc(minutiae->num * slot_size * sizeof(int));
+   if(minutiae->nbr_store == (int *)NULL){
+      fprintf(stderr, "ERROR : count_minutiae_ridges : malloc : nbr_store\n");
+      return(-460);
+   }
+
+   /* Allocate list of squared euclidean distances between neighbors */
+   /* and current primary minutia point.                             */
+   nbr_sqr_dists = (double *)malloc(lfsparms->max_nbrs * sizeof(double));
+   if(nbr_sqr_dists == (double *)NULL){
+      fprintf(stderr,
+              "ERROR : count_minutiae_ridges : malloc : nbr_sqr_dists\n");
+      return(-461);
+   }
+
    /* Foreach remaining sorted minutia in list ... */
    for(i = 0; i < minutiae->num-1; i++){
       /* Located neighbors and count number of ridges in between. */
       /* NOTE: neighbor and ridge count results are stored in     */
       /*       minutiae->list[i].                                 */
-      if((ret = count_minutia_ridges(i, minutiae, bdata, iw, ih, lfsparms))){
+      if((ret = count_minutia_ridges(i, minutiae,
+                             minutiae->nbr_store + (i * slot_size),
+                             nbr_sqr_dists, bdata, iw, ih, lfsparms))){
+         free(nbr_sqr_dists);
          return(ret);
       }
    }
 
+   free(nbr_sqr_dists);
+
    /* Return normally. */
    return(0);
 }
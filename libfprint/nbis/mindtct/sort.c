@@ -32,20 +32,50 @@ identified are necessarily the best available for the purpose.
       Contains sorting routines required by the NIST Latent Fingerprint
       System (LFS).
 
+      The original bubble sorts have been replaced by a stable LSD radix
+      sort for integer ranks and an introsort for double ranks, with
+      short lists going to an insertion sort.  Every routine returns the
+      exact order the bubble sorts produced, including the order of
+      equal ranks, so extraction results are unchanged.
+
 ***********************************************************************
                ROUTINES:
                         sort_indices_int_inc()
                         sort_indices_double_inc()
-                        bubble_sort_int_inc_2()
-                        bubble_sort_double_inc_2()
-                        bubble_sort_double_dec_2()
-                        bubble_sort_int_inc()
+                        insertion_sort_int_inc_2()
+                        radix_sort_int_inc_2()
+                        insertion_sort_double_2()
+                        less_dblrank()
+                        sift_down_dblranks()
+                        heap_sort_dblranks()
+                        intro_sort_dblranks()
+                        sort_double_2()
+                        sort_int_inc_2()
+                        sort_double_inc_2()
+                        sort_double_dec_2()
+                        sort_int_inc()
 ***********************************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <lfs.h>
 
+/* Lists of at most this many ranks are insertion sorted in place; */
+/* below it the radix and introsort setup costs more than it saves. */
+#define SORT_INSERT_MAX    16
+/* Lists of at most this many ranks sort with scratch on the stack. */
+#define SORT_STACK_MAX    256
+
+/* A double rank tagged with its attribute and its original position. */
+/* The position makes every key distinct, so the (unstable) introsort */
+/* still reproduces the stable order of equal ranks.                  */
+typedef struct {
+   double rank;
+   int item;
+   int pos;
+} DBLRANK;
+
 /*************************************************************************
 **************************************************************************
 #cat: sort_indices_int_inc - Takes a list of integers and returns a list of
@@ -79,7 +109,7 @@ int sort_indices_int_inc(int **optr, int *ranks, const int num)
       order[i] = i;
 
    /* Sort the indecies into rank order. */
-   bubble_sort_int_inc_2(ranks, order, num);
+   sort_int_inc_2(ranks, order, num);
 
    /* Set output pointer to the resulting order of sorted indices. */
    *optr = order;
@@ -120,7 +150,7 @@ int sort_indices_double_inc(int **optr, double *ranks, const int num)
       order[i] = i;
 
    /* Sort the indicies into rank order. */
-   bubble_sort_double_inc_2(ranks, order, num);
+   sort_double_inc_2(ranks, order, num);
 
    /* Set output pointer to the resulting order of sorted indices. */
    *optr = order;
@@ -130,112 +160,432 @@ int sort_indices_double_inc(int **optr, double *ranks, const int num)
 
 /*************************************************************************
 **************************************************************************
-#cat: bubble_sort_int_inc_2 - Takes a list of integer ranks and a corresponding
-#cat:                         list of integer attributes, and sorts the ranks
-#cat:                         into increasing order moving the attributes
-#cat:                         correspondingly.
+#cat: insertion_sort_int_inc_2 - Sorts a short list of integer ranks into
+#cat:              increasing order, moving the optional attributes
+#cat:              correspondingly.  Equal ranks keep their original order.
 
    Input:
       ranks     - list of integers to be sort on
-      items     - list of corresponding integer attributes
+      items     - list of corresponding integer attributes (may be NULL)
+      len       - number of items in list
+   Output:
+      ranks     - list of integers sorted in increasing order
+      items     - list of attributes in corresponding sorted order
+**************************************************************************/
+static void insertion_sort_int_inc_2(int *ranks, int *items, const int len)
+{
+   int i, j, trank, titem;
+
+   for(i = 1; i < len; i++){
+      trank = ranks[i];
+      titem = (items != (int *)NULL) ? items[i] : 0;
+      /* Shift strictly greater ranks up; stopping at an equal rank */
+      /* is what keeps the sort stable.                             */
+      for(j = i; j > 0 && ranks[j-1] > trank; j--){
+         ranks[j] = ranks[j-1];
+         if(items != (int *)NULL)
+            items[j] = items[j-1];
+      }
+      ranks[j] = trank;
+      if(items != (int *)NULL)
+         items[j] = titem;
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: radix_sort_int_inc_2 - Sorts a list of integer ranks into increasing
+#cat:              order with a stable least-significant-digit radix sort
+#cat:              on 8-bit digits, moving the optional attributes
+#cat:              correspondingly.  Digits shared by every rank (the
+#cat:              high bytes of pixel offsets, for example) are skipped.
+
+   Input:
+      ranks     - list of integers to be sort on
+      items     - list of corresponding integer attributes (may be NULL)
       len       - number of items in list
+      tranks    - scratch list of len integers
+      titems    - scratch list of len integers (unused if items is NULL)
    Output:
       ranks     - list of integers sorted in increasing order
       items     - list of attributes in corresponding sorted order
 **************************************************************************/
-void bubble_sort_int_inc_2(int *ranks, int *items, const int len)
+static void radix_sort_int_inc_2(int *ranks, int *items, const int len,
+                                 int *tranks, int *titems)
 {
-   int done = 0;
-   int i, p, n, trank, titem;
-
-   /* Set counter to the length of the list being sorted. */
-   n = len;
-
-   /* While swaps in order continue to occur from the */
-   /* previous iteration...                           */
-   while(!done){
-      /* Reset the done flag to TRUE. */
-      done = TRUE;
-      /* Foreach rank in list up to current end index...               */
-      /* ("p" points to current rank and "i" points to the next rank.) */
-      for (i=1, p = 0; i<n; i++, p++){
-         /* If previous rank is < current rank ... */
-         if(ranks[p] > ranks[i]){
-            /* Swap ranks. */
-            trank = ranks[i];
-            ranks[i] = ranks[p];
-            ranks[p] = trank;
-            /* Swap items. */
-            titem = items[i];
-            items[i] = items[p];
-            items[p] = titem;
-            /* Changes were made, so set done flag to FALSE. */
-            done = FALSE;
+   int counts[4][256];
+   int *sranks, *sitems, *dranks, *ditems, *swap;
+   unsigned int key;
+   int i, d, shift, sum, t;
+
+   /* Histogram all four digits in one pass.  The sign bit is */
+   /* flipped so negative ranks order before positive ones.   */
+   memset(counts, 0, sizeof(counts));
+   for(i = 0; i < len; i++){
+      key = (unsigned int)ranks[i] ^ 0x80000000u;
+      counts[0][key & 0xff]++;
+      counts[1][(key >> 8) & 0xff]++;
+      counts[2][(key >> 16) & 0xff]++;
+      counts[3][key >> 24]++;
+   }
+
+   sranks = ranks;
+   sitems = items;
+   dranks = tranks;
+   ditems = titems;
+   for(d = 0, shift = 0; d < 4; d++, shift += 8){
+      key = (unsigned int)sranks[0] ^ 0x80000000u;
+      /* If every rank has the same digit here, the pass is a no-op. */
+      if(counts[d][(key >> shift) & 0xff] == len)
+         continue;
+
+      /* Turn digit counts into starting offsets. */
+      sum = 0;
+      for(i = 0; i < 256; i++){
+         t = counts[d][i];
+         counts[d][i] = sum;
+         sum += t;
+      }
+
+      /* Scatter in list order, which keeps equal digits stable. */
+      if(sitems != (int *)NULL){
+         for(i = 0; i < len; i++){
+            key = (unsigned int)sranks[i] ^ 0x80000000u;
+            t = counts[d][(key >> shift) & 0xff]++;
+            dranks[t] = sranks[i];
+            ditems[t] = sitems[i];
          }
-         /* Otherwise, rank pair is in order, so continue. */
       }
-      /* Decrement the ending index. */
-      n--;
-   }     
+      else{
+         for(i = 0; i < len; i++){
+            key = (unsigned int)sranks[i] ^ 0x80000000u;
+            dranks[counts[d][(key >> shift) & 0xff]++] = sranks[i];
+         }
+      }
+
+      swap = sranks; sranks = dranks; dranks = swap;
+      swap = sitems; sitems = ditems; ditems = swap;
+   }
+
+   /* An odd number of passes leaves the result in the scratch lists. */
+   if(sranks != ranks){
+      memcpy(ranks, sranks, len * sizeof(int));
+      if(items != (int *)NULL)
+         memcpy(items, sitems, len * sizeof(int));
+   }
 }
 
 /*************************************************************************
 **************************************************************************
-#cat: bubble_sort_double_inc_2 - Takes a list of double ranks and a
-#cat:              corresponding list of integer attributes, and sorts the
-#cat:              ranks into increasing order moving the attributes
-#cat:              correspondingly.
+#cat: insertion_sort_double_2 - Sorts a short list of double ranks into
+#cat:              increasing or decreasing order, moving the attributes
+#cat:              correspondingly.  Equal ranks keep their original order.
 
    Input:
-      ranks     - list of double to be sort on
+      ranks     - list of doubles to be sort on
       items     - list of corresponding integer attributes
       len       - number of items in list
+      dec       - TRUE to sort into decreasing order
    Output:
-      ranks     - list of doubles sorted in increasing order
+      ranks     - list of doubles in sorted order
       items     - list of attributes in corresponding sorted order
 **************************************************************************/
-void bubble_sort_double_inc_2(double *ranks, int *items, const int len)
+static void insertion_sort_double_2(double *ranks, int *items, const int len,
+                                    const int dec)
 {
-   int done = 0;
-   int i, p, n, titem;
+   int i, j, titem;
    double trank;
 
-   /* Set counter to the length of the list being sorted. */
-   n = len;
-
-   /* While swaps in order continue to occur from the */
-   /* previous iteration...                           */
-   while(!done){
-      /* Reset the done flag to TRUE. */
-      done = TRUE;
-      /* Foreach rank in list up to current end index...               */
-      /* ("p" points to current rank and "i" points to the next rank.) */
-      for (i=1, p = 0; i<n; i++, p++){
-         /* If previous rank is < current rank ... */
-         if(ranks[p] > ranks[i]){
-            /* Swap ranks. */
-            trank = ranks[i];
-            ranks[i] = ranks[p];
-            ranks[p] = trank;
-            /* Swap items. */
-            titem = items[i];
-            items[i] = items[p];
-            items[p] = titem;
-            /* Changes were made, so set done flag to FALSE. */
-            done = FALSE;
+   for(i = 1; i < len; i++){
+      trank = ranks[i];
+      titem = items[i];
+      for(j = i; j > 0 && (dec ? ranks[j-1] < trank : ranks[j-1] > trank);
+          j--){
+         ranks[j] = ranks[j-1];
+         items[j] = items[j-1];
+      }
+      ranks[j] = trank;
+      items[j] = titem;
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: less_dblrank - Orders two tagged double ranks on rank, breaking ties
+#cat:              on original list position.
+
+   Input:
+      a, b      - tagged ranks to be compared
+   Return Code:
+      TRUE      - a sorts before b
+      FALSE     - otherwise
+**************************************************************************/
+static int less_dblrank(const DBLRANK *a, const DBLRANK *b)
+{
+   if(a->rank < b->rank)
+      return(TRUE);
+   if(a->rank > b->rank)
+      return(FALSE);
+   return(a->pos < b->pos);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: sift_down_dblranks - Restores the max-heap property below a given
+#cat:              node of a heap of tagged double ranks.
+
+   Input:
+      list      - heap of tagged ranks
+      root      - index of the node to sift down
+      len       - number of tagged ranks in the heap
+   Output:
+      list      - heap with the property restored
+**************************************************************************/
+static void sift_down_dblranks(DBLRANK *list, int root, const int len)
+{
+   int child;
+   DBLRANK t;
+
+   t = list[root];
+   while((child = (root << 1) + 1) < len){
+      if(child + 1 < len && less_dblrank(&list[child], &list[child+1]))
+         child++;
+      if(!less_dblrank(&t, &list[child]))
+         break;
+      list[root] = list[child];
+      root = child;
+   }
+   list[root] = t;
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: heap_sort_dblranks - Heap sorts a list of tagged double ranks.  Used
+#cat:              by the introsort when quicksort partitioning degrades.
+
+   Input:
+      list      - list of tagged ranks
+      len       - number of tagged ranks in list
+   Output:
+      list      - tagged ranks in increasing order
+**************************************************************************/
+static void heap_sort_dblranks(DBLRANK *list, const int len)
+{
+   int i;
+   DBLRANK t;
+
+   for(i = (len >> 1) - 1; i >= 0; i--)
+      sift_down_dblranks(list, i, len);
+   for(i = len - 1; i > 0; i--){
+      t = list[0];
+      list[0] = list[i];
+      list[i] = t;
+      sift_down_dblranks(list, 0, i);
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: intro_sort_dblranks - Quicksorts a list of tagged double ranks using
+#cat:              median-of-three pivots, switching to heap sort when the
+#cat:              recursion depth limit is hit.  Partitions of at most
+#cat:              SORT_INSERT_MAX ranks are left for a final insertion
+#cat:              pass by the caller.
+
+   Input:
+      list      - list of tagged ranks
+      len       - number of tagged ranks in list
+      depth     - remaining partitioning depth before heap sorting
+   Output:
+      list      - tagged ranks, ordered up to the small partitions
+**************************************************************************/
+static void intro_sort_dblranks(DBLRANK *list, int len, int depth)
+{
+   int i, j, mid;
+   DBLRANK pivot, t;
+
+   while(len > SORT_INSERT_MAX){
+      if(depth-- == 0){
+         heap_sort_dblranks(list, len);
+         return;
+      }
+
+      /* Order first, middle and last so they bound the scans below. */
+      mid = len >> 1;
+      if(less_dblrank(&list[mid], &list[0])){
+         t = list[mid]; list[mid] = list[0]; list[0] = t;
+      }
+      if(less_dblrank(&list[len-1], &list[mid])){
+         t = list[len-1]; list[len-1] = list[mid]; list[mid] = t;
+         if(less_dblrank(&list[mid], &list[0])){
+            t = list[mid]; list[mid] = list[0]; list[0] = t;
          }
-         /* Otherwise, rank pair is in order, so continue. */
       }
-      /* Decrement the ending index. */
-      n--;
-   }     
+      pivot = list[mid];
+
+      /* Hoare partition; keys are distinct, so both halves are */
+      /* non-empty.                                             */
+      i = -1;
+      j = len;
+      while(1){
+         do i++; while(less_dblrank(&list[i], &pivot));
+         do j--; while(less_dblrank(&pivot, &list[j]));
+         if(i >= j)
+            break;
+         t = list[i]; list[i] = list[j]; list[j] = t;
+      }
+      j++;
+
+      /* Recurse on the smaller half, loop on the larger. */
+      if(j < len - j){
+         intro_sort_dblranks(list, j, depth);
+         list += j;
+         len -= j;
+      }
+      else{
+         intro_sort_dblranks(list + j, len - j, depth);
+         len = j;
+      }
+   }
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: sort_double_2 - Sorts a list of double ranks into increasing or
+#cat:              decreasing order, moving the attributes correspondingly.
+#cat:              Equal ranks keep their original order.  Short lists are
+#cat:              insertion sorted; longer ones are tagged with their
+#cat:              positions and introsorted.
+
+   Input:
+      ranks     - list of doubles to be sort on
+      items     - list of corresponding integer attributes
+      len       - number of items in list
+      dec       - TRUE to sort into decreasing order
+   Output:
+      ranks     - list of doubles in sorted order
+      items     - list of attributes in corresponding sorted order
+**************************************************************************/
+static void sort_double_2(double *ranks, int *items, const int len,
+                          const int dec)
+{
+   DBLRANK stack[SORT_STACK_MAX], *list, t;
+   int i, j, depth;
+
+   if(len <= SORT_INSERT_MAX){
+      insertion_sort_double_2(ranks, items, len, dec);
+      return;
+   }
+
+   if(len <= SORT_STACK_MAX)
+      list = stack;
+   else{
+      list = (DBLRANK *)malloc(len * sizeof(DBLRANK));
+      /* Without scratch memory, fall back to sorting in place. */
+      if(list == (DBLRANK *)NULL){
+         insertion_sort_double_2(ranks, items, len, dec);
+         return;
+      }
+   }
+
+   /* Negating is exact, so a decreasing sort is an increasing */
+   /* sort on the negated ranks.                               */
+   for(i = 0; i < len; i++){
+      list[i].rank = dec ? -ranks[i] : ranks[i];
+      list[i].item = items[i];
+      list[i].pos = i;
+   }
+
+   /* Limit partitioning depth to twice log2(len). */
+   depth = 0;
+   for(i = len; i > 1; i >>= 1)
+      depth += 2;
+   intro_sort_dblranks(list, len, depth);
+
+   /* Finish the small partitions left by the introsort. */
+   for(i = 1; i < len; i++){
+      t = list[i];
+      for(j = i; j > 0 && less_dblrank(&t, &list[j-1]); j--)
+         list[j] = list[j-1];
+      list[j] = t;
+   }
+
+   for(i = 0; i < len; i++){
+      ranks[i] = dec ? -list[i].rank : list[i].rank;
+      items[i] = list[i].item;
+   }
+
+   if(list != stack)
+      free(list);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: sort_int_inc_2 - Takes a list of integer ranks and a corresponding
+#cat:                  list of integer attributes, and sorts the ranks
+#cat:                  into increasing order moving the attributes
+#cat:                  correspondingly.  Equal ranks keep their original
+#cat:                  order.
+
+   Input:
+      ranks     - list of integers to be sort on
+      items     - list of corresponding integer attributes
+      len       - number of items in list
+   Output:
+      ranks     - list of integers sorted in increasing order
+      items     - list of attributes in corresponding sorted order
+**************************************************************************/
+void sort_int_inc_2(int *ranks, int *items, const int len)
+{
+   int stack[2 * SORT_STACK_MAX], *tranks;
+
+   if(len <= SORT_INSERT_MAX){
+      insertion_sort_int_inc_2(ranks, items, len);
+      return;
+   }
+
+   if(len <= SORT_STACK_MAX)
+      tranks = stack;
+   else{
+      tranks = (int *)malloc(2 * len * sizeof(int));
+      /* Without scratch memory, fall back to sorting in place. */
+      if(tranks == (int *)NULL){
+         insertion_sort_int_inc_2(ranks, items, len);
+         return;
+      }
+   }
+
+   radix_sort_int_inc_2(ranks, items, len, tranks, tranks + len);
+
+   if(tranks != stack)
+      free(tranks);
+}
+
+/*************************************************************************
+**************************************************************************
+#cat: sort_double_inc_2 - Takes a list of double ranks and a
+#cat:              corresponding list of integer attributes, and sorts the
+#cat:              ranks into increasing order moving the attributes
+#cat:              correspondingly.  Equal ranks keep their original order.
+
+   Input:
+      ranks     - list of double to be sort on
+      items     - list of corresponding integer attributes
+      len       - number of items in list
+   Output:
+      ranks     - list of doubles sorted in increasing order
+      items     - list of attributes in corresponding sorted order
+**************************************************************************/
+void sort_double_inc_2(double *ranks, int *items, const int len)
+{
+   sort_double_2(ranks, items, len, FALSE);
 }
 
 /***************************************************************************
 **************************************************************************
-#cat: bubble_sort_double_dec_2 - Conducts a simple bubble sort returning a list
-#cat:        of ranks in decreasing order and their associated items in sorted
-#cat:        order as well.
+#cat: sort_double_dec_2 - Returns a list of ranks in decreasing order and
+#cat:        their associated items in sorted order as well.  Equal ranks
+#cat:        keep their original order.
 
    Input:
       ranks - list of values to be sorted
@@ -247,37 +597,15 @@ void bubble_sort_double_inc_2(double *ranks, int *items, const int len)
               If these items are indices, upon return, they may be used as
               indirect addresses reflecting the sorted order of the ranks.
 ****************************************************************************/
-void bubble_sort_double_dec_2(double *ranks, int *items,  const int len)
+void sort_double_dec_2(double *ranks, int *items,  const int len)
 {
-   int done = 0;
-   int i, p, n, titem;
-   double trank;
-
-   n = len;
-   while(!done){
-      done = 1;
-      for (i=1, p = 0;i<n;i++, p++){
-         /* If previous rank is < current rank ... */
-         if(ranks[p] < ranks[i]){
-            /* Swap ranks */
-            trank = ranks[i];
-            ranks[i] = ranks[p];
-            ranks[p] = trank;
-            /* Swap corresponding items */
-            titem = items[i];
-            items[i] = items[p];
-            items[p] = titem;
-            done = 0;
-         }
-      }
-      n--;
-   }     
+   sort_double_2(ranks, items, len, TRUE);
 }
 
 /*************************************************************************
 **************************************************************************
-#cat: bubble_sort_int_inc - Takes a list of integers and sorts them into
-#cat:            increasing order using a simple bubble sort.
+#cat: sort_int_inc - Takes a list of integers and sorts them into
+#cat:            increasing order.
 
    Input:
       ranks     - list of integers to be sort on
@@ -285,36 +613,28 @@ void bubble_sort_double_dec_2(double *ranks, int *items,  const int len)
    Output:
       ranks     - list of integers sorted in increasing order
 **************************************************************************/
-void bubble_sort_int_inc(int *ranks, const int len)
+void sort_int_inc(int *ranks, const int len)
 {
-   int done = 0;
-   int i, p, n;
-   int trank;
-
-   /* Set counter to the length of the list being sorted. */
-   n = len;
-
-   /* While swaps in order continue to occur from the */
-   /* previous iteration...                           */
-   while(!done){
-      /* Reset the done flag to TRUE. */
-      done = TRUE;
-      /* Foreach rank in list up to current end index...               */
-      /* ("p" points to current rank and "i" points to the next rank.) */
-      for (i=1, p = 0; i<n; i++, p++){
-         /* If previous rank is < current rank ... */
-         if(ranks[p] > ranks[i]){
-            /* Swap ranks. */
-            trank = ranks[i];
-            ranks[i] = ranks[p];
-            ranks[p] = trank;
-            /* Changes were made, so set done flag to FALSE. */
-            done = FALSE;
-         }
-         /* Otherwise, rank pair is in order, so continue. */
+   int stack[SORT_STACK_MAX], *tranks;
+
+   if(len <= SORT_INSERT_MAX){
+      insertion_sort_int_inc_2(ranks, (int *)NULL, len);
+      return;
+   }
+
+   if(len <= SORT_STACK_MAX)
+      tranks = stack;
+   else{
+      tranks = (int *)malloc(len * sizeof(int));
+      /* Without scratch memory, fall back to sorting in place. */
+      if(tranks == (int *)NULL){
+         insertion_sort_int_inc_2(ranks, (int *)NULL, len);
+         return;
       }
-      /* Decrement the ending index. */
-      n--;
-   }     
-}
+   }
 
+   radix_sort_int_inc_2(ranks, (int *)NULL, len, tranks, (int *)NULL);
+
+   if(tranks != stack)
+      free(tranks);
+}
@@ -534,7 +534,7 @@ int line2direction(const int fx, const int fy,
 {
    double theta, pi_factor;
    int idir, full_ndirs;
-   static double pi2 = M_PI*2.0;
+   static const double pi2 = M_PI*2.0;
 
    /* Compute angle to line connecting the 2 points.             */
    /* Coordinates are swapped and order of points reversed to    */
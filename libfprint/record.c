@@ -0,0 +1,313 @@
+/*
+ * Capture recording and replay for libfprint
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "fp_internal.h"
+
+/* A recording is a plain sequence of frames, each a fixed size header
+ * followed by the raw image as the driver delivered it, before
+ * standardization. Frames are only ever appended, each with a single write,
+ * so several processes may record into one file and a crash loses at most
+ * the frame being written. Every frame is padded to a multiple of 8 bytes, so
+ * frames start on 8 byte boundaries unless a torn write left a fragment
+ * before them. A reader maps the file and indexes the frames by walking the
+ * headers, without copying any image data. All fields are little endian. */
+
+#define RECORD_ALIGN 8
+#define RECORD_PAD(len) (((len) + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1))
+
+struct fpi_record_frame {
+	char magic[4];
+	uint32_t length;
+	uint64_t timestamp;
+	uint32_t capture_time;
+	uint32_t devtype;
+	uint16_t driver_id;
+	uint16_t flags;
+	uint16_t width;
+	uint16_t height;
+	unsigned char data[0];
+} __attribute__((__packed__));
+
+struct fpi_recorder {
+	int fd;
+	struct timespec finger_on;
+};
+
+static uint64_t timespec_to_usec(const struct timespec *ts)
+{
+	return (uint64_t) ts->tv_sec * 1000000 + ts->tv_nsec / 1000;
+}
+
+/* Opens path for appending captured frames, creating it if needed.
+ * Returns NULL if the file cannot be opened. */
+struct fpi_recorder *fpi_recorder_open(const char *path)
+{
+	struct fpi_recorder *rec;
+	int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+	if (fd < 0) {
+		fp_err("could not open recording '%s': %d", path, errno);
+		return NULL;
+	}
+
+	fp_dbg("recording captures to '%s'", path);
+	rec = g_malloc0(sizeof(*rec));
+	rec->fd = fd;
+	return rec;
+}
+
+void fpi_recorder_close(struct fpi_recorder *rec)
+{
+	if (!rec)
+		return;
+	close(rec->fd);
+	g_free(rec);
+}
+
+/* Notes when the finger was detected, so the next frame can record how long
+ * the driver took to deliver the image. */
+void fpi_recorder_finger_on(struct fpi_recorder *rec)
+{
+	clock_gettime(CLOCK_MONOTONIC, &rec->finger_on);
+}
+
+/* Cuts off the first written bytes of a frame that a short write left at the
+ * end of the file, so the next frame starts where this one should have. If
+ * another process has appended since, the fragment stays and readers skip
+ * over it. */
+static void record_drop_fragment(struct fpi_recorder *rec, size_t written)
+{
+	off_t end = lseek(rec->fd, 0, SEEK_CUR);
+	struct stat st;
+
+	if (end < 0 || fstat(rec->fd, &st) < 0 || st.st_size != end)
+		return;
+	if (ftruncate(rec->fd, end - written) < 0)
+		fp_warn("could not remove partial frame, error %d", errno);
+}
+
+/* Appends one captured image. img must have its dimensions set; its data and
+ * flags are stored as they are. */
+int fpi_recorder_write(struct fpi_recorder *rec, struct fp_dev *dev,
+	struct fp_img *img)
+{
+	static const unsigned char padding[RECORD_ALIGN];
+	struct fpi_record_frame hdr;
+	struct timespec now;
+	struct iovec iov[3];
+	size_t length = img->width * img->height;
+	size_t total = sizeof(hdr) + length;
+	ssize_t r;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	memcpy(hdr.magic, "FPR1", 4);
+	hdr.length = GUINT32_TO_LE(length);
+	if (rec->finger_on.tv_sec || rec->finger_on.tv_nsec)
+		hdr.capture_time = GUINT32_TO_LE(timespec_to_usec(&now)
+			- timespec_to_usec(&rec->finger_on));
+	else
+		hdr.capture_time = 0;
+	memset(&rec->finger_on, 0, sizeof(rec->finger_on));
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	hdr.timestamp = GUINT64_TO_LE(timespec_to_usec(&now));
+	hdr.devtype = GUINT32_TO_LE(dev->devtype);
+	hdr.driver_id = GUINT16_TO_LE(dev->drv->id);
+	hdr.flags = GUINT16_TO_LE(img->flags);
+	hdr.width = GUINT16_TO_LE(img->width);
+	hdr.height = GUINT16_TO_LE(img->height);
+
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len = sizeof(hdr);
+	iov[1].iov_base = img->data;
+	iov[1].iov_len = length;
+	iov[2].iov_base = (void *) padding;
+	iov[2].iov_len = RECORD_PAD(total) - total;
+
+	r = writev(rec->fd, iov, 3);
+	if (r < 0) {
+		fp_err("recording write failed, error %d", errno);
+		return -errno;
+	} else if (r != RECORD_PAD(total)) {
+		fp_err("short recording write (%zd)", r);
+		record_drop_fragment(rec, r);
+		return -EIO;
+	}
+	return 0;
+}
+
+struct fpi_recording {
+	unsigned char *map;
+	size_t size;
+	int nr_frames;
+	/* byte offset of each frame header in map */
+	size_t *index;
+};
+
+/* Checks the frame header at offset. Returns the offset of the following
+ * frame, or 0 if the frame is damaged or runs past the end of the file. */
+static size_t frame_end(struct fpi_recording *rec, size_t offset)
+{
+	struct fpi_record_frame *hdr =
+		(struct fpi_record_frame *) (rec->map + offset);
+	size_t length = GUINT32_FROM_LE(hdr->length);
+	size_t next = offset + RECORD_PAD(sizeof(*hdr) + length);
+
+	if (memcmp(hdr->magic, "FPR1", 4) != 0)
+		return 0;
+	if ((size_t) GUINT16_FROM_LE(hdr->width)
+			* GUINT16_FROM_LE(hdr->height) > length)
+		return 0;
+	if (next > rec->size)
+		return 0;
+	return next;
+}
+
+/* Returns the offset of the next frame magic after offset, or the size of the
+ * recording if there is none. */
+static size_t find_magic(struct fpi_recording *rec, size_t offset)
+{
+	unsigned char *p = rec->map + offset + 1;
+	unsigned char *end = rec->map + rec->size;
+
+	while ((p = memchr(p, 'F', end - p)) != NULL) {
+		if (end - p >= 4 && memcmp(p, "FPR1", 4) == 0)
+			return p - rec->map;
+		p++;
+	}
+	return rec->size;
+}
+
+/* Maps a recording and indexes its frames. Damaged frames, such as a
+ * truncated one left by an interrupted write, are skipped: the rest of the
+ * file is searched byte by byte for the next intact frame header, as the
+ * fragment may have left it off the 8 byte boundaries. Returns NULL if the
+ * file cannot be read or holds no intact frame. */
+API_EXPORTED struct fpi_recording *fpi_recording_open(const char *path)
+{
+	struct fpi_recording *rec;
+	struct stat st;
+	size_t offset = 0;
+	gboolean skipping = FALSE;
+	int alloc = 0;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fp_err("could not open recording '%s': %d", path, errno);
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size == 0) {
+		fp_err("could not read recording '%s'", path);
+		close(fd);
+		return NULL;
+	}
+
+	rec = g_malloc0(sizeof(*rec));
+	rec->size = st.st_size;
+	rec->map = mmap(NULL, rec->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (rec->map == MAP_FAILED) {
+		fp_err("could not map recording '%s': %d", path, errno);
+		g_free(rec);
+		return NULL;
+	}
+
+	while (offset + sizeof(struct fpi_record_frame) <= rec->size) {
+		size_t next = frame_end(rec, offset);
+
+		if (!next) {
+			if (!skipping)
+				fp_warn("damaged frame at offset %zu, skipping to the "
+					"next one", offset);
+			skipping = TRUE;
+			offset = find_magic(rec, offset);
+			continue;
+		}
+		if (skipping)
+			fp_dbg("resynchronized at offset %zu", offset);
+		skipping = FALSE;
+
+		if (rec->nr_frames == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			rec->index = g_realloc(rec->index,
+				alloc * sizeof(*rec->index));
+		}
+		rec->index[rec->nr_frames++] = offset;
+		offset = next;
+	}
+
+	if (rec->nr_frames == 0) {
+		fp_err("no frames in recording '%s'", path);
+		fpi_recording_close(rec);
+		return NULL;
+	}
+
+	fp_dbg("%d frames in '%s'", rec->nr_frames, path);
+	return rec;
+}
+
+API_EXPORTED void fpi_recording_close(struct fpi_recording *rec)
+{
+	if (!rec)
+		return;
+	munmap(rec->map, rec->size);
+	g_free(rec->index);
+	g_free(rec);
+}
+
+API_EXPORTED int fpi_recording_get_nr_frames(struct fpi_recording *rec)
+{
+	return rec->nr_frames;
+}
+
+/* Fills frame with the properties of frame number index. frame->data points
+ * into the mapped recording and stays valid until the recording is closed.
+ * Returns -EINVAL if there is no such frame. */
+API_EXPORTED int fpi_recording_get_frame(struct fpi_recording *rec, int index,
+	struct fpi_recording_frame *frame)
+{
+	struct fpi_record_frame *hdr;
+
+	if (index < 0 || index >= rec->nr_frames)
+		return -EINVAL;
+
+	hdr = (struct fpi_record_frame *) (rec->map + rec->index[index]);
+	frame->timestamp = GUINT64_FROM_LE(hdr->timestamp);
+	frame->capture_time = GUINT32_FROM_LE(hdr->capture_time);
+	frame->driver_id = GUINT16_FROM_LE(hdr->driver_id);
+	frame->devtype = GUINT32_FROM_LE(hdr->devtype);
+	frame->flags = GUINT16_FROM_LE(hdr->flags);
+	frame->width = GUINT16_FROM_LE(hdr->width);
+	frame->height = GUINT16_FROM_LE(hdr->height);
+	frame->length = GUINT32_FROM_LE(hdr->length);
+	frame->data = hdr->data;
+	return 0;
+}
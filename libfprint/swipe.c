@@ -0,0 +1,179 @@
+/*
+ * Motion estimation for swipe sensors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <limits.h>
+
+#include <glib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fp_internal.h"
+
+/* Swipe sensors deliver the finger a few rows at a time, and the driver has
+ * to work out how far it moved between two reads by comparing them. The
+ * comparisons are sums of absolute differences, which SSE2 computes 16
+ * pixels at a time with psadbw. */
+
+/* bytes compared between checks against the caller's limit */
+#define SAD_CHUNK 256
+
+#ifdef __SSE2__
+static unsigned int sum_epi64(__m128i acc)
+{
+	acc = _mm_add_epi64(acc, _mm_srli_si128(acc, 8));
+	return _mm_cvtsi128_si32(acc);
+}
+#endif
+
+/* Sum of absolute differences between a and b. Gives up as soon as the sum
+ * exceeds limit, in which case the partial sum is returned, which is still
+ * greater than limit. */
+static unsigned int sad(const unsigned char *a, const unsigned char *b,
+	size_t len, unsigned int limit)
+{
+	unsigned int total = 0;
+	size_t i = 0;
+
+	while (i < len) {
+		size_t end = MIN(len, i + SAD_CHUNK);
+#ifdef __SSE2__
+		__m128i acc = _mm_setzero_si128();
+
+		for (; i + 16 <= end; i += 16)
+			acc = _mm_add_epi64(acc, _mm_sad_epu8(
+				_mm_loadu_si128((const __m128i *) (a + i)),
+				_mm_loadu_si128((const __m128i *) (b + i))));
+		total += sum_epi64(acc);
+#endif
+		for (; i < end; i++)
+			total += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+		if (total > limit)
+			break;
+	}
+
+	return total;
+}
+
+/* Compares two rows of len pixels. Returns the sum of their absolute
+ * differences and stores the sum of the pixels of b in total. */
+unsigned int fpi_swipe_row_diff(const unsigned char *a,
+	const unsigned char *b, size_t len, unsigned int *total)
+{
+	unsigned int diff = 0;
+	unsigned int sum = 0;
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128i diff_acc = _mm_setzero_si128();
+	__m128i sum_acc = _mm_setzero_si128();
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *) (b + i));
+
+		diff_acc = _mm_add_epi64(diff_acc, _mm_sad_epu8(va, vb));
+		sum_acc = _mm_add_epi64(sum_acc,
+			_mm_sad_epu8(vb, _mm_setzero_si128()));
+	}
+	diff = sum_epi64(diff_acc);
+	sum = sum_epi64(sum_acc);
+#endif
+
+	for (; i < len; i++) {
+		diff += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+		sum += b[i];
+	}
+
+	*total = sum;
+	return diff;
+}
+
+struct overlap_search {
+	const unsigned char *first;
+	const unsigned char *second;
+	unsigned int width;
+	unsigned int height;
+	unsigned int best_dy;
+	unsigned int best_sad;
+	unsigned int best_len;
+};
+
+/* Tries dy, keeping it if its mean difference is lower than the best so far,
+ * or equal to it at a smaller shift. The comparison stops early once it
+ * cannot be either. */
+static void try_overlap(struct overlap_search *s, unsigned int dy)
+{
+	unsigned int len = s->width * (s->height - dy);
+	unsigned int limit = UINT_MAX;
+	unsigned int r;
+
+	if (s->best_len) {
+		uint64_t best = (uint64_t) s->best_sad * len;
+
+		limit = best / s->best_len;
+		r = sad(s->first + s->width * dy, s->second, len, limit);
+		if ((uint64_t) r * s->best_len > best
+				|| ((uint64_t) r * s->best_len == best && dy > s->best_dy))
+			return;
+	} else {
+		r = sad(s->first + s->width * dy, s->second, len, limit);
+	}
+
+	s->best_dy = dy;
+	s->best_sad = r;
+	s->best_len = len;
+}
+
+/* Finds how many rows further down the finger was in second than in first,
+ * both being width x height images, by looking for the shift which gives
+ * the lowest mean difference where they overlap. Ties go to the smaller
+ * shift. Returns the shift, from 0 to height - 1, and stores its mean
+ * difference, scaled by 256, in error.
+ *
+ * Every shift is considered, but coarse to fine: the even shifts first,
+ * then the odd shifts starting next to the best even one. A close match
+ * found early lets most of the remaining comparisons stop after a chunk or
+ * two. */
+unsigned int fpi_swipe_find_overlap(const unsigned char *first,
+	const unsigned char *second, unsigned int width, unsigned int height,
+	unsigned int *error)
+{
+	struct overlap_search s = {
+		.first = first,
+		.second = second,
+		.width = width,
+		.height = height,
+	};
+	unsigned int dy, best, i;
+
+	for (dy = 0; dy < height; dy += 2)
+		try_overlap(&s, dy);
+
+	/* odd shifts, nearest to the best even shift first */
+	best = s.best_dy;
+	for (i = 1; i < height; i += 2) {
+		if (best >= i)
+			try_overlap(&s, best - i);
+		if (best + i < height)
+			try_overlap(&s, best + i);
+	}
+
+	*error = (uint64_t) s.best_sad * 256 / s.best_len;
+	return s.best_dy;
+}
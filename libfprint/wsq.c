@@ -0,0 +1,1389 @@
+/*
+ * Wavelet Scalar Quantization image compression for libfprint
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "fp_internal.h"
+
+/* WSQ is the FBI's compression format for 8-bit fingerprint images
+ * (IAFIS-IC-0110, version 3), as implemented by NBIS. The image is split
+ * into 64 subbands by a fixed wavelet packet decomposition, each subband is
+ * quantized with a bin width derived from its variance and the target bit
+ * rate, and the quantized coefficients are Huffman coded in three blocks.
+ * The stream layout follows the specification, so files can be exchanged
+ * with other WSQ implementations.
+ *
+ * The transform works in place on a single float plane, using only a line
+ * buffer for the filters, and the compressed stream is written out through
+ * a small fixed buffer. Encoding therefore never holds more than the float
+ * plane and the quantized coefficients, however well or badly the image
+ * compresses. */
+
+#define WSQ_SOI		0xffa0
+#define WSQ_EOI		0xffa1
+#define WSQ_SOF		0xffa2
+#define WSQ_SOB		0xffa3
+#define WSQ_DTT		0xffa4
+#define WSQ_DQT		0xffa5
+#define WSQ_DHT		0xffa6
+#define WSQ_DRT		0xffa7
+#define WSQ_COM		0xffa8
+#define WSQ_RST0	0xffb0
+#define WSQ_RST7	0xffb7
+
+/* wavelet packet tree: 20 transformed regions producing 64 subbands, of
+ * which the last 4 are always discarded */
+#define WSQ_NODES		20
+#define WSQ_SUBBANDS		60
+#define WSQ_MAX_SUBBANDS	64
+#define WSQ_BLOCK2		19	/* first subband of block 2 */
+#define WSQ_BLOCK3		52	/* first subband of block 3 */
+#define WSQ_MIN_SIZE		32
+#define WSQ_MAX_SIZE		8192
+
+/* Huffman symbols: 1-100 are zero runs of that length, 107-254 are
+ * coefficients from -73 to 74, the others escape longer values */
+#define WSQ_MAX_ZRUN		100
+#define WSQ_MAX_COEFF		74
+#define WSQ_POS_COEFF8		101
+#define WSQ_NEG_COEFF8		102
+#define WSQ_POS_COEFF16		103
+#define WSQ_NEG_COEFF16		104
+#define WSQ_ZRUN8		105
+#define WSQ_ZRUN16		106
+#define WSQ_COEFF_BASE		180
+#define WSQ_NR_SYMBOLS		256
+#define WSQ_MAX_CODE_BITS	16
+#define WSQ_HUFFTABLES		8
+#define WSQ_LOOKUP_BITS		9
+#define WSQ_END_OF_DATA		WSQ_NR_SYMBOLS
+
+#define WSQ_BIN_CENTER		0.44f
+#define WSQ_BITRATE		0.75f	/* bits per pixel, about 15:1 */
+
+struct wsq_rect {
+	int x;
+	int y;
+	int lenx;
+	int leny;
+};
+
+struct wsq_node {
+	struct wsq_rect r;
+	/* high pass half first, horizontally and vertically */
+	int inv_rw;
+	int inv_cl;
+};
+
+struct wsq_tree {
+	struct wsq_node node[WSQ_NODES];
+	struct wsq_rect band[WSQ_MAX_SUBBANDS];
+};
+
+/* Each region of the decomposition is a quadrant (0 top left, 1 top right,
+ * 2 bottom left, 3 bottom right) of an earlier one. */
+static const unsigned char node_parent[WSQ_NODES][2] = {
+	{ 0, 0 }, { 0, 0 }, { 0, 1 }, { 0, 2 }, { 1, 1 },
+	{ 1, 2 }, { 4, 0 }, { 4, 1 }, { 4, 2 }, { 4, 3 },
+	{ 5, 0 }, { 5, 1 }, { 5, 2 }, { 5, 3 }, { 1, 0 },
+	{ 14, 0 }, { 14, 1 }, { 14, 2 }, { 14, 3 }, { 15, 0 },
+};
+
+/* The subbands in stream order, as quadrants of the regions. */
+static const unsigned char band_parent[WSQ_SUBBANDS][2] = {
+	{ 19, 0 }, { 19, 1 }, { 19, 2 }, { 19, 3 },
+	{ 15, 1 }, { 15, 2 }, { 15, 3 },
+	{ 16, 0 }, { 16, 1 }, { 16, 2 }, { 16, 3 },
+	{ 17, 0 }, { 17, 1 }, { 17, 2 }, { 17, 3 },
+	{ 18, 0 }, { 18, 1 }, { 18, 2 }, { 18, 3 },
+	{ 6, 0 }, { 6, 1 }, { 6, 2 }, { 6, 3 },
+	{ 7, 0 }, { 7, 1 }, { 7, 2 }, { 7, 3 },
+	{ 8, 0 }, { 8, 1 }, { 8, 2 }, { 8, 3 },
+	{ 9, 0 }, { 9, 1 }, { 9, 2 }, { 9, 3 },
+	{ 10, 0 }, { 10, 1 }, { 10, 2 }, { 10, 3 },
+	{ 11, 0 }, { 11, 1 }, { 11, 2 }, { 11, 3 },
+	{ 12, 0 }, { 12, 1 }, { 12, 2 }, { 12, 3 },
+	{ 13, 0 }, { 13, 1 }, { 13, 2 }, { 13, 3 },
+	{ 1, 3 },
+	{ 2, 0 }, { 2, 1 }, { 2, 2 }, { 2, 3 },
+	{ 3, 0 }, { 3, 1 }, { 3, 2 }, { 3, 3 },
+};
+
+/* Analysis filters, from the centre tap outwards. */
+struct wsq_filters {
+	float lo[5];
+	float hi[4];
+};
+
+static const struct wsq_filters wsq_default_filters = {
+	.lo = { 0.85269867900889385f, 0.37740285561283066f,
+		-0.11062440441843718f, -0.02384946501955685f,
+		0.03782845550726404f },
+	.hi = { 0.78848561640558440f, -0.41809227322161724f,
+		-0.04068941760916406f, 0.06453888262869706f },
+};
+
+struct wsq_quant {
+	float cr;
+	float qbss[WSQ_MAX_SUBBANDS];
+	float qzbs[WSQ_MAX_SUBBANDS];
+};
+
+/* Huffman table as transmitted: the number of codes of each length and the
+ * symbols in code order */
+struct wsq_hufftable {
+	unsigned char bits[WSQ_MAX_CODE_BITS];
+	unsigned char values[WSQ_NR_SYMBOLS];
+	int nr_values;
+};
+
+/***** TREE *****/
+
+static void wsq_quadrant(const struct wsq_node *n, int quadrant,
+	struct wsq_rect *r)
+{
+	/* the low pass half gets the extra sample of an odd length */
+	int fx = n->inv_rw ? n->r.lenx / 2 : (n->r.lenx + 1) / 2;
+	int fy = n->inv_cl ? n->r.leny / 2 : (n->r.leny + 1) / 2;
+
+	r->x = n->r.x + ((quadrant & 1) ? fx : 0);
+	r->y = n->r.y + ((quadrant & 2) ? fy : 0);
+	r->lenx = (quadrant & 1) ? n->r.lenx - fx : fx;
+	r->leny = (quadrant & 2) ? n->r.leny - fy : fy;
+}
+
+static void wsq_build_tree(struct wsq_tree *tree, int width, int height)
+{
+	int i;
+
+	memset(tree, 0, sizeof(*tree));
+	tree->node[0].r.lenx = width;
+	tree->node[0].r.leny = height;
+	/* right and bottom quadrants are transformed mirrored, so that
+	 * neighbouring low pass bands stay next to each other */
+	for (i = 1; i < WSQ_NODES; i++) {
+		int quadrant = node_parent[i][1];
+		wsq_quadrant(&tree->node[node_parent[i][0]], quadrant,
+			&tree->node[i].r);
+		tree->node[i].inv_rw = quadrant & 1;
+		tree->node[i].inv_cl = quadrant >> 1;
+	}
+
+	for (i = 0; i < WSQ_SUBBANDS; i++)
+		wsq_quadrant(&tree->node[band_parent[i][0]], band_parent[i][1],
+			&tree->band[i]);
+}
+
+/***** TRANSFORM *****/
+
+/* samples of symmetric extension needed on each side of a line */
+#define WSQ_EXT 4
+
+/* Reflects i into 0..len-1 about the first and last samples. */
+static int wsq_mirror(int i, int len)
+{
+	while (i < 0 || i >= len) {
+		if (i < 0)
+			i = -i;
+		if (i >= len)
+			i = 2 * (len - 1) - i;
+	}
+	return i;
+}
+
+static void wsq_extend_line(float *line, int len)
+{
+	int i;
+
+	for (i = 1; i <= WSQ_EXT; i++) {
+		line[-i] = line[wsq_mirror(-i, len)];
+		line[len - 1 + i] = line[wsq_mirror(len - 1 + i, len)];
+	}
+}
+
+/* Splits len samples of data, stride apart, into low and high pass halves.
+ * buf must hold len + 2 * WSQ_EXT floats. */
+static void wsq_analyze_line(float *data, int stride, int len, int inv,
+	const struct wsq_filters *f, float *buf)
+{
+	float *x = buf + WSQ_EXT;
+	int nlo = (len + 1) / 2;
+	int nhi = len / 2;
+	float *lo = inv ? data + nhi * stride : data;
+	float *hi = inv ? data : data + nlo * stride;
+	int i;
+
+	for (i = 0; i < len; i++)
+		x[i] = data[i * stride];
+	wsq_extend_line(x, len);
+
+	for (i = 0; i < nlo; i++, x += 2)
+		lo[i * stride] = f->lo[0] * x[0]
+			+ f->lo[1] * (x[-1] + x[1]) + f->lo[2] * (x[-2] + x[2])
+			+ f->lo[3] * (x[-3] + x[3]) + f->lo[4] * (x[-4] + x[4]);
+
+	x = buf + WSQ_EXT + 1;
+	for (i = 0; i < nhi; i++, x += 2)
+		hi[i * stride] = f->hi[0] * x[0]
+			+ f->hi[1] * (x[-1] + x[1]) + f->hi[2] * (x[-2] + x[2])
+			+ f->hi[3] * (x[-3] + x[3]);
+}
+
+/* Inverse of wsq_analyze_line(). The synthesis filters are the analysis
+ * filters of the other band, with every other tap negated. */
+static void wsq_synthesize_line(float *data, int stride, int len, int inv,
+	const struct wsq_filters *f, float *buf)
+{
+	float *y = buf + WSQ_EXT;
+	int nlo = (len + 1) / 2;
+	int nhi = len / 2;
+	float *lo = inv ? data + nhi * stride : data;
+	float *hi = inv ? data : data + nlo * stride;
+	int i;
+
+	/* interleave the bands back into sample order */
+	for (i = 0; i < nlo; i++)
+		y[2 * i] = lo[i * stride];
+	for (i = 0; i < nhi; i++)
+		y[2 * i + 1] = hi[i * stride];
+	wsq_extend_line(y, len);
+
+	for (i = 0; i < len; i += 2)
+		data[i * stride] = f->hi[0] * y[i]
+			+ f->hi[2] * (y[i - 2] + y[i + 2])
+			- f->lo[1] * (y[i - 1] + y[i + 1])
+			- f->lo[3] * (y[i - 3] + y[i + 3]);
+	for (i = 1; i < len; i += 2)
+		data[i * stride] = f->lo[0] * y[i]
+			+ f->lo[2] * (y[i - 2] + y[i + 2])
+			+ f->lo[4] * (y[i - 4] + y[i + 4])
+			- f->hi[1] * (y[i - 1] + y[i + 1])
+			- f->hi[3] * (y[i - 3] + y[i + 3]);
+}
+
+static void wsq_decompose(float *plane, int width, const struct wsq_tree *tree,
+	const struct wsq_filters *f, float *buf)
+{
+	int i, j;
+
+	for (i = 0; i < WSQ_NODES; i++) {
+		const struct wsq_node *n = &tree->node[i];
+		float *base = plane + n->r.y * width + n->r.x;
+		for (j = 0; j < n->r.leny; j++)
+			wsq_analyze_line(base + j * width, 1, n->r.lenx, n->inv_rw,
+				f, buf);
+		for (j = 0; j < n->r.lenx; j++)
+			wsq_analyze_line(base + j, width, n->r.leny, n->inv_cl,
+				f, buf);
+	}
+}
+
+static void wsq_reconstruct(float *plane, int width,
+	const struct wsq_tree *tree, const struct wsq_filters *f, float *buf)
+{
+	int i, j;
+
+	for (i = WSQ_NODES - 1; i >= 0; i--) {
+		const struct wsq_node *n = &tree->node[i];
+		float *base = plane + n->r.y * width + n->r.x;
+		for (j = 0; j < n->r.lenx; j++)
+			wsq_synthesize_line(base + j, width, n->r.leny, n->inv_cl,
+				f, buf);
+		for (j = 0; j < n->r.leny; j++)
+			wsq_synthesize_line(base + j * width, 1, n->r.lenx,
+				n->inv_rw, f, buf);
+	}
+}
+
+/***** QUANTIZATION *****/
+
+/* Parameters are stored as a 16 or 32 bit mantissa and a decimal exponent:
+ * value = mantissa / 10^scale. */
+static void wsq_scale(double value, double limit, int *scale,
+	unsigned int *mantissa)
+{
+	*scale = 0;
+	if (value <= 0.0) {
+		*mantissa = 0;
+		return;
+	}
+	if (value >= limit) {
+		*mantissa = limit;
+		return;
+	}
+	while (value * 10.0 < limit) {
+		value *= 10.0;
+		(*scale)++;
+	}
+	*mantissa = value + 0.5;
+}
+
+static float wsq_unscale(int scale, unsigned int mantissa)
+{
+	double value = mantissa;
+
+	while (scale-- > 0)
+		value /= 10.0;
+	return value;
+}
+
+/* Returns value as a decoder will read it back from the stream. */
+static float wsq_round(float value)
+{
+	unsigned int mantissa;
+	int scale;
+
+	wsq_scale(value, 65535.0, &scale, &mantissa);
+	return wsq_unscale(scale, mantissa);
+}
+
+static float wsq_band_variance(const float *plane, int width,
+	const struct wsq_rect *band, int x, int y, int lenx, int leny)
+{
+	const float *p = plane + (band->y + y) * width + band->x + x;
+	double sum = 0.0;
+	double ssq = 0.0;
+	int n = lenx * leny;
+	int i, j;
+
+	if (n < 2)
+		return 0.0;
+	for (j = 0; j < leny; j++, p += width)
+		for (i = 0; i < lenx; i++) {
+			sum += p[i];
+			ssq += p[i] * p[i];
+		}
+	return (ssq - sum * sum / n) / (n - 1.0);
+}
+
+/* Chooses the bin widths that bring the subbands down to bitrate bits per
+ * pixel, following the bit allocation of the specification. */
+static void wsq_compute_quant(struct wsq_quant *quant, const float *plane,
+	int width, const struct wsq_tree *tree, float bitrate)
+{
+	float var[WSQ_SUBBANDS];
+	float qbss[WSQ_SUBBANDS];
+	int keep[WSQ_SUBBANDS];
+	double vsum = 0.0;
+	double q = 1.0;
+	int i;
+
+	/* the variance is taken over the centre of each subband, unless that
+	 * leaves too little signal to go on */
+	for (i = 0; i < WSQ_SUBBANDS; i++) {
+		const struct wsq_rect *b = &tree->band[i];
+		var[i] = wsq_band_variance(plane, width, b, b->lenx / 8,
+			(9 * b->leny) / 32, (3 * b->lenx) / 4, (7 * b->leny) / 16);
+		vsum += var[i];
+	}
+	if (vsum < 20000.0)
+		for (i = 0; i < WSQ_SUBBANDS; i++)
+			var[i] = wsq_band_variance(plane, width, &tree->band[i], 0,
+				0, tree->band[i].lenx, tree->band[i].leny);
+
+	for (i = 0; i < WSQ_SUBBANDS; i++) {
+		/* weights for the perceptually less important bands */
+		static const float a[] = { 1.32f, 1.08f, 1.42f, 1.08f,
+			1.32f, 1.42f, 1.08f, 1.08f };
+		float ak = i < WSQ_BLOCK3 ? 1.0f : a[i - WSQ_BLOCK3];
+
+		keep[i] = var[i] >= 1.01f;
+		if (i < 4)
+			qbss[i] = 1.0f;
+		else if (keep[i])
+			qbss[i] = 10.0f / (ak * logf(var[i]));
+	}
+
+	/* drop subbands that would get a negative bit rate until the rest
+	 * can share the budget */
+	while (1) {
+		double s = 0.0;
+		double p = 1.0;
+		int dropped = 0;
+
+		for (i = 0; i < WSQ_SUBBANDS; i++) {
+			/* fraction of the image covered by the subband */
+			double m = i < 4 ? 1.0 / 1024 : i < 51 ? 1.0 / 256 : 1.0 / 16;
+			if (!keep[i])
+				continue;
+			s += m;
+			p *= pow(sqrt(var[i]) / qbss[i], m);
+		}
+		if (s == 0.0)
+			break;
+
+		q = (pow(2.0, bitrate / s - 1.0) / 2.5) / pow(p, 1.0 / s);
+		for (i = 0; i < WSQ_SUBBANDS; i++)
+			if (keep[i] && qbss[i] / q >= 5.0 * sqrt(var[i])) {
+				keep[i] = 0;
+				dropped++;
+			}
+		if (!dropped)
+			break;
+	}
+
+	memset(quant, 0, sizeof(*quant));
+	quant->cr = WSQ_BIN_CENTER;
+	for (i = 0; i < WSQ_SUBBANDS; i++) {
+		if (!keep[i])
+			continue;
+		quant->qbss[i] = wsq_round(qbss[i] / q);
+		quant->qzbs[i] = wsq_round(1.2f * qbss[i] / q);
+	}
+}
+
+/* Quantizes the subbands in stream order into qdata, and returns the number
+ * of coefficients in each of the three blocks in sizes. */
+static void wsq_quantize(short *qdata, const float *plane, int width,
+	const struct wsq_tree *tree, const struct wsq_quant *quant, int *sizes)
+{
+	short *q = qdata;
+	short *block = qdata;
+	int i, x, y;
+
+	for (i = 0; i < WSQ_SUBBANDS; i++) {
+		const struct wsq_rect *b = &tree->band[i];
+		float step = quant->qbss[i];
+		float zbin = quant->qzbs[i] / 2.0f;
+
+		if (i == WSQ_BLOCK2 || i == WSQ_BLOCK3) {
+			*sizes++ = q - block;
+			block = q;
+		}
+		if (step == 0.0f)
+			continue;
+
+		for (y = 0; y < b->leny; y++) {
+			const float *p = plane + (b->y + y) * width + b->x;
+			for (x = 0; x < b->lenx; x++) {
+				float v;
+				if (p[x] > zbin)
+					v = (p[x] - zbin) / step + 1.0f;
+				else if (p[x] < -zbin)
+					v = (p[x] + zbin) / step - 1.0f;
+				else
+					v = 0.0f;
+				*q++ = CLAMP(v, -32767.0f, 32767.0f);
+			}
+		}
+	}
+	*sizes = q - block;
+}
+
+static void wsq_unquantize(float *plane, int width, const short *qdata,
+	const struct wsq_tree *tree, const struct wsq_quant *quant)
+{
+	int i, x, y;
+
+	for (i = 0; i < WSQ_SUBBANDS; i++) {
+		const struct wsq_rect *b = &tree->band[i];
+		float step = quant->qbss[i];
+		float zbin = quant->qzbs[i] / 2.0f;
+		float cr = quant->cr;
+
+		if (step == 0.0f)
+			continue;
+
+		for (y = 0; y < b->leny; y++) {
+			float *p = plane + (b->y + y) * width + b->x;
+			for (x = 0; x < b->lenx; x++, qdata++) {
+				if (*qdata > 0)
+					p[x] = step * (*qdata - cr) + zbin;
+				else if (*qdata < 0)
+					p[x] = step * (*qdata + cr) - zbin;
+				else
+					p[x] = 0.0f;
+			}
+		}
+	}
+}
+
+static int wsq_nr_coeffs(const struct wsq_tree *tree,
+	const struct wsq_quant *quant)
+{
+	int nr = 0;
+	int i;
+
+	for (i = 0; i < WSQ_SUBBANDS; i++)
+		if (quant->qbss[i] != 0.0f)
+			nr += tree->band[i].lenx * tree->band[i].leny;
+	return nr;
+}
+
+/***** HUFFMAN CODING *****/
+
+/* Builds a Huffman code of at most 16 bits for the symbol counts, as in
+ * JPEG annex K. counts needs one extra entry: a reserved symbol is given
+ * the longest code and then dropped, so that no code is all ones. */
+static void wsq_build_hufftable(int *counts, struct wsq_hufftable *table)
+{
+	int codesize[WSQ_NR_SYMBOLS + 1];
+	int others[WSQ_NR_SYMBOLS + 1];
+	int bits[64];
+	int i, j, v1, v2;
+
+	counts[WSQ_NR_SYMBOLS] = 1;
+	for (i = 0; i <= WSQ_NR_SYMBOLS; i++) {
+		codesize[i] = 0;
+		others[i] = -1;
+	}
+
+	while (1) {
+		v1 = v2 = -1;
+		for (i = 0; i <= WSQ_NR_SYMBOLS; i++) {
+			if (counts[i] == 0)
+				continue;
+			if (v1 < 0 || counts[i] <= counts[v1]) {
+				v2 = v1;
+				v1 = i;
+			} else if (v2 < 0 || counts[i] <= counts[v2]) {
+				v2 = i;
+			}
+		}
+		if (v2 < 0)
+			break;
+
+		counts[v1] += counts[v2];
+		counts[v2] = 0;
+		codesize[v1]++;
+		while (others[v1] >= 0) {
+			v1 = others[v1];
+			codesize[v1]++;
+		}
+		others[v1] = v2;
+		codesize[v2]++;
+		while (others[v2] >= 0) {
+			v2 = others[v2];
+			codesize[v2]++;
+		}
+	}
+
+	memset(bits, 0, sizeof(bits));
+	for (i = 0; i <= WSQ_NR_SYMBOLS; i++)
+		if (codesize[i])
+			bits[codesize[i]]++;
+
+	/* move codes longer than 16 bits up the tree */
+	for (i = G_N_ELEMENTS(bits) - 1; i > WSQ_MAX_CODE_BITS; ) {
+		if (bits[i] == 0) {
+			i--;
+			continue;
+		}
+		for (j = i - 2; bits[j] == 0; j--)
+			;
+		bits[i] -= 2;
+		bits[i - 1]++;
+		bits[j + 1] += 2;
+		bits[j]--;
+	}
+	for (i = WSQ_MAX_CODE_BITS; i > 0 && bits[i] == 0; i--)
+		;
+	bits[i]--;
+
+	for (i = 0; i < WSQ_MAX_CODE_BITS; i++)
+		table->bits[i] = bits[i + 1];
+	table->nr_values = 0;
+	for (i = 1; i < G_N_ELEMENTS(bits); i++)
+		for (j = 0; j < WSQ_NR_SYMBOLS; j++)
+			if (codesize[j] == i)
+				table->values[table->nr_values++] = j;
+}
+
+struct wsq_huffcode {
+	unsigned short code[WSQ_NR_SYMBOLS];
+	unsigned char size[WSQ_NR_SYMBOLS];
+};
+
+static void wsq_make_huffcode(const struct wsq_hufftable *table,
+	struct wsq_huffcode *hc)
+{
+	unsigned int code = 0;
+	int i, j, k = 0;
+
+	for (i = 0; i < WSQ_MAX_CODE_BITS; i++) {
+		for (j = 0; j < table->bits[i]; j++, k++) {
+			hc->code[table->values[k]] = code++;
+			hc->size[table->values[k]] = i + 1;
+		}
+		code <<= 1;
+	}
+}
+
+struct wsq_huffdec {
+	int present;
+	int mincode[WSQ_MAX_CODE_BITS + 1];
+	int maxcode[WSQ_MAX_CODE_BITS + 1];
+	int valptr[WSQ_MAX_CODE_BITS + 1];
+	unsigned char values[WSQ_NR_SYMBOLS];
+	/* code length << 8 | symbol, indexed by the next bits of the stream,
+	 * or 0 if the code is longer than WSQ_LOOKUP_BITS */
+	unsigned short lookup[1 << WSQ_LOOKUP_BITS];
+};
+
+static int wsq_make_huffdec(const struct wsq_hufftable *table,
+	struct wsq_huffdec *hd)
+{
+	unsigned int code = 0;
+	int i, j, k = 0;
+
+	memset(hd, 0, sizeof(*hd));
+	memcpy(hd->values, table->values, table->nr_values);
+	for (i = 1; i <= WSQ_MAX_CODE_BITS; i++) {
+		int n = table->bits[i - 1];
+
+		hd->valptr[i] = k;
+		hd->mincode[i] = code;
+		hd->maxcode[i] = n ? code + n - 1 : -1;
+		if (code + n > (1U << i))
+			return -EINVAL;
+
+		if (i <= WSQ_LOOKUP_BITS)
+			for (j = 0; j < n; j++) {
+				int shift = WSQ_LOOKUP_BITS - i;
+				int first = (code + j) << shift;
+				int e;
+				for (e = 0; e < (1 << shift); e++)
+					hd->lookup[first + e] =
+						(i << 8) | table->values[k + j];
+			}
+
+		code = (code + n) << 1;
+		k += n;
+	}
+
+	hd->present = 1;
+	return 0;
+}
+
+/***** ENCODER *****/
+
+struct wsq_writer {
+	FILE *fd;
+	int error;
+	size_t len;
+	unsigned int bits;
+	int nr_bits;
+	unsigned char buf[4096];
+};
+
+static void wsq_flush(struct wsq_writer *w)
+{
+	if (w->len && fwrite(w->buf, 1, w->len, w->fd) != w->len)
+		w->error = -EIO;
+	w->len = 0;
+}
+
+static void wsq_put_byte(struct wsq_writer *w, unsigned char c)
+{
+	if (w->len == sizeof(w->buf))
+		wsq_flush(w);
+	w->buf[w->len++] = c;
+}
+
+static void wsq_put_u16(struct wsq_writer *w, unsigned int value)
+{
+	wsq_put_byte(w, value >> 8);
+	wsq_put_byte(w, value);
+}
+
+static void wsq_put_scaled(struct wsq_writer *w, float value)
+{
+	unsigned int mantissa;
+	int scale;
+
+	wsq_scale(value, 65535.0, &scale, &mantissa);
+	wsq_put_byte(w, scale);
+	wsq_put_u16(w, mantissa);
+}
+
+/* Appends size bits of entropy coded data. A 0xff byte is followed by a
+ * stuffed zero byte so that it cannot be mistaken for a marker. */
+static void wsq_put_bits(struct wsq_writer *w, unsigned int value, int size)
+{
+	w->bits = (w->bits << size) | (value & ((1U << size) - 1));
+	w->nr_bits += size;
+	while (w->nr_bits >= 8) {
+		unsigned char c = w->bits >> (w->nr_bits - 8);
+		w->nr_bits -= 8;
+		wsq_put_byte(w, c);
+		if (c == 0xff)
+			wsq_put_byte(w, 0);
+	}
+}
+
+/* Pads the entropy coded data to a byte boundary with one bits. */
+static void wsq_flush_bits(struct wsq_writer *w)
+{
+	if (w->nr_bits)
+		wsq_put_bits(w, 0xff, 8 - w->nr_bits);
+}
+
+static void wsq_put_transform_table(struct wsq_writer *w,
+	const struct wsq_filters *f)
+{
+	int i;
+
+	wsq_put_u16(w, WSQ_DTT);
+	wsq_put_u16(w, 58);
+	/* filter lengths, high pass first, then the low pass taps and the
+	 * high pass taps */
+	wsq_put_byte(w, 7);
+	wsq_put_byte(w, 9);
+	for (i = 0; i < 9; i++) {
+		float value = i < 5 ? f->lo[i] : f->hi[i - 5];
+		unsigned int mantissa;
+		int scale;
+
+		wsq_scale(fabsf(value), 4294967295.0, &scale, &mantissa);
+		wsq_put_byte(w, value < 0.0f);
+		wsq_put_byte(w, scale);
+		wsq_put_u16(w, mantissa >> 16);
+		wsq_put_u16(w, mantissa);
+	}
+}
+
+static void wsq_put_quant_table(struct wsq_writer *w,
+	const struct wsq_quant *quant)
+{
+	int i;
+
+	wsq_put_u16(w, WSQ_DQT);
+	wsq_put_u16(w, 389);
+	wsq_put_scaled(w, quant->cr);
+	for (i = 0; i < WSQ_MAX_SUBBANDS; i++) {
+		wsq_put_scaled(w, quant->qbss[i]);
+		wsq_put_scaled(w, quant->qzbs[i]);
+	}
+}
+
+static void wsq_put_frame_header(struct wsq_writer *w, int width,
+	int height, float m_shift, float r_scale)
+{
+	wsq_put_u16(w, WSQ_SOF);
+	wsq_put_u16(w, 17);
+	wsq_put_byte(w, 0);	/* black */
+	wsq_put_byte(w, 255);	/* white */
+	wsq_put_u16(w, height);
+	wsq_put_u16(w, width);
+	wsq_put_scaled(w, m_shift);
+	wsq_put_scaled(w, r_scale);
+	wsq_put_byte(w, 2);	/* encoder */
+	wsq_put_u16(w, 0);	/* software */
+}
+
+static void wsq_put_hufftable(struct wsq_writer *w, int id,
+	const struct wsq_hufftable *table)
+{
+	int i;
+
+	wsq_put_u16(w, WSQ_DHT);
+	wsq_put_u16(w, 3 + WSQ_MAX_CODE_BITS + table->nr_values);
+	wsq_put_byte(w, id);
+	for (i = 0; i < WSQ_MAX_CODE_BITS; i++)
+		wsq_put_byte(w, table->bits[i]);
+	for (i = 0; i < table->nr_values; i++)
+		wsq_put_byte(w, table->values[i]);
+}
+
+/* The block coder either counts the symbols a block needs, or writes them
+ * with a code built from those counts. */
+struct wsq_block_coder {
+	int *counts;
+	struct wsq_writer *w;
+	const struct wsq_huffcode *hc;
+};
+
+static void wsq_emit(struct wsq_block_coder *bc, int symbol, int extra,
+	int extra_bits)
+{
+	if (bc->counts) {
+		bc->counts[symbol]++;
+		return;
+	}
+	wsq_put_bits(bc->w, bc->hc->code[symbol], bc->hc->size[symbol]);
+	if (extra_bits)
+		wsq_put_bits(bc->w, extra, extra_bits);
+}
+
+static void wsq_emit_run(struct wsq_block_coder *bc, int run)
+{
+	if (run <= WSQ_MAX_ZRUN)
+		wsq_emit(bc, run, 0, 0);
+	else if (run <= 0xff)
+		wsq_emit(bc, WSQ_ZRUN8, run, 8);
+	else
+		wsq_emit(bc, WSQ_ZRUN16, run, 16);
+}
+
+static void wsq_emit_coeff(struct wsq_block_coder *bc, int coeff)
+{
+	if (coeff > WSQ_MAX_COEFF) {
+		if (coeff > 0xff)
+			wsq_emit(bc, WSQ_POS_COEFF16, coeff, 16);
+		else
+			wsq_emit(bc, WSQ_POS_COEFF8, coeff, 8);
+	} else if (coeff < 1 - WSQ_MAX_COEFF) {
+		if (coeff < -0xff)
+			wsq_emit(bc, WSQ_NEG_COEFF16, -coeff, 16);
+		else
+			wsq_emit(bc, WSQ_NEG_COEFF8, -coeff, 8);
+	} else {
+		wsq_emit(bc, coeff + WSQ_COEFF_BASE, 0, 0);
+	}
+}
+
+static void wsq_code_block(struct wsq_block_coder *bc, const short *q, int n)
+{
+	int run = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (q[i] == 0) {
+			if (++run == 0xffff) {
+				wsq_emit_run(bc, run);
+				run = 0;
+			}
+			continue;
+		}
+		if (run) {
+			wsq_emit_run(bc, run);
+			run = 0;
+		}
+		wsq_emit_coeff(bc, q[i]);
+	}
+	if (run)
+		wsq_emit_run(bc, run);
+}
+
+/* Writes blocks sharing Huffman table id. Empty blocks are left out. */
+static void wsq_put_blocks(struct wsq_writer *w, int id, const short *q,
+	const int *sizes, int nr_blocks)
+{
+	int counts[WSQ_NR_SYMBOLS + 1];
+	struct wsq_hufftable table;
+	struct wsq_huffcode hc;
+	struct wsq_block_coder bc;
+	const short *p = q;
+	int i, total = 0;
+
+	memset(counts, 0, sizeof(counts));
+	bc.counts = counts;
+	for (i = 0; i < nr_blocks; p += sizes[i++]) {
+		wsq_code_block(&bc, p, sizes[i]);
+		total += sizes[i];
+	}
+	if (total == 0)
+		return;
+
+	wsq_build_hufftable(counts, &table);
+	wsq_make_huffcode(&table, &hc);
+	wsq_put_hufftable(w, id, &table);
+
+	bc.counts = NULL;
+	bc.w = w;
+	bc.hc = &hc;
+	for (i = 0, p = q; i < nr_blocks; p += sizes[i++]) {
+		if (sizes[i] == 0)
+			continue;
+		wsq_put_u16(w, WSQ_SOB);
+		wsq_put_u16(w, 3);
+		wsq_put_byte(w, id);
+		wsq_code_block(&bc, p, sizes[i]);
+		wsq_flush_bits(w);
+	}
+}
+
+/* Compresses img into fd. */
+int fpi_wsq_encode(struct fp_img *img, FILE *fd)
+{
+	struct wsq_writer *w;
+	struct wsq_tree tree;
+	struct wsq_quant quant;
+	int width = img->width;
+	int height = img->height;
+	int npix = width * height;
+	float *plane, *buf;
+	short *qdata;
+	int sizes[3];
+	int low = 255, high = 0;
+	double sum = 0.0;
+	float m_shift, r_scale;
+	int i, r;
+
+	/* the decoder refuses anything outside these bounds, so don't write a
+	 * file that can't be read back */
+	if (width < WSQ_MIN_SIZE || height < WSQ_MIN_SIZE
+			|| width > WSQ_MAX_SIZE || height > WSQ_MAX_SIZE) {
+		fp_err("can't compress %dx%d image", width, height);
+		return -EINVAL;
+	}
+
+	/* centre the pixels around 0 in the range -128 to 128 */
+	for (i = 0; i < npix; i++) {
+		sum += img->data[i];
+		low = MIN(low, img->data[i]);
+		high = MAX(high, img->data[i]);
+	}
+	m_shift = wsq_round(sum / npix);
+	r_scale = wsq_round(MAX(m_shift - low, high - m_shift) / 128.0f);
+	if (r_scale == 0.0f)
+		r_scale = 1.0f;
+
+	plane = g_malloc(npix * sizeof(*plane));
+	buf = g_malloc((MAX(width, height) + 2 * WSQ_EXT) * sizeof(*buf));
+	for (i = 0; i < npix; i++)
+		plane[i] = (img->data[i] - m_shift) / r_scale;
+
+	wsq_build_tree(&tree, width, height);
+	wsq_decompose(plane, width, &tree, &wsq_default_filters, buf);
+	wsq_compute_quant(&quant, plane, width, &tree, WSQ_BITRATE);
+	qdata = g_malloc(npix * sizeof(*qdata));
+	wsq_quantize(qdata, plane, width, &tree, &quant, sizes);
+	g_free(plane);
+	g_free(buf);
+
+	w = g_malloc0(sizeof(*w));
+	w->fd = fd;
+	wsq_put_u16(w, WSQ_SOI);
+	wsq_put_transform_table(w, &wsq_default_filters);
+	wsq_put_quant_table(w, &quant);
+	wsq_put_frame_header(w, width, height, m_shift, r_scale);
+	wsq_put_blocks(w, 0, qdata, sizes, 1);
+	wsq_put_blocks(w, 1, qdata + sizes[0], sizes + 1, 2);
+	wsq_put_u16(w, WSQ_EOI);
+	wsq_flush(w);
+	g_free(qdata);
+
+	r = w->error;
+	if (r)
+		fp_err("write failed");
+	g_free(w);
+	return r;
+}
+
+/***** DECODER *****/
+
+struct wsq_reader {
+	const unsigned char *p;
+	const unsigned char *end;
+	/* entropy coded data, most significant bit first */
+	unsigned int bits;
+	int nr_bits;
+	/* set when the entropy coded data runs into a marker */
+	int at_marker;
+};
+
+static int wsq_get_byte(struct wsq_reader *r)
+{
+	if (r->p >= r->end)
+		return -EINVAL;
+	return *r->p++;
+}
+
+static int wsq_get_u16(struct wsq_reader *r)
+{
+	if (r->end - r->p < 2)
+		return -EINVAL;
+	r->p += 2;
+	return (r->p[-2] << 8) | r->p[-1];
+}
+
+static int wsq_get_scaled(struct wsq_reader *r, float *value)
+{
+	int scale = wsq_get_byte(r);
+	int mantissa = wsq_get_u16(r);
+
+	if (scale < 0 || mantissa < 0)
+		return -EINVAL;
+	*value = wsq_unscale(scale, mantissa);
+	return 0;
+}
+
+static void wsq_fill_bits(struct wsq_reader *r)
+{
+	while (r->nr_bits <= 24 && !r->at_marker) {
+		unsigned int c;
+
+		if (r->p >= r->end) {
+			r->at_marker = 1;
+			break;
+		}
+		c = r->p[0];
+		if (c == 0xff) {
+			if (r->end - r->p < 2 || r->p[1] != 0) {
+				r->at_marker = 1;
+				break;
+			}
+			r->p++;
+		}
+		r->p++;
+		r->bits |= c << (24 - r->nr_bits);
+		r->nr_bits += 8;
+	}
+}
+
+static void wsq_reset_bits(struct wsq_reader *r)
+{
+	r->bits = 0;
+	r->nr_bits = 0;
+	r->at_marker = 0;
+}
+
+static int wsq_get_bits(struct wsq_reader *r, int n)
+{
+	int value;
+
+	wsq_fill_bits(r);
+	if (r->nr_bits < n)
+		return -EINVAL;
+	value = r->bits >> (32 - n);
+	r->bits <<= n;
+	r->nr_bits -= n;
+	return value;
+}
+
+/* Returns the next symbol, or WSQ_END_OF_DATA once only the padding before
+ * a marker is left. */
+static int wsq_get_symbol(struct wsq_reader *r, const struct wsq_huffdec *hd)
+{
+	int len;
+
+	wsq_fill_bits(r);
+	if (r->nr_bits >= WSQ_LOOKUP_BITS) {
+		int e = hd->lookup[r->bits >> (32 - WSQ_LOOKUP_BITS)];
+		if (e) {
+			r->bits <<= e >> 8;
+			r->nr_bits -= e >> 8;
+			return e & 0xff;
+		}
+	}
+
+	for (len = 1; len <= WSQ_MAX_CODE_BITS; len++) {
+		int code;
+
+		if (len > r->nr_bits)
+			return WSQ_END_OF_DATA;
+		code = r->bits >> (32 - len);
+		if (code <= hd->maxcode[len]) {
+			r->bits <<= len;
+			r->nr_bits -= len;
+			return hd->values[hd->valptr[len] + code - hd->mincode[len]];
+		}
+	}
+	return -EINVAL;
+}
+
+struct wsq_decoder {
+	struct wsq_reader r;
+	struct wsq_filters filters;
+	struct wsq_quant quant;
+	struct wsq_huffdec huff[WSQ_HUFFTABLES];
+	int have_quant;
+	int width;
+	int height;
+	float m_shift;
+	float r_scale;
+	struct wsq_tree tree;
+	short *qdata;
+	int nr_coeffs;
+	int pos;
+};
+
+static int wsq_read_transform_table(struct wsq_decoder *d)
+{
+	int i;
+
+	if (wsq_get_byte(&d->r) != 7 || wsq_get_byte(&d->r) != 9) {
+		fp_err("unsupported wavelet filters");
+		return -EINVAL;
+	}
+	for (i = 0; i < 9; i++) {
+		int sign = wsq_get_byte(&d->r);
+		int scale = wsq_get_byte(&d->r);
+		int hi = wsq_get_u16(&d->r);
+		int lo = wsq_get_u16(&d->r);
+		float value;
+
+		if (sign < 0 || scale < 0 || hi < 0 || lo < 0)
+			return -EINVAL;
+		value = wsq_unscale(scale, ((unsigned int) hi << 16) | lo);
+		if (sign)
+			value = -value;
+		if (i < 5)
+			d->filters.lo[i] = value;
+		else
+			d->filters.hi[i - 5] = value;
+	}
+	return 0;
+}
+
+static int wsq_read_quant_table(struct wsq_decoder *d)
+{
+	int i;
+
+	if (wsq_get_scaled(&d->r, &d->quant.cr) < 0)
+		return -EINVAL;
+	for (i = 0; i < WSQ_MAX_SUBBANDS; i++)
+		if (wsq_get_scaled(&d->r, &d->quant.qbss[i]) < 0
+				|| wsq_get_scaled(&d->r, &d->quant.qzbs[i]) < 0)
+			return -EINVAL;
+	/* the last subbands are never coded */
+	for (i = WSQ_SUBBANDS; i < WSQ_MAX_SUBBANDS; i++)
+		d->quant.qbss[i] = 0.0f;
+	d->have_quant = 1;
+	return 0;
+}
+
+static int wsq_read_hufftables(struct wsq_decoder *d)
+{
+	while (d->r.p < d->r.end) {
+		struct wsq_hufftable table;
+		int id = wsq_get_byte(&d->r);
+		int i, r;
+
+		if (id < 0 || id >= WSQ_HUFFTABLES)
+			return -EINVAL;
+		table.nr_values = 0;
+		for (i = 0; i < WSQ_MAX_CODE_BITS; i++) {
+			r = wsq_get_byte(&d->r);
+			if (r < 0)
+				return r;
+			table.bits[i] = r;
+			table.nr_values += r;
+		}
+		if (table.nr_values > WSQ_NR_SYMBOLS
+				|| d->r.end - d->r.p < table.nr_values)
+			return -EINVAL;
+		memcpy(table.values, d->r.p, table.nr_values);
+		d->r.p += table.nr_values;
+
+		r = wsq_make_huffdec(&table, &d->huff[id]);
+		if (r < 0)
+			return r;
+	}
+	return 0;
+}
+
+static int wsq_read_frame_header(struct wsq_decoder *d)
+{
+	if (d->width)
+		return -EINVAL;
+	wsq_get_byte(&d->r);	/* black */
+	wsq_get_byte(&d->r);	/* white */
+	d->height = wsq_get_u16(&d->r);
+	d->width = wsq_get_u16(&d->r);
+	if (wsq_get_scaled(&d->r, &d->m_shift) < 0
+			|| wsq_get_scaled(&d->r, &d->r_scale) < 0)
+		return -EINVAL;
+	if (d->width < WSQ_MIN_SIZE || d->height < WSQ_MIN_SIZE
+			|| d->width > WSQ_MAX_SIZE || d->height > WSQ_MAX_SIZE) {
+		fp_err("unsupported image size %dx%d", d->width, d->height);
+		return -EINVAL;
+	}
+	wsq_build_tree(&d->tree, d->width, d->height);
+	return 0;
+}
+
+static int wsq_alloc_qdata(struct wsq_decoder *d)
+{
+	if (!d->have_quant || !d->width)
+		return -EINVAL;
+	if (!d->qdata) {
+		d->nr_coeffs = wsq_nr_coeffs(&d->tree, &d->quant);
+		d->qdata = g_malloc0(MAX(d->nr_coeffs, 1) * sizeof(*d->qdata));
+	}
+	return 0;
+}
+
+/* Decodes the entropy coded data of one block, up to the next marker. */
+static int wsq_decode_block(struct wsq_decoder *d, int id)
+{
+	struct wsq_reader *r = &d->r;
+	const struct wsq_huffdec *hd;
+
+	if (id < 0 || id >= WSQ_HUFFTABLES || !d->huff[id].present
+			|| wsq_alloc_qdata(d) < 0)
+		return -EINVAL;
+	hd = &d->huff[id];
+
+	wsq_reset_bits(r);
+	while (1) {
+		int symbol = wsq_get_symbol(r, hd);
+		int value = 0;
+		int run = -1;
+
+		if (symbol == WSQ_END_OF_DATA) {
+			/* restart markers may split the block */
+			if (r->end - r->p >= 2 && r->p[0] == 0xff
+					&& r->p[1] >= (WSQ_RST0 & 0xff)
+					&& r->p[1] <= (WSQ_RST7 & 0xff)) {
+				r->p += 2;
+				wsq_reset_bits(r);
+				continue;
+			}
+			return 0;
+		}
+
+		if (symbol > 0 && symbol <= WSQ_MAX_ZRUN) {
+			run = symbol;
+		} else if (symbol > WSQ_ZRUN16 && symbol < 0xff) {
+			value = symbol - WSQ_COEFF_BASE;
+		} else if (symbol >= WSQ_POS_COEFF8 && symbol <= WSQ_ZRUN16) {
+			/* escapes are followed by the value in 8 or 16 bits */
+			int extra = wsq_get_bits(r, (symbol == WSQ_POS_COEFF16
+				|| symbol == WSQ_NEG_COEFF16
+				|| symbol == WSQ_ZRUN16) ? 16 : 8);
+			if (extra < 0)
+				return extra;
+			if (symbol == WSQ_ZRUN8 || symbol == WSQ_ZRUN16)
+				run = extra;
+			else if (symbol == WSQ_NEG_COEFF8
+					|| symbol == WSQ_NEG_COEFF16)
+				value = -extra;
+			else
+				value = extra;
+		} else {
+			return -EINVAL;
+		}
+
+		if (run >= 0) {
+			/* qdata is zeroed already */
+			if (run > d->nr_coeffs - d->pos)
+				return -EINVAL;
+			d->pos += run;
+		} else {
+			if (d->pos >= d->nr_coeffs)
+				return -EINVAL;
+			d->qdata[d->pos++] = value;
+		}
+	}
+}
+
+static struct fp_img *wsq_decode_image(struct wsq_decoder *d)
+{
+	struct wsq_reader *r = &d->r;
+	struct fp_img *img;
+	float *plane, *buf;
+	int marker;
+	size_t npix, i;
+
+	if (wsq_get_u16(r) != WSQ_SOI)
+		return NULL;
+
+	while ((marker = wsq_get_u16(r)) != WSQ_EOI) {
+		const unsigned char *end = r->end;
+		int len = wsq_get_u16(r);
+		int ret;
+
+		if (marker < 0 || len < 2 || r->end - r->p < len - 2)
+			return NULL;
+
+		/* the coefficient count is fixed once the first block is
+		 * decoded, so the tables it depends on cannot change after */
+		if (d->qdata && (marker == WSQ_SOF || marker == WSQ_DTT
+				|| marker == WSQ_DQT)) {
+			fp_err("segment %x after image data", marker);
+			return NULL;
+		}
+
+		/* parse each segment on its own */
+		r->end = r->p + len - 2;
+		switch (marker) {
+		case WSQ_SOF:
+			ret = wsq_read_frame_header(d);
+			break;
+		case WSQ_DTT:
+			ret = wsq_read_transform_table(d);
+			break;
+		case WSQ_DQT:
+			ret = wsq_read_quant_table(d);
+			break;
+		case WSQ_DHT:
+			ret = wsq_read_hufftables(d);
+			break;
+		case WSQ_SOB:
+			ret = wsq_get_byte(r);
+			break;
+		case WSQ_COM:
+		case WSQ_DRT:
+			ret = 0;
+			break;
+		default:
+			fp_err("unexpected marker %x", marker);
+			ret = -EINVAL;
+			break;
+		}
+		r->p = r->end;
+		r->end = end;
+
+		/* the entropy coded data follows the block header */
+		if (ret >= 0 && marker == WSQ_SOB)
+			ret = wsq_decode_block(d, ret);
+		if (ret < 0)
+			return NULL;
+	}
+
+	/* an image without any coded subbands has no blocks at all */
+	if (wsq_alloc_qdata(d) < 0 || d->pos != d->nr_coeffs
+			|| d->nr_coeffs != wsq_nr_coeffs(&d->tree, &d->quant)) {
+		fp_err("incomplete image data");
+		return NULL;
+	}
+
+	npix = (size_t) d->width * d->height;
+	plane = g_malloc0(npix * sizeof(*plane));
+	buf = g_malloc((MAX(d->width, d->height) + 2 * WSQ_EXT) * sizeof(*buf));
+	wsq_unquantize(plane, d->width, d->qdata, &d->tree, &d->quant);
+	wsq_reconstruct(plane, d->width, &d->tree, &d->filters, buf);
+
+	img = fpi_img_new(npix);
+	img->width = d->width;
+	img->height = d->height;
+	for (i = 0; i < npix; i++) {
+		float v = plane[i] * d->r_scale + d->m_shift + 0.5f;
+		img->data[i] = CLAMP(v, 0.0f, 255.0f);
+	}
+
+	g_free(plane);
+	g_free(buf);
+	return img;
+}
+
+/* Decompresses a WSQ image held in memory. Returns NULL if the data is not
+ * a valid WSQ stream. */
+struct fp_img *fpi_wsq_decode(const unsigned char *data, size_t length)
+{
+	struct wsq_decoder *d = g_malloc0(sizeof(*d));
+	struct fp_img *img;
+
+	d->r.p = data;
+	d->r.end = data + length;
+	d->filters = wsq_default_filters;
+	img = wsq_decode_image(d);
+	if (!img)
+		fp_err("invalid WSQ data");
+
+	g_free(d->qdata);
+	g_free(d);
+	return img;
+}